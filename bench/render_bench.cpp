@@ -0,0 +1,497 @@
+// 可复现的渲染基准：在无窗口的 EGL 上下文 (可用 Mesa llvmpipe) 中按固定分辨率、固定相机
+// 逐个渲染 Scenes::scene_list() 中的场景，每个场景先预热再计时 N 帧，输出 JSON：
+// 每帧 CPU 墙钟时间 (绘制 + glFinish) 与 GL_TIME_ELAPSED 的 mean / p50 / p99，
+// 以及着色器装配到预热结束的耗时 (setup_ms，驱动多在第一次绘制时才真正编译)、预热后整体画一次阴影缓存的耗时。
+// 第一帧有 GL 错误 (例如 sampler 与纹理单元不匹配，绘制被拒绝) 时不输出计时，返回 1；
+// 计时之前先检查平移一个物体后画面随之改变 (见 check_motion)，否则返回 1；
+// --steps 另外各画一帧，统计原来固定的保守步长 (0.7 × d) 与当前设置 (场景的安全系数 × ω) 下
+// 每个像素 march() 的平均步数；--passes 另外画 N 帧，分别计时每一遍 (锥体预步进、G-buffer、低分辨率光照、着色、边缘超采样)
+//   ISR_bench [-w 160] [-h 90] [-n 8] [--warmup 2] [--scene name]... [--interpreter] [--full-aa] [--no-cone]
+//             [--forward] [--full-lighting] [--no-shadow-cache] [--relax 1.5] [--steps] [--passes] [--no-motion-check]
+//             [--env shaders/glacier.hdr] [--shaders shaders]
+//             [-o result.json]
+#include <glad/glad.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "objects.h"
+#include "scenes.h"
+#include "glsl_codegen.h"
+#include "frame_stats.h"
+#include "gl_utils.h"
+#include "edge_aa.h"
+#include "cone_prepass.h"
+#include "gbuffer.h"
+#include "shadow_volume.h"
+#include "offscreen_context.h"
+
+using namespace Objects;
+
+struct BenchSettings {
+    int width = 160;
+    int height = 90;
+    int frames = 8;
+    int warmup = 2;
+    bool compileScene = true;           // 与 main.cpp 的默认配置相同；--interpreter 测 TBO 解释器
+    bool edgeAA = true;                 // 边缘自适应抗锯齿；--full-aa 测逐像素 2x2 超采样
+    bool conePrepass = true;            // 锥体预步进；--no-cone 时主光线从相机处开始
+    bool deferred = true;               // 延迟着色；--forward 时步进与着色在同一遍 (--full-aa 时总是如此)
+    bool lowResLighting = true;         // 延迟着色时软阴影与 AO 在 1/2 分辨率计算；--full-lighting 时按全分辨率
+    bool shadowCache = true;            // 主光阴影缓存；--no-shadow-cache 时每次着色都步进软阴影
+    float relax = 1.5f;                 // 过松弛系数，与 main.cpp 的默认值相同
+    bool countSteps = false;
+    bool timePasses = false;
+    bool checkMotion = true;            // 计时之前检查物体移动后画面随之改变；--no-motion-check 时跳过
+    std::string envPath;                // 为空时关闭环境贴图，结果不依赖资源文件
+    std::string shaderDir = "shaders";
+};
+
+struct SceneResult {
+    std::string name;
+    int records = 0;
+    int stack = 0;
+    double setup_ms = 0.0;
+    FrameStats::Sample mean, p50, p99;
+    double steps_fixed = -1.0, steps_relaxed = -1.0;   // 每个像素的平均步数，-1 = 未统计
+    double pass_ms[5] = {-1.0, -1.0, -1.0, -1.0, -1.0};       // 各遍的平均 GPU 时间，-1 = 未统计或没有这一遍
+    long shadow_voxels = 0;                             // 阴影缓存的体素数与整体画一次的耗时
+    double shadow_ms = -1.0;
+};
+
+// 分遍计时的顺序；前向渲染时 shading 一遍同时包含主光线的步进
+enum { PASS_CONE, PASS_GEOMETRY, PASS_LIGHTING, PASS_SHADING, PASS_RESOLVE, PASS_COUNT };
+static const char *PASS_NAMES[PASS_COUNT] = {"cone", "geometry", "lighting", "shading", "resolve"};
+
+static std::string json_number(double v) {
+    if (v < 0.0) return "null";
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.4f", v);
+    return buf;
+}
+
+static std::string json_stats(const SceneResult &r, double FrameStats::Sample::*field) {
+    return "{\"mean\": " + json_number(r.mean.*field) + ", \"p50\": " + json_number(r.p50.*field) +
+           ", \"p99\": " + json_number(r.p99.*field) + "}";
+}
+
+// 渲染一个场景：与 main.cpp 的渲染循环相同的 uniform 与纹理绑定，目标换成 FBO，
+// 每帧以 glFinish 结束，使 CPU 计时覆盖整帧的 GPU 执行
+static bool run_scene(const std::string &name, const BenchSettings &settings, GLuint envTex, SceneResult &result) {
+    CSG_tree tree = CSG_tree();
+    if (!Scenes::build_scene(name, tree)) {
+        std::cout << "[Error] Unknown scene " << name << std::endl;
+        return false;
+    }
+    std::vector<float> gpuData, bvhData;
+    tree.generate_texture_data(gpuData, bvhData);
+    const int numObjects = static_cast<int>(gpuData.size() / 32);
+
+    auto setupStart = std::chrono::steady_clock::now();
+    std::string sceneCode = settings.compileScene ? generate_glsl_map(gpuData, bvhData, false) : "";
+    GLuint prog = buildRaymarchProgram(settings.shaderDir, tree.stack_size(), sceneCode);
+    GLint linked = 0;
+    glGetProgramiv(prog, GL_LINK_STATUS, &linked);
+    if (!linked) return false;
+
+    GLuint tbo, bvhTbo;
+    GLuint tex = createTextureBuffer(gpuData, tbo);
+    GLuint bvhTex = createTextureBuffer(bvhData, bvhTbo);
+
+    GLuint color;
+    GLuint fbo = createRenderTarget(settings.width, settings.height, color);
+    glViewport(0, 0, settings.width, settings.height);
+    EdgeAA edge;
+    if (settings.edgeAA) edge.resize(settings.width, settings.height);
+    ConePrepass cone;
+    if (settings.conePrepass) cone.resize(settings.width, settings.height);
+    GBuffer gbuffer;
+    if (settings.deferred) gbuffer.resize(settings.width, settings.height);
+
+    float quad[8] = {-1, -1, 1, -1, -1, 1, 1, 1};
+    GLuint vao, vbo;
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+    glEnableVertexAttribArray(0);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, tex);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, envTex);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_BUFFER, bvhTex);
+
+    glUseProgram(prog);
+    glUniform1i(glGetUniformLocation(prog, "objectBuffer"), 0);
+    glUniform1i(glGetUniformLocation(prog, "uEnvMap"), 1);
+    glUniform1i(glGetUniformLocation(prog, "bvhBuffer"), 2);
+    glUniform1i(glGetUniformLocation(prog, "uEnvEnable"), envTex != 0 ? 1 : 0);
+    glUniform1i(glGetUniformLocation(prog, "numObjects"), numObjects);
+    glUniform1i(glGetUniformLocation(prog, "numBVHNodes"), (int) bvhData.size() / 8);
+    glUniform2f(glGetUniformLocation(prog, "iResolution"), (float) settings.width, (float) settings.height);
+    glUniform1f(glGetUniformLocation(prog, "iTime"), 0.0f);
+    const float stepScale = tree.has_fractals() ? 0.7f : 1.0f;
+    glUniform1f(glGetUniformLocation(prog, "uStepScale"), stepScale);
+    glUniform1f(glGetUniformLocation(prog, "uRelax"), settings.relax);
+
+    // passQueries 非空时每一遍用各自的查询包住 (不能与 FrameStats 的整帧查询嵌套)
+    GLuint passQueries[PASS_COUNT] = {};
+    bool timing = false, passUsed[PASS_COUNT] = {};
+    bool drawn = false;
+    GLenum firstError = GL_NO_ERROR;        // 第一帧结束时的 glGetError()
+    auto drawPass = [&](int pass) {
+        if (timing) glBeginQuery(GL_TIME_ELAPSED, passQueries[pass]);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        if (timing) glEndQuery(GL_TIME_ELAPSED);
+        passUsed[pass] = true;
+    };
+    auto draw = [&]() {
+        if (settings.conePrepass) {
+            cone.begin(prog, settings.width, settings.height);
+            drawPass(PASS_CONE);
+            cone.end(prog, fbo, settings.width, settings.height);
+        }
+        if (settings.deferred) {
+            gbuffer.begin_geometry(prog);
+            drawPass(PASS_GEOMETRY);
+            if (settings.lowResLighting) {
+                gbuffer.begin_lighting(prog, settings.width, settings.height);
+                drawPass(PASS_LIGHTING);
+            }
+            gbuffer.begin_shading(prog, fbo, settings.width, settings.height, settings.lowResLighting);
+        }
+        if (settings.edgeAA) {
+            edge.begin_primary(prog);
+            drawPass(PASS_SHADING);
+            edge.begin_resolve(prog, fbo);
+            drawPass(PASS_RESOLVE);
+        } else {
+            drawPass(PASS_SHADING);
+        }
+        if (!drawn) {
+            drawn = true;
+            firstError = glGetError();
+        }
+    };
+    for (int i = 0; i < settings.warmup; ++i) {
+        draw();
+    }
+    glFinish();
+    result.setup_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - setupStart).count();
+
+    // 阴影缓存：场景静止，计时之前整体画一次 (放在预热之后，不把着色器的编译算进去)
+    ShadowVolume shadow;
+    if (settings.shadowCache) shadow.resize(tree.bounded_extent());
+    auto shadowStart = std::chrono::steady_clock::now();
+    result.shadow_voxels = shadow.update(prog, fbo, settings.width, settings.height);
+    glFinish();
+    if (settings.shadowCache) {
+        result.shadow_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - shadowStart).count();
+    }
+
+    // FrameStats 丢弃第 0 帧，多画一帧凑足 settings.frames 个样本
+    FrameStats stats;
+    stats.init();
+    for (int i = 0; i <= settings.frames; ++i) {
+        stats.begin_gpu();
+        draw();
+        stats.end_gpu();
+        stats.begin_swap();
+        glFinish();
+        stats.end_swap();
+        stats.end_frame();
+    }
+    stats.close();
+    if (firstError != GL_NO_ERROR) {
+        std::cout << "[Error] " << name << ": GL error 0x" << std::hex << firstError << std::dec
+                  << " in the first frame" << std::endl;
+        return false;
+    }
+
+    // 分遍计时：再画 settings.frames 帧，取各遍的平均值
+    if (settings.timePasses) {
+        glGenQueries(PASS_COUNT, passQueries);
+        timing = true;
+        double sum[PASS_COUNT] = {};
+        for (int i = 0; i < settings.frames; ++i) {
+            draw();
+            for (int k = 0; k < PASS_COUNT; ++k) {
+                if (!passUsed[k]) continue;
+                GLuint64 ns = 0;
+                glGetQueryObjectui64v(passQueries[k], GL_QUERY_RESULT, &ns);
+                sum[k] += ns * 1e-6;
+            }
+        }
+        for (int k = 0; k < PASS_COUNT; ++k) {
+            if (passUsed[k]) result.pass_ms[k] = sum[k] / settings.frames;
+        }
+        timing = false;
+        glDeleteQueries(PASS_COUNT, passQueries);
+    }
+
+    // 步数统计：同一个程序分别以 (0.7, ω = 1) 与 (stepScale, ω = relax) 各画一帧，读回 StepCounter
+    if (settings.countSteps) {
+        GLuint counter;
+        glGenBuffers(1, &counter);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, counter);
+        glUniform1i(glGetUniformLocation(prog, "uCountSteps"), 1);
+        const float scales[2] = {0.7f, stepScale}, omegas[2] = {1.0f, settings.relax};
+        double *out[2] = {&result.steps_fixed, &result.steps_relaxed};
+        for (int k = 0; k < 2; ++k) {
+            GLuint zero = 0;
+            glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), &zero, GL_DYNAMIC_READ);
+            glUniform1f(glGetUniformLocation(prog, "uStepScale"), scales[k]);
+            glUniform1f(glGetUniformLocation(prog, "uRelax"), omegas[k]);
+            draw();
+            glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+            GLuint total = 0;
+            glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &total);
+            *out[k] = double(total) / (double(settings.width) * settings.height);
+        }
+        glUniform1i(glGetUniformLocation(prog, "uCountSteps"), 0);
+        glUniform1f(glGetUniformLocation(prog, "uStepScale"), stepScale);
+        glUniform1f(glGetUniformLocation(prog, "uRelax"), settings.relax);
+        glDeleteBuffers(1, &counter);
+    }
+
+    result.name = name;
+    result.records = numObjects;
+    result.stack = tree.stack_size();
+    result.mean = stats.mean();
+    result.p50 = stats.percentile(0.5);
+    result.p99 = stats.percentile(0.99);
+
+    edge.destroy();
+    cone.destroy();
+    gbuffer.destroy();
+    shadow.destroy();
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vbo);
+    glDeleteRenderbuffers(1, &color);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &tex);
+    glDeleteTextures(1, &bvhTex);
+    glDeleteBuffers(1, &tbo);
+    glDeleteBuffers(1, &bvhTbo);
+    glDeleteProgram(prog);
+    return true;
+}
+
+// 物体移动后画面必须随之改变：地面上一个漫反射立方体，画一帧后平移立方体，按 main.cpp 的 7-2 更新
+// (上传改动的槽位与 BVH 节点，内联的场景编译重新链接，阴影缓存中受影响的体素失效) 再画一帧，两次读回相同则失败。
+// 只用前向渲染 (每像素 2x2 超采样)，检查的是场景数据的更新而不是各遍的组合
+static bool check_motion(const BenchSettings &settings, GLuint envTex) {
+    CSG_tree tree = CSG_tree();
+    tree.create_plane({0.7f, 0.7f, 0.7f, 1.0f}, glm::vec3(0.0f, 1.0f, 0.0f), -1.0f);
+    Object *cube = tree.create_cuboid({0.8f, 0.3f, 0.2f, 1.0f}, glm::vec3(0.0f, 0.0f, 0.0f), 1.6f, 1.6f, 1.6f,
+                                      0.0f, 0.0f, 0.0f);
+    std::vector<float> gpuData, bvhData;
+    tree.generate_texture_data(gpuData, bvhData);
+    const int numObjects = static_cast<int>(gpuData.size() / 32);
+
+    GLuint prog = 0;
+    auto link = [&]() {
+        if (prog != 0) glDeleteProgram(prog);
+        std::string sceneCode = settings.compileScene ? generate_glsl_map(gpuData, bvhData, false) : "";
+        prog = buildRaymarchProgram(settings.shaderDir, tree.stack_size(), sceneCode);
+        glUseProgram(prog);
+        glUniform1i(glGetUniformLocation(prog, "objectBuffer"), 0);
+        glUniform1i(glGetUniformLocation(prog, "uEnvMap"), 1);
+        glUniform1i(glGetUniformLocation(prog, "bvhBuffer"), 2);
+        glUniform1i(glGetUniformLocation(prog, "uEnvEnable"), envTex != 0 ? 1 : 0);
+        glUniform1i(glGetUniformLocation(prog, "numObjects"), numObjects);
+        glUniform1i(glGetUniformLocation(prog, "numBVHNodes"), (int) bvhData.size() / 8);
+        glUniform2f(glGetUniformLocation(prog, "iResolution"), (float) settings.width, (float) settings.height);
+        glUniform1f(glGetUniformLocation(prog, "uStepScale"), 1.0f);
+        glUniform1f(glGetUniformLocation(prog, "uRelax"), settings.relax);
+    };
+    link();
+
+    GLuint tbo, bvhTbo;
+    GLuint tex = createTextureBuffer(gpuData, tbo);
+    GLuint bvhTex = createTextureBuffer(bvhData, bvhTbo);
+    GLuint color;
+    GLuint fbo = createRenderTarget(settings.width, settings.height, color);
+
+    float quad[8] = {-1, -1, 1, -1, -1, 1, 1, 1};
+    GLuint vao, vbo;
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+    glEnableVertexAttribArray(0);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, tex);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, envTex);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_BUFFER, bvhTex);
+
+    ShadowVolume shadow;
+    if (settings.shadowCache) shadow.resize(tree.bounded_extent());
+    std::vector<float> frames[2];
+    for (int k = 0; k < 2; ++k) {
+        if (k == 1) {
+            cube->translate(glm::vec3(1.5f, 0.0f, 0.0f));
+            std::vector<AABB> movedBounds;
+            std::vector<int> dirtyNodes;
+            std::vector<int> dirtySlots = tree.update_dirty(gpuData, bvhData, &movedBounds, &dirtyNodes);
+            shadow.invalidate(movedBounds);
+            uploadDirtySlots(tbo, dirtySlots, gpuData);
+            uploadDirtyNodes(bvhTbo, dirtyNodes, bvhData);
+            if (settings.compileScene) link();
+        }
+        shadow.update(prog, fbo, settings.width, settings.height);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        readPixelsRGB(settings.width, settings.height, frames[k]);
+    }
+    GLenum error = glGetError();
+
+    shadow.destroy();
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vbo);
+    glDeleteRenderbuffers(1, &color);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &tex);
+    glDeleteTextures(1, &bvhTex);
+    glDeleteBuffers(1, &tbo);
+    glDeleteBuffers(1, &bvhTbo);
+    glDeleteProgram(prog);
+    if (error != GL_NO_ERROR) {
+        std::cout << "[Error] motion check: GL error 0x" << std::hex << error << std::dec << std::endl;
+        return false;
+    }
+    if (frames[0] == frames[1]) {
+        std::cout << "[Error] motion check: the frame did not change after translating an object" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    BenchSettings settings;
+    std::vector<std::string> scenes;
+    std::string outPath;
+
+    for (int i = 1; i < argc; i++) {
+        auto next = [&]() -> const char * {
+            if (i + 1 >= argc) {
+                std::cout << "[Error] Missing value for " << argv[i] << std::endl;
+                std::exit(1);
+            }
+            return argv[++i];
+        };
+        if (!std::strcmp(argv[i], "-w")) settings.width = std::atoi(next());
+        else if (!std::strcmp(argv[i], "-h")) settings.height = std::atoi(next());
+        else if (!std::strcmp(argv[i], "-n")) settings.frames = std::atoi(next());
+        else if (!std::strcmp(argv[i], "--warmup")) settings.warmup = std::atoi(next());
+        else if (!std::strcmp(argv[i], "--scene")) scenes.push_back(next());
+        else if (!std::strcmp(argv[i], "--interpreter")) settings.compileScene = false;
+        else if (!std::strcmp(argv[i], "--full-aa")) settings.edgeAA = false;
+        else if (!std::strcmp(argv[i], "--no-cone")) settings.conePrepass = false;
+        else if (!std::strcmp(argv[i], "--forward")) settings.deferred = false;
+        else if (!std::strcmp(argv[i], "--full-lighting")) settings.lowResLighting = false;
+        else if (!std::strcmp(argv[i], "--no-shadow-cache")) settings.shadowCache = false;
+        else if (!std::strcmp(argv[i], "--relax")) settings.relax = static_cast<float>(std::atof(next()));
+        else if (!std::strcmp(argv[i], "--steps")) settings.countSteps = true;
+        else if (!std::strcmp(argv[i], "--passes")) settings.timePasses = true;
+        else if (!std::strcmp(argv[i], "--no-motion-check")) settings.checkMotion = false;
+        else if (!std::strcmp(argv[i], "--env")) settings.envPath = next();
+        else if (!std::strcmp(argv[i], "--shaders")) settings.shaderDir = next();
+        else if (!std::strcmp(argv[i], "-o")) outPath = next();
+        else {
+            std::cout << "[Error] Unknown argument " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+    if (settings.width <= 0 || settings.height <= 0 || settings.frames <= 0) {
+        std::cout << "[Error] Invalid resolution or frame count" << std::endl;
+        return 1;
+    }
+    if (!settings.edgeAA) settings.deferred = false;   // 与 main.cpp 相同：逐像素 2x2 超采样不用 G-buffer
+    if (scenes.empty()) {
+        for (const Scenes::SceneEntry &scene: Scenes::scene_list()) scenes.push_back(scene.name);
+    }
+
+    OffscreenContext context;
+    if (!context.create()) return 1;
+    if (!gladLoadGLLoader((GLADloadproc) OffscreenContext::proc_address)) {
+        std::cout << "[Error] Cannot load OpenGL functions" << std::endl;
+        return 1;
+    }
+
+    GLuint envTex = settings.envPath.empty() ? 0 : equirectToCubemap(settings.envPath, 512);
+    if (settings.checkMotion && !check_motion(settings, envTex)) return 1;
+
+    std::vector<SceneResult> results;
+    for (const std::string &name: scenes) {
+        SceneResult r;
+        if (!run_scene(name, settings, envTex, r)) return 1;
+        std::cerr << name << ": " << json_number(r.mean.cpu_ms) << " ms/frame" << std::endl;
+        results.push_back(r);
+    }
+
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"renderer\": \"" << OffscreenContext::renderer() << "\",\n";
+    json << "  \"width\": " << settings.width << ", \"height\": " << settings.height
+         << ", \"frames\": " << settings.frames << ", \"warmup\": " << settings.warmup << ",\n";
+    json << "  \"compiled_scene\": " << (settings.compileScene ? "true" : "false")
+         << ", \"environment\": " << (envTex != 0 ? "true" : "false")
+         << ", \"edge_aa\": " << (settings.edgeAA ? "true" : "false")
+         << ", \"cone_prepass\": " << (settings.conePrepass ? "true" : "false")
+         << ", \"deferred\": " << (settings.deferred ? "true" : "false")
+         << ", \"low_res_lighting\": " << (settings.deferred && settings.lowResLighting ? "true" : "false")
+         << ", \"shadow_cache\": " << (settings.shadowCache ? "true" : "false")
+         << ", \"relax\": " << json_number(settings.relax) << ",\n";
+    json << "  \"scenes\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const SceneResult &r = results[i];
+        json << "    {\"name\": \"" << r.name << "\", \"records\": " << r.records
+             << ", \"stack\": " << r.stack << ", \"setup_ms\": " << json_number(r.setup_ms) << ",\n";
+        json << "     \"frame_ms\": " << json_stats(r, &FrameStats::Sample::cpu_ms) << ",\n";
+        if (settings.shadowCache) {
+            json << "     \"shadow_cache\": {\"voxels\": " << r.shadow_voxels
+                 << ", \"build_ms\": " << json_number(r.shadow_ms) << "},\n";
+        }
+        if (settings.countSteps) {
+            json << "     \"steps_per_pixel\": {\"fixed\": " << json_number(r.steps_fixed)
+                 << ", \"relaxed\": " << json_number(r.steps_relaxed) << "},\n";
+        }
+        if (settings.timePasses) {
+            json << "     \"pass_ms\": {";
+            for (int k = 0; k < PASS_COUNT; ++k) {
+                json << (k ? ", " : "") << "\"" << PASS_NAMES[k] << "\": " << json_number(r.pass_ms[k]);
+            }
+            json << "},\n";
+        }
+        json << "     \"gpu_ms\": " << json_stats(r, &FrameStats::Sample::gpu_ms) << "}"
+             << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    json << "  ]\n}\n";
+
+    if (outPath.empty()) {
+        std::cout << json.str();
+    } else {
+        std::ofstream out(outPath);
+        if (!out) {
+            std::cout << "[Error] Cannot write " << outPath << std::endl;
+            return 1;
+        }
+        out << json.str();
+    }
+    if (envTex != 0) glDeleteTextures(1, &envTex);
+    return 0;
+}
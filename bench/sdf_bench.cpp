@@ -0,0 +1,192 @@
+// SDF 求值微基准：逐个基元比较标量解释器 map() 与 SIMD 批量 map_batch() 的吞吐 (points/s)，
+// 以及物体数量增长时线性遍历与 BVH 剔除的标量 map() 吞吐、打包整个场景的耗时。
+// 计时打包之前先检查重复定型的结果，不一致时返回 1
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <vector>
+#include "objects.h"
+#include "evaluator.h"
+
+using namespace Objects;
+
+struct BenchCase {
+    const char *name;
+    std::function<void(CSG_tree &)> build;
+};
+
+template<typename F>
+static double seconds(F &&f) {
+    auto t0 = std::chrono::steady_clock::now();
+    f();
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(t1 - t0).count();
+}
+
+// 重复定型：什么都没变时程序不变；定型之后对已并入根部的物体做 CSG 运算，再次定型的结果应与一次建好的树相同
+static bool check_refinalize() {
+    const Color c = {1.0f, 1.0f, 1.0f, 1.0f};
+    const glm::vec3 probes[3] = {glm::vec3(4.0f, 0.0f, 0.0f), glm::vec3(4.0f, 0.5f, 0.2f), glm::vec3(0.5f, 0.0f, 0.0f)};
+
+    CSG_tree tree;
+    tree.create_sphere(c, glm::vec3(0.0f), 1.0f);
+    Object *b = tree.create_sphere(c, glm::vec3(4.0f, 0.0f, 0.0f), 1.0f);
+    std::vector<float> first, again, bvh;
+    tree.generate_texture_data(first, bvh);
+    tree.generate_texture_data(again, bvh);
+    if (again != first) {
+        std::printf("[Error] finalize: repeated call changed the program\n");
+        return false;
+    }
+    if (tree.create_subtract(b, tree.create_sphere(c, glm::vec3(4.0f, 0.0f, 0.0f), 0.3f)) == nullptr) {
+        std::printf("[Error] finalize: subtracting from a folded object was rejected\n");
+        return false;
+    }
+    tree.generate_texture_data(again, bvh);
+
+    CSG_tree fresh;
+    fresh.create_sphere(c, glm::vec3(0.0f), 1.0f);
+    if (fresh.create_subtract(fresh.create_sphere(c, glm::vec3(4.0f, 0.0f, 0.0f), 1.0f),
+                              fresh.create_sphere(c, glm::vec3(4.0f, 0.0f, 0.0f), 0.3f)) == nullptr) {
+        return false;
+    }
+    std::vector<float> expected, expectedBvh;
+    fresh.generate_texture_data(expected, expectedBvh);
+
+    SceneEvaluator refinalized(again, bvh), reference(expected, expectedBvh);
+    for (const glm::vec3 &p: probes) {
+        if (std::abs(refinalized.map(p) - reference.map(p)) > 1e-6f) {
+            std::printf("[Error] finalize: re-finalized distance at (%g, %g, %g) is %g, expected %g\n",
+                        p.x, p.y, p.z, refinalized.map(p), reference.map(p));
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    int count = argc > 1 ? std::atoi(argv[1]) : (1 << 20);
+    const Color c = {1.0f, 1.0f, 1.0f, 1.0f};
+
+    std::vector<BenchCase> cases = {
+            {"sphere",      [&](CSG_tree &t) { t.create_sphere(c, glm::vec3(0.0f), 1.5f); }},
+            {"cuboid",      [&](CSG_tree &t) { t.create_cuboid(c, glm::vec3(0.0f), 2, 1.5f, 1, 0.4f, 0.3f, 0.2f); }},
+            {"cylinder",    [&](CSG_tree &t) { t.create_cylinder(c, glm::vec3(0, -1, 0), glm::vec3(0.5f, 1, 0.3f), 0.6f); }},
+            {"cone",        [&](CSG_tree &t) { t.create_cone(c, glm::vec3(0, -1, 0), glm::vec3(0, 1.5f, 0), 0.8f); }},
+            {"tetrahedron", [&](CSG_tree &t) {
+                t.create_tetrahedron(c, glm::vec3(0), glm::vec3(1.5f, 0, 0), glm::vec3(0, 1.5f, 0), glm::vec3(0, 0, 1.5f));
+            }},
+            {"plane",       [&](CSG_tree &t) { t.create_plane(c, glm::vec3(0, 1, 0), -1.0f); }},
+            {"menger",      [&](CSG_tree &t) { t.create_menger_sponge(c, glm::vec3(0.0f), 1.8f, 5); }},
+            {"mandelbulb",  [&](CSG_tree &t) { t.create_mandelbulb(c, glm::vec3(0.0f), 2.2f, 8.0f, 80); }},
+            {"julia",       [&](CSG_tree &t) {
+                t.create_julia_set_3d(c, glm::vec3(0.0f), 2.0f, glm::vec2(-0.75f, 0.11f), 64, false);
+            }},
+    };
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> uni(-3.0f, 3.0f);
+    std::vector<float> x(count), y(count), z(count), d(count);
+    for (int i = 0; i < count; ++i) {
+        x[i] = uni(rng);
+        y[i] = uni(rng);
+        z[i] = uni(rng);
+    }
+
+    std::printf("points: %d, batch ISA: %s (%d lanes)\n", count,
+                SceneEvaluator::batch_isa(), SceneEvaluator::batch_lanes());
+    std::printf("%-12s %16s %16s %9s\n", "primitive", "scalar pts/s", "batch pts/s", "speedup");
+
+    for (const BenchCase &bc: cases) {
+        CSG_tree tree;
+        bc.build(tree);
+        SceneEvaluator evaluator(tree.generate_texture_data());
+
+        volatile float sink = 0.0f;
+        double scalarTime = seconds([&] {
+            float acc = 0.0f;
+            for (int i = 0; i < count; ++i) acc += evaluator.map(glm::vec3(x[i], y[i], z[i]));
+            sink = acc;
+        });
+        double batchTime = seconds([&] {
+            evaluator.map_batch(x.data(), y.data(), z.data(), d.data(), count);
+        });
+        (void) sink;
+
+        std::printf("%-12s %16.3e %16.3e %8.2fx\n", bc.name,
+                    count / scalarTime, count / batchTime, scalarTime / batchTime);
+    }
+
+    // 场景规模：n 个随机球体与长方体散布在边长 40 的立方体中
+    int sceneCount = std::max(1, count / 16);
+    std::uniform_real_distribution<float> wide(-20.0f, 20.0f);
+    std::printf("\n%-12s %16s %16s %9s\n", "objects", "linear pts/s", "bvh pts/s", "speedup");
+    for (int n = 16; n <= 1024; n *= 4) {
+        CSG_tree tree;
+        for (int i = 0; i < n; ++i) {
+            glm::vec3 center(wide(rng), wide(rng), wide(rng));
+            if (i % 2 == 0) tree.create_sphere(c, center, 0.5f);
+            else tree.create_cuboid(c, center, 1.0f, 0.6f, 0.8f, 0.3f * i, 0.2f * i, 0.1f * i);
+        }
+        std::vector<float> bvhData;
+        auto data = tree.generate_texture_data(bvhData);
+        SceneEvaluator linear(data), culled(data, bvhData);
+
+        volatile float sink = 0.0f;
+        auto run = [&](const SceneEvaluator &evaluator) {
+            return seconds([&] {
+                float acc = 0.0f;
+                for (int i = 0; i < sceneCount; ++i) acc += evaluator.map(glm::vec3(x[i], y[i], z[i]) * 7.0f);
+                sink = acc;
+            });
+        };
+        double linearTime = run(linear), bvhTime = run(culled);
+        (void) sink;
+
+        std::printf("%-12d %16.3e %16.3e %8.2fx\n", n,
+                    sceneCount / linearTime, sceneCount / bvhTime, linearTime / bvhTime);
+    }
+
+    if (!check_refinalize()) {
+        return 1;
+    }
+
+    // 打包：首次定型 (栈顺序、后序、BVH) / 什么都没变时再次调用 / 移动 1% 物体后再次调用 / 只按现有排列重写数值
+    std::printf("\n%-12s %16s %16s %16s %16s\n", "objects", "build us", "cached us", "1% moved us", "repack us");
+    for (int n: {1000, 10000}) {
+        CSG_tree tree;
+        std::vector<Object *> objects;
+        std::uniform_real_distribution<float> wide(-40.0f, 40.0f);
+        for (int i = 0; i < n; ++i) {
+            glm::vec3 center(wide(rng), wide(rng), wide(rng));
+            if (i % 2 == 0) objects.push_back(tree.create_sphere(c, center, 0.5f));
+            else objects.push_back(tree.create_cuboid(c, center, 1.0f, 0.6f, 0.8f, 0.3f * i, 0.2f * i, 0.1f * i));
+        }
+        std::vector<float> program;
+        program.reserve(n * 2 * 32);
+
+        const int reps = 20;
+        double buildTime = seconds([&] { tree.finalize(); });
+        double cachedTime = seconds([&] {
+            for (int r = 0; r < reps; ++r) tree.finalize();
+        });
+        double movedTime = seconds([&] {
+            for (int r = 0; r < reps; ++r) {
+                for (int i = r; i < n; i += 100) objects[i]->translate(glm::vec3(0.0f, 0.01f, 0.0f));
+                tree.finalize();
+            }
+        });
+        program.resize(tree.texture_data_size() * 32);
+        double repackTime = seconds([&] {
+            for (int r = 0; r < reps; ++r) tree.pack_texture_data(program.data());
+        });
+        std::printf("%-12d %16.1f %16.1f %16.1f %16.1f\n", n, buildTime * 1e6,
+                    cachedTime / reps * 1e6, movedTime / reps * 1e6, repackTime / reps * 1e6);
+    }
+    return 0;
+}
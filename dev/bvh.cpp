@@ -0,0 +1,179 @@
+#include <glm/glm.hpp>
+#include <algorithm>
+#include "bvh.h"
+#include "objects.h"
+
+namespace Objects {
+
+    namespace {
+
+        AABB merge(const AABB &a, const AABB &b) {
+            AABB r;
+            r.min = glm::min(a.min, b.min);
+            r.max = glm::max(a.max, b.max);
+            r.bounded = a.bounded && b.bounded;
+            return r;
+        }
+
+        struct Builder {
+            std::vector<BVHMember> &members;
+            std::vector<float> &bvhData;
+            std::vector<GlueRecord> &glue;
+            int size;                                       // 已排好的指令条数
+            int run = -1;                                   // 正在累积的 MULTI_UNION 在 glue 中的下标
+            bool run_follows = false;                       // 该 MULTI_UNION 之前已有指令，结束后要与之求并
+
+            int new_node(const AABB &box) {
+                int index = static_cast<int>(bvhData.size()) / BVH_NODE_STRIDE;
+                bvhData.insert(bvhData.end(), {box.min.x, box.min.y, box.min.z, 0.0f,
+                                               box.max.x, box.max.y, box.max.z, 0.0f});
+                return index;
+            }
+
+            // 结束当前的 MULTI_UNION
+            void close_run() {
+                if (run < 0) return;
+                if (run_follows) {
+                    glue.push_back({size++, 0});
+                }
+                run = -1;
+            }
+
+            // 写出一个叶子，成员指令排在已有指令之后。
+            // 只有一条基元的成员 (最常见的情况) 连续排在同一个 MULTI_UNION 之后，线性求值时不再逐个 UNION
+            void emit_leaf(int node, const std::vector<int> &ids) {
+                if (ids.size() == 1 && members[ids[0]].count == 1) {
+                    if (run < 0) {
+                        run_follows = size > 0;
+                        run = static_cast<int>(glue.size());
+                        glue.push_back({size++, 0});
+                    }
+                    BVHMember &m = members[ids[0]];
+                    m.start = size++;
+                    m.leaf = node;
+                    glue[run].count += 1;
+                    bvhData[node * BVH_NODE_STRIDE + 3] = static_cast<float>(m.start);
+                    bvhData[node * BVH_NODE_STRIDE + 7] = 1.0f;
+                    return;
+                }
+                close_run();
+                bool first = size == 0;
+                int start = size;
+                for (size_t i = 0; i < ids.size(); ++i) {
+                    BVHMember &m = members[ids[i]];
+                    m.start = size;
+                    m.leaf = node;
+                    size += m.count;
+                    if (i > 0) glue.push_back({size++, 0});
+                }
+                bvhData[node * BVH_NODE_STRIDE + 3] = static_cast<float>(start);
+                bvhData[node * BVH_NODE_STRIDE + 7] = static_cast<float>(size - start);
+                if (!first) {
+                    glue.push_back({size++, 0});            // 与前面各段求并，仅供线性遍历使用
+                }
+            }
+
+            // 对 ids[lo, hi) 递归建树：沿质心分布最长的轴取中位数划分
+            int build(std::vector<int> &ids, int lo, int hi) {
+                AABB box = members[ids[lo]].box;
+                glm::vec3 cmin = (box.min + box.max) * 0.5f, cmax = cmin;
+                for (int i = lo + 1; i < hi; ++i) {
+                    const AABB &b = members[ids[i]].box;
+                    box = merge(box, b);
+                    glm::vec3 c = (b.min + b.max) * 0.5f;
+                    cmin = glm::min(cmin, c);
+                    cmax = glm::max(cmax, c);
+                }
+                int node = new_node(box);
+                if (hi - lo == 1) {
+                    emit_leaf(node, std::vector<int>(1, ids[lo]));
+                    return node;
+                }
+
+                glm::vec3 ext = cmax - cmin;
+                int axis = ext.x >= ext.y && ext.x >= ext.z ? 0 : (ext.y >= ext.z ? 1 : 2);
+                int mid = (lo + hi) / 2;
+                std::nth_element(ids.begin() + lo, ids.begin() + mid, ids.begin() + hi, [&](int a, int b) {
+                    const AABB &ba = members[a].box, &bb = members[b].box;
+                    return ba.min[axis] + ba.max[axis] < bb.min[axis] + bb.max[axis];
+                });
+
+                build(ids, lo, mid);                        // 左子节点 = node + 1
+                int right = build(ids, mid, hi);
+                bvhData[node * BVH_NODE_STRIDE + 3] = static_cast<float>(right);
+                return node;
+            }
+        };
+
+    }
+
+    int build_bvh(std::vector<BVHMember> &members,
+                  std::vector<float> &bvhData,
+                  std::vector<GlueRecord> &glue) {
+        bvhData.clear();
+        glue.clear();
+
+        std::vector<int> bounded, unbounded;
+        for (int i = 0; i < static_cast<int>(members.size()); ++i) {
+            (members[i].box.bounded ? bounded : unbounded).push_back(i);
+        }
+        if (members.empty()) return 0;
+
+        Builder builder{members, bvhData, glue, 0};
+        AABB infinite;
+        infinite.min = glm::vec3(-BVH_INFINITY);
+        infinite.max = glm::vec3(BVH_INFINITY);
+
+        if (unbounded.empty()) {
+            builder.build(bounded, 0, static_cast<int>(bounded.size()));
+            builder.close_run();
+            return builder.size;
+        }
+        // 根节点：左侧为无界成员组成的叶子 (地面等，通常最先给出较小的距离)，右侧为有界成员的子树
+        int root = bounded.empty() ? -1 : builder.new_node(infinite);
+        int leaf = builder.new_node(infinite);
+        builder.emit_leaf(leaf, unbounded);
+        if (root >= 0) {
+            int right = builder.build(bounded, 0, static_cast<int>(bounded.size()));
+            bvhData[root * BVH_NODE_STRIDE + 3] = static_cast<float>(right);
+        }
+        builder.close_run();
+        return builder.size;
+    }
+
+    void write_glue_record(float *dst, int count) {
+        std::fill(dst, dst + 32, 0.0f);
+        dst[0] = static_cast<float>(count > 0 ? MULTI_UNION : UNION);
+        dst[1] = dst[2] = dst[3] = dst[4] = 1.0f;
+        dst[5] = static_cast<float>(count);
+    }
+
+    void refit_bvh(std::vector<float> &bvhData, const std::vector<int> &leaves, std::vector<int> &nodes) {
+        nodes.clear();
+        for (int leaf: leaves) {
+            // 从根往下走：左子树是 [node + 1, 右子节点)，叶子下标落在哪一边就往哪一边走
+            int node = 0;
+            while (node != leaf) {
+                nodes.push_back(node);
+                const float *n = &bvhData[node * BVH_NODE_STRIDE];
+                int right = static_cast<int>(n[3]);
+                node = leaf < right ? node + 1 : right;
+            }
+            nodes.push_back(leaf);
+        }
+        std::sort(nodes.begin(), nodes.end());
+        nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+        // 子节点的下标总比父节点大，从后往前拟合时子节点已经更新过
+        for (auto it = nodes.rbegin(); it != nodes.rend(); ++it) {
+            float *n = &bvhData[*it * BVH_NODE_STRIDE];
+            if (n[7] != 0.0f) continue;                     // 叶子
+            const float *l = &bvhData[(*it + 1) * BVH_NODE_STRIDE];
+            const float *r = &bvhData[static_cast<int>(n[3]) * BVH_NODE_STRIDE];
+            for (int k = 0; k < 3; ++k) {
+                n[k] = std::min(l[k], r[k]);
+                n[4 + k] = std::max(l[4 + k], r[4 + k]);
+            }
+        }
+    }
+
+}
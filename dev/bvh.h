@@ -0,0 +1,54 @@
+#ifndef ISR_BVH_H
+#define ISR_BVH_H
+
+#include <glm/vec3.hpp>
+#include <vector>
+
+namespace Objects {
+
+    // 轴对齐包围盒，bounded == false 表示无界 (平面或含平面的并集)
+    struct AABB {
+        glm::vec3 min = glm::vec3(0.0f);
+        glm::vec3 max = glm::vec3(0.0f);
+        bool bounded = false;
+    };
+
+    // 根部并集的一个成员：包围盒 + 该成员子树的后序指令条数。
+    // start / leaf 由 build_bvh() 填写：指令在程序中的起始下标与所在叶子节点
+    struct BVHMember {
+        AABB box;
+        int count = 0;
+        int start = 0;
+        int leaf = -1;
+    };
+
+    // BVH 节点在 TBO 中占 2 个 texel (8 float)，按深度优先顺序存放，左子节点紧跟在父节点之后：
+    //   texel 0 = (min.xyz, 内部节点: 右子节点下标 / 叶子: 指令起始下标)
+    //   texel 1 = (max.xyz, 内部节点: 0 / 叶子: 指令条数)
+    // 每个叶子恰好对应一个成员；无界成员合并为一个包围盒为 ±BVH_INFINITY 的叶子，总会被访问。
+    const int BVH_NODE_STRIDE = 8;
+    const float BVH_INFINITY = 1e30f;
+
+    // build_bvh 在各段之间插入的指令：count == 0 为 UNION；否则为 MULTI_UNION，
+    // 把其后连续 count 条单基元成员并入栈中同一格 (BVH 叶子仍各自指向其中的一条)
+    struct GlueRecord {
+        int slot;
+        int count;
+    };
+
+    // 构建 BVH 并确定各成员指令的排列 (members[i].start)，返回总指令条数。
+    // 插入的 UNION / MULTI_UNION 写入 glue，使整段程序本身仍可线性求值
+    int build_bvh(std::vector<BVHMember> &members,
+                  std::vector<float> &bvhData,
+                  std::vector<GlueRecord> &glue);
+
+    // 写出 glue 对应的 32 float 记录
+    void write_glue_record(float *dst, int count);
+
+    // 拓扑不变时的重新拟合：只把 leaves 的祖先节点的包围盒设为两个子节点的并。
+    // 叶子的包围盒需先由调用方写好；nodes 接收改动的节点 (leaves 及其祖先，升序、不重复)
+    void refit_bvh(std::vector<float> &bvhData, const std::vector<int> &leaves, std::vector<int> &nodes);
+
+}
+
+#endif //ISR_BVH_H
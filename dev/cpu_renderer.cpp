@@ -0,0 +1,246 @@
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include "cpu_renderer.h"
+
+namespace Objects {
+
+    namespace {
+
+        const float PI = 3.14159265358979f;
+
+        // 以下函数与 raymarch.frag 中同名函数一一对应，常量保持一致
+
+        float march(const SceneEvaluator &scene, const glm::vec3 &ro, const glm::vec3 &rd,
+                    glm::vec3 &pos, glm::vec3 &col, int &matID, float &matPar) {
+            const float EPS = 1e-5f;
+            const float TMAX = 100.0f;
+            float t = 0.0f;
+            for (int i = 0; i < 1024; ++i) {
+                pos = ro + rd * t;
+                float d = scene.map(pos, col, matID, matPar);
+                if (d < EPS) return t;
+                t += d * 0.7f;
+                if (t > TMAX) break;
+            }
+            return -1.0f;
+        }
+
+        glm::vec3 calcNormal(const SceneEvaluator &scene, const glm::vec3 &p) {
+            const float h = 5e-5f;
+            glm::vec3 n(
+                    scene.map(p + glm::vec3(h, 0, 0)) - scene.map(p - glm::vec3(h, 0, 0)),
+                    scene.map(p + glm::vec3(0, h, 0)) - scene.map(p - glm::vec3(0, h, 0)),
+                    scene.map(p + glm::vec3(0, 0, h)) - scene.map(p - glm::vec3(0, 0, h))
+            );
+            return glm::normalize(n);
+        }
+
+        float softShadow(const SceneEvaluator &scene, const glm::vec3 &ro, const glm::vec3 &rd, float mint, float maxt) {
+            float res = 1.0f;
+            float t = mint;
+            for (int i = 0; i < 128 && t < maxt; ++i) {
+                float h = scene.map(ro + rd * t);
+                if (h < 5e-5f) return 0.0f;
+                res = std::min(res, 8.0f * h / t);
+                t += glm::clamp(h, 0.02f, 0.25f);
+            }
+            return glm::clamp(res, 0.0f, 1.0f);
+        }
+
+        float calcAO(const SceneEvaluator &scene, const glm::vec3 &p, const glm::vec3 &n) {
+            float occ = 0.0f;
+            float w = 1.0f;
+            for (int i = 1; i <= 16; ++i) {
+                float dist = 0.02f * float(i);
+                float d = scene.map(p + n * dist);
+                occ += (dist - d) * w;
+                w *= 0.6f;
+            }
+            return glm::clamp(1.0f - occ, 0.0f, 1.0f);
+        }
+
+        glm::vec3 diffuseShading(const SceneEvaluator &scene, const glm::vec3 &pos, const glm::vec3 &n,
+                                 const glm::vec3 &viewDir, const glm::vec3 &albedo) {
+            glm::vec3 skyCol(0.24f, 0.32f, 0.45f);
+            glm::vec3 groundCol(0.18f, 0.15f, 0.13f);
+            glm::vec3 hemi = glm::mix(groundCol, skyCol, n.y * 0.5f + 0.5f);
+
+            glm::vec3 kDir = glm::normalize(glm::vec3(0.5f, 0.7f, -0.4f));
+            glm::vec3 fDir = glm::normalize(glm::vec3(-0.4f, 0.3f, 0.5f));
+            glm::vec3 lightCol(1.08f, 0.97f, 0.90f);
+
+            float kShadow = softShadow(scene, pos + n * 1e-3f, kDir, 0.05f, 20.0f);
+
+            float kDiff = std::max(glm::dot(n, kDir), 0.0f) * kShadow;
+            float fDiff = std::max(glm::dot(n, fDir), 0.0f);
+
+            glm::vec3 halfK = glm::normalize(kDir + viewDir);
+            glm::vec3 halfF = glm::normalize(fDir + viewDir);
+            float kSpec = std::pow(std::max(glm::dot(n, halfK), 0.0f), 64.0f) * kShadow;
+            float fSpec = std::pow(std::max(glm::dot(n, halfF), 0.0f), 64.0f);
+
+            float ao = calcAO(scene, pos, n);
+
+            return albedo * (hemi * 0.6f * ao + lightCol * (0.9f * kDiff + 0.4f * fDiff))
+                   + lightCol * 0.4f * (kSpec + fSpec);
+        }
+
+    }
+
+    glm::vec3 EnvironmentMap::sample(const glm::vec3 &dir) const {
+        if (empty() || glm::dot(dir, dir) == 0.0f) return glm::vec3(0.0f);
+
+        // equirectToCubemap() 绘制每个面时最终留下的是 +Z 四边形，
+        // 推导可得 cubemap 方向 d 对应经纬图中的方向 (d.x, d.y, -d.z)
+        glm::vec3 d = glm::normalize(glm::vec3(dir.x, dir.y, -dir.z));
+        float u = std::atan2(d.z, d.x) / (2.0f * PI) + 0.5f;
+        float v = std::asin(glm::clamp(d.y, -1.0f, 1.0f)) / PI + 0.5f;
+
+        // 双线性采样：水平方向循环，垂直方向 clamp
+        float fx = u * width - 0.5f;
+        float fy = (1.0f - v) * height - 0.5f;
+        int x0 = int(std::floor(fx)), y0 = int(std::floor(fy));
+        float ax = fx - x0, ay = fy - y0;
+        auto texel = [&](int x, int y) {
+            x = ((x % width) + width) % width;
+            y = std::min(std::max(y, 0), height - 1);
+            const float *p = &rgb[(size_t(y) * width + x) * 3];
+            return glm::vec3(p[0], p[1], p[2]);
+        };
+        glm::vec3 top = glm::mix(texel(x0, y0), texel(x0 + 1, y0), ax);
+        glm::vec3 bottom = glm::mix(texel(x0, y0 + 1), texel(x0 + 1, y0 + 1), ax);
+        return glm::mix(top, bottom, ay);
+    }
+
+    CpuRenderer::CpuRenderer(const SceneEvaluator &scene, const RenderSettings &settings)
+            : scene(scene), settings(settings) {
+        this->settings.tile_size = std::max(1, settings.tile_size);
+    }
+
+    // (fx, fy) 为 [0,1] 的屏幕坐标，原点在左下角 (与 fragCoord 相同)
+    glm::vec3 CpuRenderer::shade_sample(float fx, float fy, glm::vec3 &linear) const {
+        glm::vec2 uv(fx * 2.0f - 1.0f, fy * 2.0f - 1.0f);
+        uv.x *= float(settings.width) / float(settings.height);
+
+        glm::vec3 ro = settings.camera_pos;
+        glm::vec3 rd = glm::normalize(glm::vec3(uv.x, uv.y, 1.0f));
+        float pitch = glm::radians(settings.camera_pitch);
+        float c = std::cos(pitch), s = std::sin(pitch);
+        rd = glm::vec3(rd.x, c * rd.y + s * rd.z, -s * rd.y + c * rd.z);
+
+        glm::vec3 accumColor(0.0f);
+        glm::vec3 throughput(1.0f);
+
+        for (int bounce = 0; bounce < settings.max_bounces; bounce++) {
+            glm::vec3 hitPos, baseCol;
+            int hitMat;
+            float hitPar;
+
+            float t = march(scene, ro, rd, hitPos, baseCol, hitMat, hitPar);
+
+            if (t < 0.0f) {
+                accumColor += throughput * env.sample(rd);
+                break;
+            }
+
+            glm::vec3 n = calcNormal(scene, hitPos);
+            glm::vec3 viewDir = glm::normalize(-rd);
+
+            if (hitMat == 0) {
+                accumColor += throughput * diffuseShading(scene, hitPos, n, viewDir, baseCol);
+                break;
+            } else if (hitMat == 1) {
+                rd = glm::reflect(rd, n);
+                ro = hitPos + n * 1e-3f;
+                throughput *= baseCol * 0.8f;
+            } else if (hitMat == 2) {
+                bool into = glm::dot(rd, n) < 0.0f;
+                float n1 = 1.0f, n2 = hitPar;
+                float eta = into ? n1 / n2 : n2 / n1;
+
+                float cosI = glm::clamp(glm::dot(-rd, n), 0.0f, 1.0f);
+                float F0 = std::pow((n1 - n2) / (n1 + n2), 2.0f);
+                float Fr = F0 + (1.0f - F0) * std::pow(1.0f - cosI, 5.0f);
+
+                glm::vec3 reflDir = glm::reflect(rd, n);
+                glm::vec3 refrDir = glm::refract(rd, into ? n : -n, eta);
+
+                glm::vec3 cRefl, reflPos;
+                int idD;
+                float pD;
+                float tRefl = march(scene, hitPos + n * 1e-3f, reflDir, reflPos, cRefl, idD, pD);
+                glm::vec3 reflCol = (tRefl < 0.0f) ? env.sample(reflDir) : cRefl;
+                glm::vec3 refrCol = env.sample(refrDir);
+
+                accumColor += throughput * glm::mix(refrCol, reflCol, Fr);
+                break;
+            }
+
+            float maxComponent = std::max(std::max(throughput.x, throughput.y), throughput.z);
+            if (maxComponent < 0.01f) break;
+        }
+
+        linear = accumColor;
+
+        // 曝光 + ACES + 饱和度 + gamma
+        glm::vec3 m = accumColor * 0.9f;
+        m = (m * (2.51f * m + 0.03f)) / (m * (2.43f * m + 0.59f) + 0.14f);
+        float Y = glm::dot(m, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+        m = glm::mix(glm::vec3(Y), m, 1.5f);
+        return glm::vec3(std::pow(m.x, 1.0f / 2.2f), std::pow(m.y, 1.0f / 2.2f), std::pow(m.z, 1.0f / 2.2f));
+    }
+
+    void CpuRenderer::render_tile(int tx, int ty, std::vector<float> &ldr, std::vector<float> &hdr) const {
+        const int W = settings.width, H = settings.height, T = settings.tile_size;
+        const int samples = settings.ssaa ? 4 : 1;
+        int x1 = std::min(tx + T, W), y1 = std::min(ty + T, H);
+        for (int py = ty; py < y1; py++) {
+            for (int px = tx; px < x1; px++) {
+                glm::vec3 display(0.0f), linear(0.0f);
+                for (int i = 0; i < samples; i++) {
+                    float ox = 0.0f, oy = 0.0f;
+                    if (settings.ssaa) {
+                        ox = float(i % 2) * 0.5f - 0.25f;
+                        oy = float(i / 2) * 0.5f - 0.25f;
+                    }
+                    glm::vec3 lin;
+                    display += shade_sample((px + 0.5f + ox) / W, (py + 0.5f + oy) / H, lin);
+                    linear += lin;
+                }
+                // fragCoord 的 y 轴向上，图像第 0 行在顶部
+                size_t idx = (size_t(H - 1 - py) * W + px) * 3;
+                for (int c = 0; c < 3; c++) {
+                    ldr[idx + c] = display[c] / float(samples);
+                    hdr[idx + c] = linear[c] / float(samples);
+                }
+            }
+        }
+    }
+
+    void CpuRenderer::render(std::vector<float> &ldr, std::vector<float> &hdr) const {
+        const int W = settings.width, H = settings.height, T = settings.tile_size;
+        ldr.assign(size_t(W) * H * 3, 0.0f);
+        hdr.assign(size_t(W) * H * 3, 0.0f);
+
+        int tilesX = (W + T - 1) / T, tilesY = (H + T - 1) / T;
+        int numTiles = tilesX * tilesY;
+        int numThreads = settings.threads > 0 ? settings.threads : int(std::thread::hardware_concurrency());
+        numThreads = std::max(1, std::min(numThreads, numTiles));
+
+        // 每个 tile 只写自己的像素区域，无需加锁
+        std::atomic<int> next(0);
+        auto worker = [&]() {
+            for (int tile = next++; tile < numTiles; tile = next++)
+                render_tile((tile % tilesX) * T, (tile / tilesX) * T, ldr, hdr);
+        };
+
+        std::vector<std::thread> pool;
+        for (int i = 1; i < numThreads; i++) pool.emplace_back(worker);
+        worker();
+        for (auto &th : pool) th.join();
+    }
+
+}
@@ -0,0 +1,61 @@
+#ifndef ISR_CPU_RENDERER_H
+#define ISR_CPU_RENDERER_H
+
+#include <glm/vec3.hpp>
+#include <utility>
+#include <vector>
+#include "evaluator.h"
+
+namespace Objects {
+
+    struct RenderSettings {
+        int width = 1280;
+        int height = 720;
+        int threads = 0;                // 0 = std::thread::hardware_concurrency()
+        int tile_size = 32;             // 线程按 tile 领取任务
+        bool ssaa = true;               // 对应 shader 中的 ENABLE_AA (2x2 超采样)
+        int max_bounces = 4;
+        glm::vec3 camera_pos = glm::vec3(0.0f, 4.0f, -6.0f);
+        float camera_pitch = -15.0f;    // 角度
+    };
+
+    // 经纬度 (equirect) 环境贴图，rgb 第 0 行为图像顶部；
+    // 方向到纹理坐标的映射与 main.cpp 中 equirectToCubemap() 烘焙出的 cubemap 一致
+    struct EnvironmentMap {
+        int width = 0;
+        int height = 0;
+        std::vector<float> rgb;
+
+        bool empty() const { return rgb.empty(); }
+
+        glm::vec3 sample(const glm::vec3 &dir) const;
+    };
+
+    // 无窗口的 CPU 光线步进器，逐像素复现 raymarch.frag 的 main()：
+    // 超采样、多次反射/折射、软阴影、AO 与色调映射。
+    // 图像切成 tile_size × tile_size 的块，工作线程通过原子计数器领取，彼此不共享可写数据
+    class CpuRenderer {
+        const SceneEvaluator &scene;
+        RenderSettings settings;
+        EnvironmentMap env;
+
+        glm::vec3 shade_sample(float fx, float fy, glm::vec3 &linear) const;
+
+        void render_tile(int tx, int ty, std::vector<float> &ldr, std::vector<float> &hdr) const;
+
+    public:
+        CpuRenderer(const SceneEvaluator &scene, const RenderSettings &settings);
+
+        void set_environment(EnvironmentMap map) { env = std::move(map); }
+
+        const RenderSettings &get_settings() const { return settings; }
+
+        // ldr: 色调映射 + gamma 之后的显示颜色 (与屏幕输出相同)
+        // hdr: 色调映射之前的线性颜色
+        // 均为 width * height * 3 float，第 0 行为图像顶部
+        void render(std::vector<float> &ldr, std::vector<float> &hdr) const;
+    };
+
+}
+
+#endif //ISR_CPU_RENDERER_H
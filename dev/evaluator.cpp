@@ -0,0 +1,504 @@
+#include <glm/glm.hpp>
+#include <iostream>
+#include "objects.h"
+#include "evaluator.h"
+#include "bvh.h"
+
+// 以下 SDF 函数逐行对应 shaders/raymarch.frag，修改时请两边同步
+
+static float sdSphere(const glm::vec3 &p, float r) {
+    return glm::length(p) - r;
+}
+
+static float sdBox(const glm::vec3 &p, float alpha, float beta, float gamma, const glm::vec3 &b) {
+    // 与 GLSL 相同的列主序构造
+    glm::mat3 Rz_alpha(
+            std::cos(alpha), -std::sin(alpha), 0.0f,
+            std::sin(alpha), std::cos(alpha), 0.0f,
+            0.0f, 0.0f, 1.0f);
+    glm::mat3 Rx_beta(
+            1.0f, 0.0f, 0.0f,
+            0.0f, std::cos(beta), -std::sin(beta),
+            0.0f, std::sin(beta), std::cos(beta));
+    glm::mat3 Rz_gamma(
+            std::cos(gamma), -std::sin(gamma), 0.0f,
+            std::sin(gamma), std::cos(gamma), 0.0f,
+            0.0f, 0.0f, 1.0f);
+
+    glm::mat3 R = Rz_gamma * Rx_beta * Rz_alpha;
+    glm::vec3 q = glm::abs(R * p) - b;
+    return glm::length(glm::max(q, 0.0f)) + std::min(std::max(q.x, std::max(q.y, q.z)), 0.0f);
+}
+
+static float sdCylinderFlat(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b, float r) {
+    glm::vec3 ba = b - a;
+    float h2 = glm::length(ba) * 0.5f;
+    glm::vec3 axis = ba / (h2 * 2.0f);
+    glm::vec3 mid = (a + b) * 0.5f;
+
+    glm::vec3 up = std::abs(axis.z) < 0.999f ? glm::vec3(0, 0, 1) : glm::vec3(1, 0, 0);
+    glm::vec3 x = glm::normalize(glm::cross(up, axis));
+    glm::vec3 y = glm::cross(axis, x);
+
+    glm::vec3 lp(glm::dot(p - mid, x),
+                 glm::dot(p - mid, y),
+                 glm::dot(p - mid, axis));
+
+    glm::vec2 d = glm::abs(glm::vec2(glm::length(glm::vec2(lp.x, lp.y)), lp.z)) - glm::vec2(r, h2);
+    return std::min(std::max(d.x, d.y), 0.0f) + glm::length(glm::max(d, glm::vec2(0.0f)));
+}
+
+static float sdCone(const glm::vec3 &p, const glm::vec2 &c, float h) {
+    glm::vec2 q = h * glm::vec2(c.x / c.y, -1.0f);
+
+    glm::vec2 w(glm::length(glm::vec2(p.x, p.z)), p.y);
+    glm::vec2 a = w - q * glm::clamp(glm::dot(w, q) / glm::dot(q, q), 0.0f, 1.0f);
+    glm::vec2 b = w - q * glm::vec2(glm::clamp(w.x / q.x, 0.0f, 1.0f), 1.0f);
+    float k = glm::sign(q.y);
+    float d = std::min(glm::dot(a, a), glm::dot(b, b));
+    float s = std::max(k * (w.x * q.y - w.y * q.x), k * (w.y - q.y));
+    return std::sqrt(d) * glm::sign(s);
+}
+
+static float sdTetrahedron(const glm::vec3 &p, const glm::vec3 &v0, const glm::vec3 &v1,
+                           const glm::vec3 &v2, const glm::vec3 &v3) {
+    const glm::vec3 verts[4] = {v0, v1, v2, v3};
+    static const int faces[4][3] = {
+            {0, 1, 2},
+            {0, 2, 3},
+            {0, 3, 1},
+            {1, 3, 2}
+    };
+
+    glm::vec3 cen = (v0 + v1 + v2 + v3) * 0.25f;
+
+    float dMax = -1e20f;
+    for (int i = 0; i < 4; ++i) {
+        const glm::vec3 &a = verts[faces[i][0]];
+        const glm::vec3 &b = verts[faces[i][1]];
+        const glm::vec3 &c = verts[faces[i][2]];
+
+        glm::vec3 n = glm::normalize(glm::cross(b - a, c - a));
+        if (glm::dot(cen - a, n) > 0.0f)
+            n = -n;
+
+        dMax = std::max(dMax, glm::dot(p - a, n));
+    }
+    return dMax;
+}
+
+static float sdPlane(const glm::vec3 &p, const glm::vec3 &n, float h) {
+    return glm::dot(p, n) + h;
+}
+
+static float sdMengerSponge(glm::vec3 p, float size, int iterations) {
+    p = p / size;
+
+    float d = sdBox(p, 0.0f, 0.0f, 0.0f, glm::vec3(1.0f));
+
+    float s = 1.0f;
+    for (int m = 0; m < iterations; m++) {
+        glm::vec3 a = glm::mod(p * s, 2.0f) - 1.0f;
+        s *= 3.0f;
+
+        glm::vec3 r = glm::abs(1.0f - 3.0f * glm::abs(a));
+
+        float c1 = sdBox(r, 0.0f, 0.0f, 0.0f, glm::vec3(2.0f, 1.0f, 1.0f)) / s;
+        float c2 = sdBox(r, 0.0f, 0.0f, 0.0f, glm::vec3(1.0f, 2.0f, 1.0f)) / s;
+        float c3 = sdBox(r, 0.0f, 0.0f, 0.0f, glm::vec3(1.0f, 1.0f, 2.0f)) / s;
+
+        d = std::max(d, std::min(std::min(c1, c2), c3));
+    }
+    return d * size;
+}
+
+static float sdMandelbulb(const glm::vec3 &p, const glm::vec3 &center, float scale, float power, int maxIter) {
+    glm::vec3 w = (p - center) / scale;
+    float m = glm::dot(w, w);
+    float dz = 1.0f;
+
+    for (int i = 0; i < maxIter; i++) {
+        if (m > 4.0f) break;
+
+        dz = power * std::pow(std::sqrt(m), power - 1.0f) * dz + 1.0f;
+
+        float r = glm::length(w);
+        float b = power * std::acos(w.y / r);
+        float a = power * std::atan2(w.x, w.z);
+        w = std::pow(r, power) * glm::vec3(std::sin(b) * std::sin(a),
+                                           std::cos(b),
+                                           std::sin(b) * std::cos(a)) + (p - center) / scale;
+        m = glm::dot(w, w);
+    }
+    return 0.25f * std::log(m) * std::sqrt(m) / dz * scale;
+}
+
+static glm::vec3 palette(float t, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, const glm::vec3 &d) {
+    glm::vec3 phase = 6.28318f * (c * t + d);
+    return a + b * glm::vec3(std::cos(phase.x), std::cos(phase.y), std::cos(phase.z));
+}
+
+static float sdJuliaSet3D_WithColor(const glm::vec3 &p, const glm::vec3 &center, float scale, const glm::vec2 &c,
+                                    int maxIter, bool useOrbitTrap, const glm::vec3 &baseColor, glm::vec3 &color) {
+    glm::vec3 z = (p - center) / scale;
+    float m2 = 0.0f;
+    float dz = 1.0f;
+    float trap = 1e10f;
+    int actualIterations = 0;
+
+    for (int i = 0; i < maxIter; i++) {
+        actualIterations = i;
+        m2 = glm::dot(z, z);
+
+        if (m2 > 16.0f) {
+            break;
+        }
+
+        if (useOrbitTrap) {
+            trap = std::min(trap, glm::length(z));
+            trap = std::min(trap, std::min(std::abs(z.x), std::abs(z.y)));
+            trap = std::min(trap, std::abs(glm::length(glm::vec2(z.x, z.y)) - 1.0f));
+        }
+
+        dz = 2.0f * std::sqrt(m2) * dz + 1.0f;
+
+        float x = z.x, y = z.y, zz = z.z;
+        z = glm::vec3(x * x - y * y - zz * zz + c.x,
+                      2.0f * x * y + c.y,
+                      2.0f * x * zz);
+    }
+
+    float d;
+    if (m2 > 16.0f) {
+        d = 0.5f * std::sqrt(m2) * std::log(m2) / dz * scale;
+    } else {
+        d = -0.1f * scale;
+    }
+
+    color = baseColor;
+    if (useOrbitTrap) {
+        float t_iter = float(actualIterations) / float(maxIter);
+        float t_trap = 1.0f - std::exp(-1.5f * trap);
+
+        glm::vec3 pal_a = baseColor * 0.5f + 0.2f;
+        glm::vec3 pal_b(0.5f);
+        glm::vec3 pal_c(1.0f, 1.0f, 1.0f);
+        glm::vec3 pal_d(baseColor.y, baseColor.z, baseColor.x);
+
+        glm::vec3 dynamic_freq = glm::mix(glm::vec3(1.0f), pal_c * glm::vec3(2.0f, 3.0f, 4.0f), t_iter);
+        color = palette(t_trap, pal_a, pal_b, dynamic_freq, pal_d);
+    }
+    color = glm::clamp(color, 0.0f, 1.0f);
+    return d;
+}
+
+namespace Objects {
+
+    namespace {
+        // 点到包围盒的有符号距离，node 指向 BVH 节点的 8 个 float (min, *, max, *)
+        float sdAABB(const glm::vec3 &p, const float *node) {
+            glm::vec3 bmin(node[0], node[1], node[2]), bmax(node[4], node[5], node[6]);
+            glm::vec3 q = glm::abs(p - (bmin + bmax) * 0.5f) - (bmax - bmin) * 0.5f;
+            return glm::length(glm::max(q, glm::vec3(0.0f))) + std::min(std::max(q.x, std::max(q.y, q.z)), 0.0f);
+        }
+
+        // 对应 shader 中 stack / matIDStack / matParStack 三个并行栈的同一层
+        struct StackEntry {
+            glm::vec3 col;
+            float d;
+            int mat_id;
+            float mat_par;
+        };
+
+        inline glm::vec3 vec3At(const float *v) {
+            return glm::vec3(v[0], v[1], v[2]);
+        }
+
+        // MULTI_UNION / MULTI_INTERSECTION 之后还有 left 条基元要并入栈顶
+        struct FoldState {
+            int type = 0;
+            int left = 0;
+        };
+
+        void distOne(const float *rec, const glm::vec3 &p, StackEntry *stack, int &stack_top, FoldState &fold) {
+            // rec[0]=type, rec[1..4]=RGBA, rec[5 + i]=pos_args[i]
+            int type = int(rec[0] + 0.5f);
+            glm::vec3 curColor(rec[1], rec[2], rec[3]);
+            const float *pos = rec + 5;
+
+            // 累积时新结果直接与栈顶合并，选择规则与两两的 UNION / INTERSECTION 相同
+            auto push = [&](const glm::vec3 &col, float d, float texture, float para) {
+                StackEntry e = {col, d, int(texture + 0.5f), para};
+                if (fold.left > 0) {
+                    StackEntry &top = stack[stack_top - 1];
+                    bool take = fold.type == MULTI_UNION ? d < top.d : d >= top.d;
+                    if (take) top = e;
+                    fold.left -= 1;
+                    return;
+                }
+                stack[stack_top] = e;
+                stack_top += 1;
+            };
+
+            switch (type) {
+                case SPHERE:
+                    push(curColor, sdSphere(p - vec3At(pos), pos[3]), pos[4], pos[5]);
+                    break;
+                case CONE: {
+                    glm::vec3 center = vec3At(pos);
+                    glm::vec3 vertex = vec3At(pos + 3);
+                    float radius = pos[6];
+
+                    glm::vec3 axis = glm::normalize(center - vertex);
+                    float height = glm::length(center - vertex);
+
+                    glm::vec3 up = std::abs(axis.y) < 0.999f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0);
+                    glm::vec3 x = glm::normalize(glm::cross(up, axis));
+                    glm::vec3 z = glm::cross(axis, x);
+
+                    glm::mat3 basis(x, -axis, z);
+                    glm::vec3 p_local = glm::transpose(basis) * (p - vertex);
+
+                    float angle = std::atan2(radius, height);
+                    glm::vec2 c(std::sin(angle), std::cos(angle));
+
+                    push(curColor, sdCone(p_local, c, height), pos[7], pos[8]);
+                    break;
+                }
+                case CYLINDER:
+                    push(curColor, sdCylinderFlat(p, vec3At(pos), vec3At(pos + 3), pos[6]), pos[7], pos[8]);
+                    break;
+                case CUBOID: {
+                    glm::vec3 halfExt = vec3At(pos + 3) * 0.5f;
+                    push(curColor, sdBox(p - vec3At(pos), pos[6], pos[7], pos[8], halfExt), pos[9], pos[10]);
+                    break;
+                }
+                case TETRAHEDRON:
+                    push(curColor, sdTetrahedron(p, vec3At(pos), vec3At(pos + 3), vec3At(pos + 6), vec3At(pos + 9)),
+                         pos[12], pos[13]);
+                    break;
+                case INTERSECTION: {
+                    // step(sdf1, sdf2) == 1 时取第二个操作数
+                    const StackEntry &a = stack[stack_top - 2];
+                    const StackEntry &b = stack[stack_top - 1];
+                    StackEntry r = (b.d >= a.d) ? b : a;
+                    stack_top -= 1;
+                    stack[stack_top - 1] = r;
+                    break;
+                }
+                case UNION: {
+                    const StackEntry &a = stack[stack_top - 2];
+                    const StackEntry &b = stack[stack_top - 1];
+                    StackEntry r = (b.d >= a.d) ? a : b;
+                    stack_top -= 1;
+                    stack[stack_top - 1] = r;
+                    break;
+                }
+                case DIFFERENCE: {
+                    const StackEntry &a = stack[stack_top - 2];
+                    StackEntry b = stack[stack_top - 1];
+                    b.d = -b.d;
+                    StackEntry r = (b.d >= a.d) ? b : a;
+                    stack_top -= 1;
+                    stack[stack_top - 1] = r;
+                    break;
+                }
+                case MULTI_UNION:
+                case MULTI_INTERSECTION:
+                    // 累积格的初值是运算的单位元，第一条基元总会取代它
+                    stack[stack_top] = {glm::vec3(0.0f), type == MULTI_UNION ? BVH_INFINITY : -BVH_INFINITY, 0, 0.0f};
+                    stack_top += 1;
+                    fold.type = type;
+                    fold.left = int(pos[0] + 0.5f);
+                    break;
+                case PLANE:
+                    push(curColor, sdPlane(p, vec3At(pos), pos[3]), pos[4], pos[5]);
+                    break;
+                case MENGER_SPONGE:
+                    push(curColor, sdMengerSponge(p - vec3At(pos), pos[3], int(pos[4] + 0.5f)), pos[5], pos[6]);
+                    break;
+                case MANDELBULB:
+                    push(curColor, sdMandelbulb(p, vec3At(pos), pos[3], pos[4], int(pos[5] + 0.5f)), pos[6], pos[7]);
+                    break;
+                case JULIA_SET_3D: {
+                    glm::vec3 col;
+                    float d = sdJuliaSet3D_WithColor(p, vec3At(pos), pos[3], glm::vec2(pos[4], pos[5]),
+                                                     int(pos[6] + 0.5f), pos[7] > 0.5f, curColor, col);
+                    push(col, d, pos[8], pos[9]);
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+    }
+
+    SceneEvaluator::SceneEvaluator(const std::vector<std::vector<float>> &textureData,
+                                   const std::vector<float> &bvhData) {
+        load(textureData, bvhData);
+    }
+
+    SceneEvaluator::SceneEvaluator(const std::vector<float> &program,
+                                   const std::vector<float> &bvhData) {
+        load(program, bvhData);
+    }
+
+    bool SceneEvaluator::load(const std::vector<std::vector<float>> &textureData,
+                              const std::vector<float> &bvhData) {
+        std::vector<float> flat(textureData.size() * STRIDE, 0.0f);
+        for (size_t i = 0; i < textureData.size(); ++i) {
+            const std::vector<float> &d = textureData[i];
+            std::copy(d.begin(), d.begin() + std::min<size_t>(d.size(), STRIDE), flat.begin() + i * STRIDE);
+        }
+        return load(flat, bvhData);
+    }
+
+    // 模拟一遍栈深度，保证求值时不会越界：运算节点之前至少有两格，MULTI_* 之后必须紧跟 k 条基元，
+    // 栈深不超过 STACK_SIZE，结束时恰好剩一格
+    static bool check_program(const float *rec, int count, int &max_depth, int &depth) {
+        depth = 0;
+        max_depth = 0;
+        int folding = 0;
+        bool valid = true;
+        for (int i = 0; i < count; ++i, rec += SceneEvaluator::STRIDE) {
+            int type = int(rec[0] + 0.5f);
+            bool op = type == INTERSECTION || type == UNION || type == DIFFERENCE;
+            bool multi = type == MULTI_UNION || type == MULTI_INTERSECTION;
+            if (folding > 0 && (op || multi)) {
+                valid = false;
+            }
+            if (op) {
+                depth -= 1;
+                valid = valid && depth >= 1;
+            } else if (multi) {
+                depth += 1;
+                folding = int(rec[5] + 0.5f);
+            } else {
+                if (folding > 0) {
+                    folding -= 1;
+                } else {
+                    depth += 1;
+                }
+            }
+            max_depth = std::max(max_depth, depth);
+        }
+        return valid && folding == 0 && max_depth <= SceneEvaluator::STACK_SIZE && (count == 0 || depth == 1);
+    }
+
+    bool SceneEvaluator::load(const std::vector<float> &programData,
+                              const std::vector<float> &bvhData) {
+        loaded = false;
+        program.clear();
+        bvh.clear();
+        num_objects = num_nodes = 0;
+
+        int count = static_cast<int>(programData.size()) / STRIDE;
+        int depth, max_depth;
+        if (!check_program(programData.data(), count, max_depth, depth)) {
+            std::cout << "[Error] Invalid program for SceneEvaluator. Max stack length: " << max_depth
+                      << ", final stack length: " << depth << std::endl;
+            return false;
+        }
+
+        // 检查 BVH 节点的下标、每个叶子的指令段，并保证树深不超过遍历栈
+        int nodes = static_cast<int>(bvhData.size()) / BVH_NODE_STRIDE;
+        std::vector<int> level(nodes, 0);
+        if (nodes > 0) level[0] = 1;
+        for (int i = 0; i < nodes; ++i) {
+            const float *node = &bvhData[i * BVH_NODE_STRIDE];
+            int a = int(node[3] + 0.5f), n = int(node[7] + 0.5f);
+            bool ok = n > 0 ? (a >= 0 && a + n <= count &&
+                               check_program(&programData[a * STRIDE], n, max_depth, depth))
+                            : (a > i + 1 && a < nodes);
+            if (ok && n == 0) {
+                level[i + 1] = level[a] = level[i] + 1;
+            }
+            if (!ok || level[i] == 0 || level[i] > BVH_STACK_SIZE) {
+                std::cout << "[Error] Invalid BVH node " << i << std::endl;
+                return false;
+            }
+        }
+
+        program.assign(programData.begin(), programData.begin() + count * STRIDE);
+        num_objects = count;
+        bvh.assign(bvhData.begin(), bvhData.begin() + nodes * BVH_NODE_STRIDE);
+        num_nodes = nodes;
+        loaded = true;
+        return true;
+    }
+
+    float SceneEvaluator::map(const glm::vec3 &p, glm::vec3 &col, int &matID, float &matPar) const {
+        if (!loaded) {
+            // 没有可用的程序：当作空场景，光线不会命中
+            col = glm::vec3(0.0f);
+            matID = 0;
+            matPar = 0.0f;
+            return BVH_INFINITY;
+        }
+        return num_nodes > 0 ? map_bvh(p, col, matID, matPar) : map_linear(p, col, matID, matPar);
+    }
+
+    float SceneEvaluator::map_linear(const glm::vec3 &p, glm::vec3 &col, int &matID, float &matPar) const {
+        StackEntry stack[STACK_SIZE] = {};
+        int stack_top = 0;
+        FoldState fold;
+
+        const float *rec = program.data();
+        for (int i = 0; i < num_objects; ++i, rec += STRIDE) {
+            distOne(rec, p, stack, stack_top, fold);
+        }
+        col = stack[0].col;
+        matID = stack[0].mat_id;
+        matPar = stack[0].mat_par;
+        return stack[0].d;
+    }
+
+    // 与 shader 中的 mapBVH() 相同：近的子节点先访问，叶子用独立的栈求值后与当前结果求并
+    float SceneEvaluator::map_bvh(const glm::vec3 &p, glm::vec3 &col, int &matID, float &matPar) const {
+        StackEntry best = {glm::vec3(0.0f), BVH_INFINITY, 0, 0.0f};
+
+        int todo[BVH_STACK_SIZE];
+        float todoDist[BVH_STACK_SIZE];
+        int todo_top = 0;
+        todo[todo_top] = 0;
+        todoDist[todo_top++] = sdAABB(p, &bvh[0]);
+
+        while (todo_top > 0) {
+            --todo_top;
+            if (todoDist[todo_top] >= best.d) continue;
+            const float *node = &bvh[todo[todo_top] * BVH_NODE_STRIDE];
+            int count = int(node[7] + 0.5f);
+            if (count > 0) {
+                StackEntry stack[STACK_SIZE] = {};
+                int stack_top = 0;
+                FoldState fold;
+                const float *rec = &program[int(node[3] + 0.5f) * STRIDE];
+                for (int i = 0; i < count; ++i, rec += STRIDE) {
+                    distOne(rec, p, stack, stack_top, fold);
+                }
+                if (stack[0].d < best.d) best = stack[0];
+            } else {
+                int left = todo[todo_top] + 1, right = int(node[3] + 0.5f);
+                float dl = sdAABB(p, &bvh[left * BVH_NODE_STRIDE]);
+                float dr = sdAABB(p, &bvh[right * BVH_NODE_STRIDE]);
+                bool leftFirst = dl <= dr;
+                todo[todo_top] = leftFirst ? right : left;
+                todoDist[todo_top++] = leftFirst ? dr : dl;
+                todo[todo_top] = leftFirst ? left : right;
+                todoDist[todo_top++] = leftFirst ? dl : dr;
+            }
+        }
+        col = best.col;
+        matID = best.mat_id;
+        matPar = best.mat_par;
+        return best.d;
+    }
+
+    float SceneEvaluator::map(const glm::vec3 &p) const {
+        glm::vec3 col;
+        int matID;
+        float matPar;
+        return map(p, col, matID, matPar);
+    }
+
+}
@@ -0,0 +1,69 @@
+#ifndef ISR_EVALUATOR_H
+#define ISR_EVALUATOR_H
+
+#include <glm/vec3.hpp>
+#include <vector>
+
+namespace Objects {
+
+    // CPU 端参考实现：按 generate_texture_data() 输出的后序指令流求值，
+    // 栈深度、类型码 (0~11)、颜色与材质的传递规则都与 raymarch.frag 中的 distOne()/map() 一致。
+    class SceneEvaluator {
+        std::vector<float> program;     // 每个物体 32 float，布局与 TBO 相同
+        int num_objects = 0;
+        std::vector<float> bvh;         // 可选的 BVH 节点 (见 bvh.h)，为空时线性遍历
+        int num_nodes = 0;
+        bool loaded = false;            // 最近一次 load() 通过了检查
+
+        float map_linear(const glm::vec3 &p, glm::vec3 &col, int &matID, float &matPar) const;
+
+        float map_bvh(const glm::vec3 &p, glm::vec3 &col, int &matID, float &matPar) const;
+
+    public:
+        static const int STRIDE = 32;
+        static const int STACK_SIZE = 8;
+
+        SceneEvaluator() = default;
+
+        static const int BVH_STACK_SIZE = 32;
+
+        explicit SceneEvaluator(const std::vector<std::vector<float>> &textureData,
+                                const std::vector<float> &bvhData = std::vector<float>());
+
+        // program 为连续存放的指令 (每条 32 float)，即 CSG_tree::generate_texture_data(program, bvhData) 的输出
+        explicit SceneEvaluator(const std::vector<float> &program,
+                                const std::vector<float> &bvhData = std::vector<float>());
+
+        // 载入前检查指令流的栈深与 BVH 的下标 (包括每个叶子的指令段)，不合法时输出错误、返回 false，
+        // 求值器变为不可用：map() / map_batch() 按空场景返回 BVH_INFINITY，不会越界访问
+        bool load(const std::vector<std::vector<float>> &textureData,
+                  const std::vector<float> &bvhData = std::vector<float>());
+
+        bool load(const std::vector<float> &program,
+                  const std::vector<float> &bvhData = std::vector<float>());
+
+        // 构造函数同样经过 load()，调用方应检查 valid()
+        bool valid() const { return loaded; }
+
+        int size() const { return num_objects; }
+
+        int bvh_nodes() const { return num_nodes; }
+
+        // 与 shader 中的 map() 相同：返回距离，并输出颜色、材质 ID 与材质参数。
+        // 有 BVH 时跳过包围盒距离不小于当前最近距离的子树
+        float map(const glm::vec3 &p, glm::vec3 &col, int &matID, float &matPar) const;
+
+        float map(const glm::vec3 &p) const;
+
+        // 批量求距离：x/y/z/dist 为 SoA 布局的 count 个点。
+        // 每 batch_lanes() 个点一组，整段程序只解码一次，8 层栈保存在 SIMD 寄存器中 (见 evaluator_simd.cpp)
+        void map_batch(const float *x, const float *y, const float *z, float *dist, int count) const;
+
+        static int batch_lanes();
+
+        static const char *batch_isa();
+    };
+
+}
+
+#endif //ISR_EVALUATOR_H
@@ -0,0 +1,40 @@
+// SceneEvaluator::map_batch：默认指令集的实现，以及按 CPU 在几种实现之间的选择。
+// 定义了 ISR_SIMD_DISPATCH (x86 上的 GCC / Clang，见 CMakeLists.txt) 时另有 AVX2 与 AVX-512 两份，
+// 同一个二进制文件可以在不支持它们的机器上运行
+
+#define ISR_SIMD_KERNEL batch_kernel_baseline
+#include "evaluator_simd.inl"
+
+namespace Objects {
+
+    static const BatchKernel &select_kernel() {
+#if defined(ISR_SIMD_DISPATCH)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) return batch_kernel_avx512();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return batch_kernel_avx2();
+#endif
+        return batch_kernel_baseline();
+    }
+
+    static const BatchKernel &kernel() {
+        static const BatchKernel &selected = select_kernel();
+        return selected;
+    }
+
+    void SceneEvaluator::map_batch(const float *x, const float *y, const float *z, float *dist, int count) const {
+        if (!loaded) {
+            std::fill(dist, dist + count, BVH_INFINITY);
+            return;
+        }
+        kernel().map(program.data(), num_objects, bvh.data(), num_nodes, x, y, z, dist, count);
+    }
+
+    int SceneEvaluator::batch_lanes() {
+        return kernel().lanes;
+    }
+
+    const char *SceneEvaluator::batch_isa() {
+        return kernel().isa;
+    }
+
+}
@@ -0,0 +1,27 @@
+#ifndef ISR_EVALUATOR_SIMD_H
+#define ISR_EVALUATOR_SIMD_H
+
+namespace Objects {
+
+    // SceneEvaluator::map_batch 的一种指令集实现 (evaluator_simd.inl 按不同的指令集编译成几份)。
+    // program / bvh 与 SceneEvaluator 中的布局相同，numNodes 为 0 时线性遍历
+    struct BatchKernel {
+        const char *isa;
+        int lanes;
+        void (*map)(const float *program, int numObjects, const float *bvh, int numNodes,
+                    const float *x, const float *y, const float *z, float *dist, int count);
+    };
+
+    // 编译器的默认指令集 (x86-64 上为 SSE2)，总是可用
+    const BatchKernel &batch_kernel_baseline();
+
+#if defined(ISR_SIMD_DISPATCH)
+    // 按函数的 target 属性编译，只能在 CPU 支持时调用 (见 evaluator_simd.cpp 的 select_kernel)
+    const BatchKernel &batch_kernel_avx2();
+
+    const BatchKernel &batch_kernel_avx512();
+#endif
+
+}
+
+#endif //ISR_EVALUATOR_SIMD_H
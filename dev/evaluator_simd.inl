@@ -0,0 +1,404 @@
+#include <glm/glm.hpp>
+#include <algorithm>
+#include "objects.h"
+#include "evaluator.h"
+#include "evaluator_simd.h"
+#include "bvh.h"
+
+// SceneEvaluator::map_batch 的向量化实现，由 evaluator_simd.cpp (默认指令集) 与
+// evaluator_simd_avx2.cpp / evaluator_simd_avx512.cpp 各包含一次，ISR_SIMD_KERNEL 为导出的函数名。
+// 每条指令的标量参数 (旋转矩阵、局部坐标基、四面体法线) 每组只算一次，
+// 距离计算在 Simd::LANES 个通道上同时进行；分形的逃逸循环按通道掩码冻结已逃逸的点。
+//
+// 定义了 ISR_SIMD_TARGET 时，以下的函数都带上这个 target 属性。上面的头文件在属性的范围之外，
+// glm 与标准库的内联函数仍按默认指令集生成，不会在链接时顶替其他翻译单元中的同名函数；
+// 本文件的函数都是内部链接，Simd:: 的函数按宽度放在不同的命名空间中
+
+#define ISR_SIMD_PRAGMA_(x) _Pragma(#x)
+#define ISR_SIMD_PRAGMA(x) ISR_SIMD_PRAGMA_(x)
+
+#if defined(ISR_SIMD_TARGET)
+#if defined(__clang__)
+ISR_SIMD_PRAGMA(clang attribute push(__attribute__((target(ISR_SIMD_TARGET))), apply_to = function))
+#else
+ISR_SIMD_PRAGMA(GCC push_options)
+ISR_SIMD_PRAGMA(GCC target(ISR_SIMD_TARGET))
+#endif
+#endif
+
+#include "simd.h"
+
+using namespace Simd;
+
+static vfloat sdSphere(const vec3 &p, float r) {
+    return length(p) - r;
+}
+
+// q = |R p| - b
+static vfloat sdBoxLocal(const vec3 &q) {
+    vfloat ox = max(q.x, 0.0f), oy = max(q.y, 0.0f), oz = max(q.z, 0.0f);
+    vfloat outside = sqrt(ox * ox + oy * oy + oz * oz);
+    return outside + min(max(q.x, max(q.y, q.z)), 0.0f);
+}
+
+// node 指向 BVH 节点的 8 个 float (min, *, max, *)
+static vfloat sdAABB(const vec3 &p, const float *node) {
+    vec3 q = {abs(p.x - (node[0] + node[4]) * 0.5f) - (node[4] - node[0]) * 0.5f,
+              abs(p.y - (node[1] + node[5]) * 0.5f) - (node[5] - node[1]) * 0.5f,
+              abs(p.z - (node[2] + node[6]) * 0.5f) - (node[6] - node[2]) * 0.5f};
+    return sdBoxLocal(q);
+}
+
+static vfloat sdBox(const vec3 &p, const glm::mat3 &R, const glm::vec3 &b) {
+    vec3 rp = {p.x * R[0][0] + p.y * R[1][0] + p.z * R[2][0],
+               p.x * R[0][1] + p.y * R[1][1] + p.z * R[2][1],
+               p.x * R[0][2] + p.y * R[1][2] + p.z * R[2][2]};
+    vec3 q = {abs(rp.x) - b.x, abs(rp.y) - b.y, abs(rp.z) - b.z};
+    return sdBoxLocal(q);
+}
+
+static vfloat sdBoxAxis(const vec3 &p, float bx, float by, float bz) {
+    vec3 q = {abs(p.x) - bx, abs(p.y) - by, abs(p.z) - bz};
+    return sdBoxLocal(q);
+}
+
+static glm::mat3 boxRotation(float alpha, float beta, float gamma) {
+    glm::mat3 Rz_alpha(
+            std::cos(alpha), -std::sin(alpha), 0.0f,
+            std::sin(alpha), std::cos(alpha), 0.0f,
+            0.0f, 0.0f, 1.0f);
+    glm::mat3 Rx_beta(
+            1.0f, 0.0f, 0.0f,
+            0.0f, std::cos(beta), -std::sin(beta),
+            0.0f, std::sin(beta), std::cos(beta));
+    glm::mat3 Rz_gamma(
+            std::cos(gamma), -std::sin(gamma), 0.0f,
+            std::sin(gamma), std::cos(gamma), 0.0f,
+            0.0f, 0.0f, 1.0f);
+    return Rz_gamma * Rx_beta * Rz_alpha;
+}
+
+static vfloat sdCylinderFlat(const vec3 &p, const float *pos) {
+    glm::vec3 a(pos[0], pos[1], pos[2]), b(pos[3], pos[4], pos[5]);
+    float r = pos[6];
+    glm::vec3 ba = b - a;
+    float h2 = glm::length(ba) * 0.5f;
+    glm::vec3 axis = ba / (h2 * 2.0f);
+    glm::vec3 mid = (a + b) * 0.5f;
+
+    glm::vec3 up = std::abs(axis.z) < 0.999f ? glm::vec3(0, 0, 1) : glm::vec3(1, 0, 0);
+    glm::vec3 x = glm::normalize(glm::cross(up, axis));
+    glm::vec3 y = glm::cross(axis, x);
+
+    vec3 pm = p - &mid[0];
+    vfloat lx = dot(pm, &x[0]), ly = dot(pm, &y[0]), lz = dot(pm, &axis[0]);
+
+    vfloat dx = sqrt(lx * lx + ly * ly) - r;
+    vfloat dy = abs(lz) - h2;
+    vfloat ox = max(dx, 0.0f), oy = max(dy, 0.0f);
+    return min(max(dx, dy), 0.0f) + sqrt(ox * ox + oy * oy);
+}
+
+static vfloat sdCone(const vec3 &p, const float *pos) {
+    glm::vec3 center(pos[0], pos[1], pos[2]), vertex(pos[3], pos[4], pos[5]);
+    float radius = pos[6];
+
+    glm::vec3 axis = glm::normalize(center - vertex);
+    float height = glm::length(center - vertex);
+    glm::vec3 up = std::abs(axis.y) < 0.999f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0);
+    glm::vec3 bx = glm::normalize(glm::cross(up, axis));
+    glm::vec3 by = -axis;
+    glm::vec3 bz = glm::cross(axis, bx);
+
+    float angle = std::atan2(radius, height);
+    float cx = std::sin(angle), cy = std::cos(angle);
+
+    // transpose(basis) * (p - vertex)
+    vec3 pv = p - &vertex[0];
+    vec3 lp = {dot(pv, &bx[0]), dot(pv, &by[0]), dot(pv, &bz[0])};
+
+    float qx = height * (cx / cy), qy = -height;
+    vfloat wx = sqrt(lp.x * lp.x + lp.z * lp.z), wy = lp.y;
+    vfloat ta = clamp((wx * qx + wy * qy) / (qx * qx + qy * qy), 0.0f, 1.0f);
+    vfloat ax = wx - ta * qx, ay = wy - ta * qy;
+    vfloat tb = clamp(wx / qx, 0.0f, 1.0f);
+    vfloat bxv = wx - tb * qx, byv = wy - qy;
+    float k = qy > 0.0f ? 1.0f : (qy < 0.0f ? -1.0f : 0.0f);
+    vfloat d = min(ax * ax + ay * ay, bxv * bxv + byv * byv);
+    vfloat s = max(k * (wx * qy - wy * qx), k * (wy - qy));
+    return sqrt(d) * sign(s);
+}
+
+static vfloat sdTetrahedron(const vec3 &p, const float *pos) {
+    glm::vec3 verts[4];
+    for (int i = 0; i < 4; ++i) verts[i] = glm::vec3(pos[3 * i], pos[3 * i + 1], pos[3 * i + 2]);
+    static const int faces[4][3] = {
+            {0, 1, 2},
+            {0, 2, 3},
+            {0, 3, 1},
+            {1, 3, 2}
+    };
+    glm::vec3 cen = (verts[0] + verts[1] + verts[2] + verts[3]) * 0.25f;
+
+    vfloat dMax = set1(-1e20f);
+    for (int i = 0; i < 4; ++i) {
+        const glm::vec3 &a = verts[faces[i][0]];
+        const glm::vec3 &b = verts[faces[i][1]];
+        const glm::vec3 &c = verts[faces[i][2]];
+        glm::vec3 n = glm::normalize(glm::cross(b - a, c - a));
+        if (glm::dot(cen - a, n) > 0.0f)
+            n = -n;
+        dMax = max(dMax, dot(p - &a[0], &n[0]));
+    }
+    return dMax;
+}
+
+static vfloat sdPlane(const vec3 &p, const float *pos) {
+    return dot(p, pos) + pos[3];
+}
+
+static vfloat sdMengerSponge(vec3 p, float size, int iterations) {
+    p = p * (1.0f / size);
+    vfloat d = sdBoxAxis(p, 1.0f, 1.0f, 1.0f);
+
+    float s = 1.0f;
+    for (int m = 0; m < iterations; m++) {
+        // mod(p * s, 2.0) - 1.0
+        vec3 ps = p * s;
+        vec3 a = {ps.x - 2.0f * floor(ps.x * 0.5f) - 1.0f,
+                  ps.y - 2.0f * floor(ps.y * 0.5f) - 1.0f,
+                  ps.z - 2.0f * floor(ps.z * 0.5f) - 1.0f};
+        s *= 3.0f;
+
+        vec3 r = {abs(1.0f - 3.0f * abs(a.x)), abs(1.0f - 3.0f * abs(a.y)), abs(1.0f - 3.0f * abs(a.z))};
+
+        vfloat c1 = sdBoxAxis(r, 2.0f, 1.0f, 1.0f) / s;
+        vfloat c2 = sdBoxAxis(r, 1.0f, 2.0f, 1.0f) / s;
+        vfloat c3 = sdBoxAxis(r, 1.0f, 1.0f, 2.0f) / s;
+        d = max(d, min(min(c1, c2), c3));
+    }
+    return d * size;
+}
+
+static vfloat sdMandelbulb(const vec3 &p, const float *center, float scale, float power, int maxIter) {
+    vec3 c = (p - center) * (1.0f / scale);
+    vec3 w = c;
+    vfloat m = dot(w, w);
+    vfloat dz = set1(1.0f);
+
+    vmask active = and_not(all_lanes(), m > 4.0f);
+    for (int i = 0; i < maxIter && any(active); i++) {
+        // dz = power * |w|^(power-1) * dz + 1 ；r^power = exp(power * log r)
+        vfloat logr = log(m) * 0.5f;
+        vfloat ndz = power * exp(logr * (power - 1.0f)) * dz + 1.0f;
+
+        vfloat r = sqrt(m);
+        vfloat b = power * acos(w.y / r);
+        vfloat a = power * atan2(w.x, w.z);
+        vfloat rp = exp(logr * power);
+        vfloat sb = sin(b);
+        vec3 nw = {rp * sb * sin(a) + c.x,
+                   rp * cos(b) + c.y,
+                   rp * sb * cos(a) + c.z};
+
+        dz = select(active, ndz, dz);
+        w = {select(active, nw.x, w.x), select(active, nw.y, w.y), select(active, nw.z, w.z)};
+        m = select(active, dot(nw, nw), m);
+        active = and_not(active, m > 4.0f);
+    }
+    return 0.25f * log(m) * sqrt(m) / dz * scale;
+}
+
+static vfloat sdJuliaSet3D(const vec3 &p, const float *center, float scale, float cx, float cy, int maxIter) {
+    vec3 z = (p - center) * (1.0f / scale);
+    vfloat m2 = set1(0.0f);
+    vfloat dz = set1(1.0f);
+
+    vmask active = all_lanes();
+    for (int i = 0; i < maxIter && any(active); i++) {
+        m2 = select(active, dot(z, z), m2);
+        active = and_not(active, m2 > 16.0f);
+
+        vfloat ndz = 2.0f * sqrt(m2) * dz + 1.0f;
+        vec3 nz = {z.x * z.x - z.y * z.y - z.z * z.z + cx,
+                   2.0f * z.x * z.y + cy,
+                   2.0f * z.x * z.z};
+
+        dz = select(active, ndz, dz);
+        z = {select(active, nz.x, z.x), select(active, nz.y, z.y), select(active, nz.z, z.z)};
+    }
+    return select(m2 > 16.0f, 0.5f * sqrt(m2) * log(m2) / dz * scale, set1(-0.1f * scale));
+}
+
+namespace {
+
+    // MULTI_UNION / MULTI_INTERSECTION 之后还有 left 条基元要并入栈顶
+    struct FoldState {
+        int type = 0;
+        int left = 0;
+    };
+
+}
+
+static void distOne(const float *rec, const vec3 &p, vfloat *stack, int &stack_top, FoldState &fold) {
+    using namespace Objects;
+    int type = int(rec[0] + 0.5f);
+    const float *pos = rec + 5;
+
+    // 累积时新结果直接与栈顶合并，选择规则与两两的 UNION / INTERSECTION 相同
+    auto push = [&](vfloat d) {
+        if (fold.left > 0) {
+            vfloat top = stack[stack_top - 1];
+            stack[stack_top - 1] = fold.type == MULTI_UNION ? select(d >= top, top, d) : select(d >= top, d, top);
+            fold.left -= 1;
+            return;
+        }
+        stack[stack_top++] = d;
+    };
+
+    switch (type) {
+        case SPHERE:
+            push(sdSphere(p - pos, pos[3]));
+            break;
+        case CONE:
+            push(sdCone(p, pos));
+            break;
+        case CYLINDER:
+            push(sdCylinderFlat(p, pos));
+            break;
+        case CUBOID: {
+            glm::mat3 R = boxRotation(pos[6], pos[7], pos[8]);
+            glm::vec3 halfExt = glm::vec3(pos[3], pos[4], pos[5]) * 0.5f;
+            push(sdBox(p - pos, R, halfExt));
+            break;
+        }
+        case TETRAHEDRON:
+            push(sdTetrahedron(p, pos));
+            break;
+        case INTERSECTION: {
+            vfloat a = stack[stack_top - 2], b = stack[stack_top - 1];
+            stack_top -= 1;
+            stack[stack_top - 1] = select(b >= a, b, a);
+            break;
+        }
+        case UNION: {
+            vfloat a = stack[stack_top - 2], b = stack[stack_top - 1];
+            stack_top -= 1;
+            stack[stack_top - 1] = select(b >= a, a, b);
+            break;
+        }
+        case DIFFERENCE: {
+            vfloat a = stack[stack_top - 2], b = -stack[stack_top - 1];
+            stack_top -= 1;
+            stack[stack_top - 1] = select(b >= a, b, a);
+            break;
+        }
+        case MULTI_UNION:
+        case MULTI_INTERSECTION:
+            stack[stack_top++] = set1(type == MULTI_UNION ? BVH_INFINITY : -BVH_INFINITY);
+            fold.type = type;
+            fold.left = int(pos[0] + 0.5f);
+            break;
+        case PLANE:
+            push(sdPlane(p, pos));
+            break;
+        case MENGER_SPONGE:
+            push(sdMengerSponge(p - pos, pos[3], int(pos[4] + 0.5f)));
+            break;
+        case MANDELBULB:
+            push(sdMandelbulb(p, pos, pos[3], pos[4], int(pos[5] + 0.5f)));
+            break;
+        case JULIA_SET_3D:
+            push(sdJuliaSet3D(p, pos, pos[3], pos[4], pos[5], int(pos[6] + 0.5f)));
+            break;
+        default:
+            break;
+    }
+}
+
+namespace Objects {
+
+    static void map_batch(const float *program, int num_objects, const float *bvh, int num_nodes,
+                          const float *x, const float *y, const float *z, float *dist, int count) {
+        const int STACK_SIZE = SceneEvaluator::STACK_SIZE, STRIDE = SceneEvaluator::STRIDE;
+        float tail[3][LANES];
+        float tailDist[LANES];
+
+        for (int i = 0; i < count; i += LANES) {
+            int n = std::min(LANES, count - i);
+            vec3 p;
+            if (n == LANES) {
+                p = {Simd::load(x + i), Simd::load(y + i), Simd::load(z + i)};
+            } else {
+                // 不足一组时用最后一个点补齐
+                for (int l = 0; l < LANES; ++l) {
+                    int k = i + std::min(l, n - 1);
+                    tail[0][l] = x[k];
+                    tail[1][l] = y[k];
+                    tail[2][l] = z[k];
+                }
+                p = {Simd::load(tail[0]), Simd::load(tail[1]), Simd::load(tail[2])};
+            }
+
+            vfloat d;
+            if (num_nodes > 0) {
+                // 只要有一个通道的包围盒距离小于该通道当前的最近距离，就需要进入该节点
+                d = set1(BVH_INFINITY);
+                int todo[SceneEvaluator::BVH_STACK_SIZE];
+                int todo_top = 0;
+                todo[todo_top++] = 0;
+                while (todo_top > 0) {
+                    int index = todo[--todo_top];
+                    const float *node = &bvh[index * BVH_NODE_STRIDE];
+                    if (!any(sdAABB(p, node) < d)) continue;
+                    int n_rec = int(node[7] + 0.5f);
+                    if (n_rec > 0) {
+                        vfloat stack[STACK_SIZE];
+                        stack[0] = set1(0.0f);
+                        int stack_top = 0;
+                        FoldState fold;
+                        const float *rec = &program[int(node[3] + 0.5f) * STRIDE];
+                        for (int k = 0; k < n_rec; ++k, rec += STRIDE) {
+                            distOne(rec, p, stack, stack_top, fold);
+                        }
+                        d = min(d, stack[0]);
+                    } else {
+                        todo[todo_top++] = int(node[3] + 0.5f);
+                        todo[todo_top++] = index + 1;
+                    }
+                }
+            } else {
+                vfloat stack[STACK_SIZE];
+                stack[0] = set1(0.0f);
+                int stack_top = 0;
+                FoldState fold;
+                const float *rec = program;
+                for (int k = 0; k < num_objects; ++k, rec += STRIDE) {
+                    distOne(rec, p, stack, stack_top, fold);
+                }
+                d = stack[0];
+            }
+
+            if (n == LANES) {
+                store(dist + i, d);
+            } else {
+                store(tailDist, d);
+                std::copy(tailDist, tailDist + n, dist + i);
+            }
+        }
+    }
+
+    const BatchKernel &ISR_SIMD_KERNEL() {
+        static const BatchKernel kernel = {ISA, LANES, map_batch};
+        return kernel;
+    }
+
+}
+
+#if defined(ISR_SIMD_TARGET)
+#if defined(__clang__)
+ISR_SIMD_PRAGMA(clang attribute pop)
+#else
+ISR_SIMD_PRAGMA(GCC pop_options)
+#endif
+#endif
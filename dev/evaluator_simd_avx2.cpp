@@ -0,0 +1,7 @@
+// AVX2 + FMA 的 map_batch，只在 CPU 支持时由 evaluator_simd.cpp 选用
+#if defined(ISR_SIMD_DISPATCH)
+#define ISR_SIMD_AVX2
+#define ISR_SIMD_TARGET "avx2,fma"
+#define ISR_SIMD_KERNEL batch_kernel_avx2
+#include "evaluator_simd.inl"
+#endif
@@ -0,0 +1,487 @@
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include "objects.h"
+#include "bvh.h"
+#include "glsl_codegen.h"
+
+namespace Objects {
+
+    namespace {
+
+        glm::vec3 vec3At(const float *v) {
+            return glm::vec3(v[0], v[1], v[2]);
+        }
+
+        void append(std::vector<float> &out, const glm::vec3 &v) {
+            out.insert(out.end(), {v.x, v.y, v.z});
+        }
+
+        void append(std::vector<float> &out, const glm::mat3 &m) {
+            for (int c = 0; c < 3; ++c) append(out, m[c]);
+        }
+
+        bool is_operator(int type) {
+            return type == INTERSECTION || type == UNION || type == DIFFERENCE ||
+                   type == MULTI_UNION || type == MULTI_INTERSECTION;
+        }
+
+        // 一个基元在 SceneParams 中的参数：rgb + 按类型预先算好的参数 + (texture, para)。
+        // 这里的计算与 raymarch.frag 中每次调用 distOne() 时做的相同，只是挪到了 CPU 上做一次。
+        // materialIndex 接收 texture 在结果中的下标
+        std::vector<float> derive_params(const float *rec, int *materialIndex = nullptr) {
+            int type = int(rec[0] + 0.5f);
+            const float *pos = rec + 5;
+            std::vector<float> out = {rec[1], rec[2], rec[3]};
+            int material = 0;                   // texture 在 pos_args 中的下标
+
+            switch (type) {
+                case SPHERE:
+                    append(out, vec3At(pos));
+                    out.push_back(pos[3]);
+                    material = 4;
+                    break;
+                case CONE: {
+                    glm::vec3 center = vec3At(pos), vertex = vec3At(pos + 3);
+                    glm::vec3 axis = glm::normalize(center - vertex);
+                    float height = glm::length(center - vertex);
+                    glm::vec3 up = std::abs(axis.y) < 0.999f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0);
+                    glm::vec3 x = glm::normalize(glm::cross(up, axis));
+                    glm::vec3 z = glm::cross(axis, x);
+                    float angle = std::atan2(pos[6], height);
+                    append(out, vertex);
+                    append(out, glm::mat3(x, -axis, z));
+                    out.insert(out.end(), {std::sin(angle), std::cos(angle), height});
+                    material = 7;
+                    break;
+                }
+                case CYLINDER: {
+                    glm::vec3 a = vec3At(pos), b = vec3At(pos + 3);
+                    glm::vec3 ba = b - a;
+                    float h2 = glm::length(ba) * 0.5f;
+                    glm::vec3 axis = ba / (h2 * 2.0f);
+                    glm::vec3 up = std::abs(axis.z) < 0.999f ? glm::vec3(0, 0, 1) : glm::vec3(1, 0, 0);
+                    glm::vec3 x = glm::normalize(glm::cross(up, axis));
+                    glm::vec3 y = glm::cross(axis, x);
+                    append(out, (a + b) * 0.5f);
+                    append(out, glm::mat3(x, y, axis));
+                    out.insert(out.end(), {pos[6], h2});
+                    material = 7;
+                    break;
+                }
+                case CUBOID: {
+                    float ca = std::cos(pos[6]), sa = std::sin(pos[6]);
+                    float cb = std::cos(pos[7]), sb = std::sin(pos[7]);
+                    float cg = std::cos(pos[8]), sg = std::sin(pos[8]);
+                    glm::mat3 Rz_alpha(ca, -sa, 0.0f, sa, ca, 0.0f, 0.0f, 0.0f, 1.0f);
+                    glm::mat3 Rx_beta(1.0f, 0.0f, 0.0f, 0.0f, cb, -sb, 0.0f, sb, cb);
+                    glm::mat3 Rz_gamma(cg, -sg, 0.0f, sg, cg, 0.0f, 0.0f, 0.0f, 1.0f);
+                    append(out, vec3At(pos));
+                    append(out, Rz_gamma * Rx_beta * Rz_alpha);
+                    append(out, vec3At(pos + 3) * 0.5f);
+                    material = 9;
+                    break;
+                }
+                case TETRAHEDRON: {
+                    glm::vec3 v[4] = {vec3At(pos), vec3At(pos + 3), vec3At(pos + 6), vec3At(pos + 9)};
+                    const int faces[4][3] = {{0, 1, 2}, {0, 2, 3}, {0, 3, 1}, {1, 3, 2}};
+                    glm::vec3 cen = (v[0] + v[1] + v[2] + v[3]) * 0.25f;
+                    for (const auto &f: faces) {
+                        glm::vec3 a = v[f[0]], b = v[f[1]], c = v[f[2]];
+                        glm::vec3 n = glm::normalize(glm::cross(b - a, c - a));
+                        if (glm::dot(cen - a, n) > 0.0f) n = -n;
+                        append(out, n);
+                        out.push_back(glm::dot(a, n));          // dot(p - a, n) = dot(p, n) - dot(a, n)
+                    }
+                    material = 12;
+                    break;
+                }
+                case PLANE:
+                    append(out, vec3At(pos));
+                    out.push_back(pos[3]);
+                    material = 4;
+                    break;
+                case MENGER_SPONGE:
+                    append(out, vec3At(pos));
+                    out.insert(out.end(), {pos[3], pos[4]});
+                    material = 5;
+                    break;
+                case MANDELBULB:
+                    append(out, vec3At(pos));
+                    out.insert(out.end(), {pos[3], pos[4], pos[5]});
+                    material = 6;
+                    break;
+                case JULIA_SET_3D:
+                    append(out, vec3At(pos));
+                    out.insert(out.end(), {pos[3], pos[4], pos[5], pos[6], pos[7]});
+                    material = 8;
+                    break;
+                default:
+                    std::cout << "[Error] Unknown object type: " << type << std::endl;
+                    assert(false);
+            }
+            if (materialIndex) *materialIndex = static_cast<int>(out.size());
+            out.insert(out.end(), {pos[material], pos[material + 1]});
+            out.resize((out.size() + 3) / 4 * 4, 0.0f);
+            return out;
+        }
+
+        std::string lit(float v) {
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "%.9g", v);
+            std::string s(buf);
+            if (s.find_first_of(".en") == std::string::npos) s += ".0";
+            return s;
+        }
+
+        // 一个基元的参数：内联时输出字面量，否则输出 sceneParams 中对应的分量
+        struct Params {
+            std::vector<float> values;
+            int base = 0;                       // 在 sceneParams 中的起始 float 下标
+            bool uniform = false;
+
+            std::string f(int i) const {
+                if (!uniform) return lit(values[i]);
+                int k = base + i;
+                return "sceneParams[" + std::to_string(k / 4) + "]." + "xyzw"[k % 4];
+            }
+
+            std::string v2(int i) const {
+                return "vec2(" + f(i) + ", " + f(i + 1) + ")";
+            }
+
+            std::string v3(int i) const {
+                if (uniform && (base + i) % 4 == 0) return "sceneParams[" + std::to_string((base + i) / 4) + "].xyz";
+                return "vec3(" + f(i) + ", " + f(i + 1) + ", " + f(i + 2) + ")";
+            }
+
+            std::string m3(int i) const {
+                return "mat3(" + v3(i) + ", " + v3(i + 3) + ", " + v3(i + 6) + ")";
+            }
+
+            std::string n(int i) const {
+                if (!uniform) return std::to_string(int(values[i] + 0.5f));
+                return "int(" + f(i) + " + 0.5)";
+            }
+        };
+
+        // MATERIAL：mapCompiled()，栈格为 vec4(颜色, 距离) 并带材质；
+        // DISTANCE：mapDistCompiled()，栈格只有距离；
+        // GRADIENT：mapGradCompiled()，栈格为 vec4(梯度, 距离)
+        enum Mode { MATERIAL, DISTANCE, GRADIENT };
+
+        class Emitter {
+            const std::vector<float> &program_data;
+            int num_records;
+            bool uniform;
+            Mode mode = MATERIAL;
+            std::vector<int> base;              // 每条指令在 sceneParams 中的起始下标 (运算符为 -1)
+            std::ostringstream out;
+
+        public:
+            const float *record(int i) const { return &program_data[i * 32]; }
+
+        public:
+            Emitter(const std::vector<float> &programData, bool uniform)
+                    : program_data(programData), num_records(static_cast<int>(programData.size() / 32)),
+                      uniform(uniform), base(num_records, -1) {
+                int offset = 0;
+                for (int i = 0; i < num_records; ++i) {
+                    if (is_operator(int(record(i)[0] + 0.5f))) continue;
+                    base[i] = offset;
+                    offset += static_cast<int>(derive_params(record(i)).size());
+                }
+                if (uniform) {
+                    out << "layout(std140) uniform SceneParams\n{\n    vec4 sceneParams["
+                        << std::max(1, offset / 4) << "];\n};\n\n";
+                }
+            }
+
+            std::string str() const { return out.str(); }
+
+            std::ostringstream &stream() { return out; }
+
+            void set_mode(Mode m) { mode = m; }
+
+            // 栈格 b 按 type (UNION / INTERSECTION / DIFFERENCE) 的规则并入栈格 a
+            // 差集取反时梯度一起取反
+            void combine(int type, int a, int b, const std::string &ind) {
+                std::string sa = std::to_string(a), sb = std::to_string(b);
+                if (mode == DISTANCE) {
+                    const char *op = type == UNION || type == MULTI_UNION ? "min" : "max";
+                    out << ind << "s" << sa << " = " << op << "(s" << sa << ", " << (type == DIFFERENCE ? "-" : "")
+                        << "s" << sb << ");\n";
+                    return;
+                }
+                bool gradient = mode == GRADIENT;
+                std::string material = gradient ? "" : " m" + sa + " = m" + sb + "; q" + sa + " = q" + sb + ";";
+                if (type == UNION || type == MULTI_UNION) {
+                    out << ind << "if (s" << sb << ".w < s" << sa << ".w) { s" << sa << " = s" << sb
+                        << ";" << material << " }\n";
+                } else if (type == INTERSECTION || type == MULTI_INTERSECTION) {
+                    out << ind << "if (s" << sb << ".w >= s" << sa << ".w) { s" << sa << " = s" << sb
+                        << ";" << material << " }\n";
+                } else {
+                    out << ind << "if (-s" << sb << ".w >= s" << sa << ".w) { s" << sa << " = vec4("
+                        << (gradient ? "-" : "") << "s" << sb << ".xyz, -s" << sb << ".w);" << material << " }\n";
+                }
+            }
+
+            // 指令 [start, start + count) 展开为直线代码，结果留在 s0 / m0 / q0。
+            // MULTI_* 之后的第一条基元直接写入累积格 (省去单位元)，其余写入上一格后再合并
+            void program(int start, int count, const std::string &ind) {
+                int depth = 0, max_depth = 0, folding = 0;
+                for (int i = start; i < start + count; ++i) {
+                    const float *rec = record(i);
+                    int type = int(rec[0] + 0.5f);
+                    if (type == MULTI_UNION || type == MULTI_INTERSECTION) {
+                        depth += 1;
+                        folding = int(rec[5] + 0.5f);
+                    } else if (is_operator(type)) {
+                        depth -= 1;
+                    } else if (folding > 0) {
+                        max_depth = std::max(max_depth, depth + 1);
+                        --folding;
+                    } else {
+                        depth += 1;
+                    }
+                    max_depth = std::max(max_depth, depth);
+                }
+                std::string decl[3] = {mode == DISTANCE ? "float " : "vec4  ", "int   ", "float "};
+                const char *prefix[3] = {"s", "m", "q"};
+                for (int k = 0; k < (mode == MATERIAL ? 3 : 1); ++k) {
+                    out << ind << decl[k];
+                    for (int s = 0; s < max_depth; ++s) out << (s ? ", " : "") << prefix[k] << s;
+                    out << ";\n";
+                }
+
+                int top = 0, fold_type = 0;
+                bool fold_first = false;
+                folding = 0;
+                for (int i = start; i < start + count; ++i) {
+                    int type = int(record(i)[0] + 0.5f);
+                    if (type == MULTI_UNION || type == MULTI_INTERSECTION) {
+                        top += 1;
+                        fold_type = type;
+                        folding = int(record(i)[5] + 0.5f);
+                        fold_first = true;
+                        continue;
+                    }
+                    if (is_operator(type)) {
+                        top -= 1;
+                        combine(type, top - 1, top, ind);
+                        continue;
+                    }
+                    int slot = top;
+                    bool merge = false;
+                    if (folding > 0) {
+                        if (fold_first) {
+                            slot = top - 1;
+                            fold_first = false;
+                        } else {
+                            merge = true;
+                        }
+                        --folding;
+                    }
+                    Params P;
+                    int material;
+                    P.values = derive_params(record(i), &material);
+                    P.base = base[i];
+                    P.uniform = uniform;
+                    std::string s = "s" + std::to_string(slot), col = P.v3(0);
+
+                    out << ind << s << " = ";
+                    if (mode == GRADIENT) {
+                        gradient_primitive(type, P);
+                    } else if (type == JULIA_SET_3D && mode == MATERIAL) {
+                        std::string trap = uniform ? "(" + P.f(10) + " > 0.5)" : (P.values[10] > 0.5f ? "true" : "false");
+                        out << "sdJuliaSet3D_WithColor(p, " << P.v3(3) << ", " << P.f(6) << ", " << P.v2(7)
+                            << ", " << P.n(9) << ", " << trap << ", " << col << ");\n";
+                    } else if (mode == MATERIAL) {
+                        out << "vec4(" << col << ", " << distance(type, P) << ");\n";
+                    } else {
+                        out << distance(type, P) << ";\n";
+                    }
+                    if (mode == MATERIAL) {
+                        out << ind << "m" << slot << " = " << P.n(material) << "; q" << slot << " = "
+                            << P.f(material + 1) << ";\n";
+                    }
+                    if (merge) {
+                        combine(fold_type, top - 1, top, ind);
+                    } else if (slot == top) {
+                        top += 1;
+                    }
+                }
+            }
+
+            // 一个基元的距离表达式；Julia 只求距离 (着色见 program())
+            std::string distance(int type, const Params &P) const {
+                switch (type) {
+                    case SPHERE:
+                        return "length(p - " + P.v3(3) + ") - " + P.f(6);
+                    case CONE:
+                        return "sdCone((p - " + P.v3(3) + ") * " + P.m3(6) + ", " + P.v2(15) + ", " + P.f(17) + ")";
+                    case CYLINDER:
+                        return "sdCylinderLocal((p - " + P.v3(3) + ") * " + P.m3(6) + ", " + P.f(15) + ", " +
+                               P.f(16) + ")";
+                    case CUBOID:
+                        return "sdBoxFrame(p - " + P.v3(3) + ", " + P.m3(6) + ", " + P.v3(15) + ")";
+                    case TETRAHEDRON:
+                        return "max(max(dot(p, " + P.v3(3) + ") - " + P.f(6) + ", dot(p, " + P.v3(7) + ") - " +
+                               P.f(10) + "), max(dot(p, " + P.v3(11) + ") - " + P.f(14) + ", dot(p, " + P.v3(15) +
+                               ") - " + P.f(18) + "))";
+                    case PLANE:
+                        return "dot(p, " + P.v3(3) + ") + " + P.f(6);
+                    case MENGER_SPONGE:
+                        return "sdMengerSponge(p - " + P.v3(3) + ", " + P.f(6) + ", " + P.n(7) + ")";
+                    case MANDELBULB:
+                        return "sdMandelbulb(p, " + P.v3(3) + ", " + P.f(6) + ", " + P.f(7) + ", " + P.n(8) + ")";
+                    case JULIA_SET_3D:
+                        return "sdJuliaSet3D(p, " + P.v3(3) + ", " + P.f(6) + ", " + P.v2(7) + ", " + P.n(9) + ")";
+                }
+                return "1e30";
+            }
+
+            // 与 program() 中同类型的距离相同，输出 raymarch.frag 中对应的 sdg* (vec4(梯度, 距离))；
+            // 分形以 mapGradCompiled() 的参数 h 为步长做四面体差分
+            void gradient_primitive(int type, const Params &P) {
+                switch (type) {
+                    case SPHERE:
+                        out << "sdgSphere(p - " << P.v3(3) << ", " << P.f(6) << ");\n";
+                        break;
+                    case CONE:
+                        out << "sdgConeFrame(p - " << P.v3(3) << ", " << P.m3(6) << ", " << P.v2(15) << ", "
+                            << P.f(17) << ");\n";
+                        break;
+                    case CYLINDER:
+                        out << "sdgCylinderFrame(p - " << P.v3(3) << ", " << P.m3(6) << ", " << P.f(15) << ", "
+                            << P.f(16) << ");\n";
+                        break;
+                    case CUBOID:
+                        out << "sdgBoxFrame(p - " << P.v3(3) << ", " << P.m3(6) << ", " << P.v3(15) << ");\n";
+                        break;
+                    case TETRAHEDRON:
+                        out << "sdgMaxPlane(sdgMaxPlane(sdgMaxPlane(vec4(" << P.v3(3) << ", dot(p, " << P.v3(3)
+                            << ") - " << P.f(6) << "), p, " << P.v3(7) << ", " << P.f(10) << "), p, " << P.v3(11)
+                            << ", " << P.f(14) << "), p, " << P.v3(15) << ", " << P.f(18) << ");\n";
+                        break;
+                    case PLANE:
+                        out << "vec4(" << P.v3(3) << ", dot(p, " << P.v3(3) << ") + " << P.f(6) << ");\n";
+                        break;
+                    case MENGER_SPONGE:
+                        out << "sdgMengerSponge(p - " << P.v3(3) << ", " << P.f(6) << ", " << P.n(7) << ", h);\n";
+                        break;
+                    case MANDELBULB:
+                        out << "sdgMandelbulb(p, " << P.v3(3) << ", " << P.f(6) << ", " << P.f(7) << ", "
+                            << P.n(8) << ", h);\n";
+                        break;
+                    case JULIA_SET_3D:
+                        out << "sdgJuliaSet3D(p, " << P.v3(3) << ", " << P.f(6) << ", " << P.v2(7) << ", "
+                            << P.n(9) << ", h);\n";
+                        break;
+                }
+            }
+
+            // BVH 节点展开为嵌套 if；叶子结果与 best 求并
+            void node(const std::vector<float> &bvh, int index, const std::string &ind) {
+                const float *n = &bvh[index * BVH_NODE_STRIDE];
+                bool infinite = n[0] <= -BVH_INFINITY;
+                std::string inner = ind;
+                if (!infinite) {
+                    out << ind << "if (sdAABB(p, vec3(" << lit(n[0]) << ", " << lit(n[1]) << ", " << lit(n[2])
+                        << "), vec3(" << lit(n[4]) << ", " << lit(n[5]) << ", " << lit(n[6]) << ")) < best"
+                        << (mode == DISTANCE ? ")\n" : ".w)\n");
+                }
+                out << ind << "{\n";
+                inner += "    ";
+                int count = int(n[7] + 0.5f);
+                if (count > 0) {
+                    program(int(n[3] + 0.5f), count, inner);
+                    if (mode == DISTANCE) {
+                        out << inner << "best = min(best, s0);\n";
+                    } else {
+                        out << inner << "if (s0.w < best.w) { best = s0;"
+                            << (mode == GRADIENT ? "" : " bestID = m0; bestPar = q0;") << " }\n";
+                    }
+                } else {
+                    node(bvh, index + 1, inner);
+                    node(bvh, int(n[3] + 0.5f), inner);
+                }
+                out << ind << "}\n";
+            }
+        };
+
+    }
+
+    std::vector<float> pack_scene_params(const std::vector<float> &program) {
+        std::vector<float> params;
+        for (size_t i = 0; i + 32 <= program.size(); i += 32) {
+            const float *rec = &program[i];
+            if (is_operator(int(rec[0] + 0.5f))) continue;
+            std::vector<float> p = derive_params(rec);
+            params.insert(params.end(), p.begin(), p.end());
+        }
+        if (params.empty()) params.assign(4, 0.0f);
+        return params;
+    }
+
+    std::string generate_glsl_map(const std::vector<float> &program,
+                                  const std::vector<float> &bvhData,
+                                  bool uniformParams) {
+        int count = static_cast<int>(program.size() / 32);
+        Emitter emitter(program, uniformParams);
+        std::ostringstream &out = emitter.stream();
+        out << "// 由 glsl_codegen.cpp 根据场景生成 (" << count << " 条指令)\n";
+        out << "float mapCompiled(vec3 p, out vec3 col, out int matID, out float matPar)\n{\n";
+
+        bool useBVH = !uniformParams && !bvhData.empty();
+        if (count == 0) {
+            out << "    col = vec3(0.0); matID = 0; matPar = 0.0;\n    return 1e30;\n";
+        } else if (useBVH) {
+            out << "    vec4  best    = vec4(0.0, 0.0, 0.0, 1e30);\n";
+            out << "    int   bestID  = 0;\n";
+            out << "    float bestPar = 0.0;\n";
+            emitter.node(bvhData, 0, "    ");
+            out << "    col = best.xyz; matID = bestID; matPar = bestPar;\n    return best.w;\n";
+        } else {
+            emitter.program(0, count, "    ");
+            out << "    col = s0.xyz; matID = m0; matPar = q0;\n    return s0.w;\n";
+        }
+        out << "}\n\n";
+
+        // 只求距离：步进、阴影与 AO 的内层循环不带颜色与材质
+        emitter.set_mode(DISTANCE);
+        out << "float mapDistCompiled(vec3 p)\n{\n";
+        if (count == 0) {
+            out << "    return 1e30;\n";
+        } else if (useBVH) {
+            out << "    float best = 1e30;\n";
+            emitter.node(bvhData, 0, "    ");
+            out << "    return best;\n";
+        } else {
+            emitter.program(0, count, "    ");
+            out << "    return s0;\n";
+        }
+        out << "}\n\n";
+
+        // 同样的展开，栈格的 xyz 为梯度：calcNormal() 一次求值得到法线
+        emitter.set_mode(GRADIENT);
+        out << "vec4 mapGradCompiled(vec3 p, float h)\n{\n";
+        if (count == 0) {
+            out << "    return vec4(0.0, 1.0, 0.0, 1e30);\n";
+        } else if (useBVH) {
+            out << "    vec4  best    = vec4(0.0, 0.0, 0.0, 1e30);\n";
+            emitter.node(bvhData, 0, "    ");
+            out << "    return best;\n";
+        } else {
+            emitter.program(0, count, "    ");
+            out << "    return s0;\n";
+        }
+        out << "}\n";
+        return emitter.str();
+    }
+
+}
@@ -0,0 +1,33 @@
+#ifndef ISR_GLSL_CODEGEN_H
+#define ISR_GLSL_CODEGEN_H
+
+#include <string>
+#include <vector>
+
+namespace Objects {
+
+    // 把 generate_texture_data() 输出的后序指令 (连续存放，每条 32 float；及可选的 BVH) 编译成 GLSL 函数
+    //     float mapCompiled(vec3 p, out vec3 col, out int matID, out float matPar)
+    // 语义与 raymarch.frag 中的 map() 相同，但不再 texelFetch + 按类型分支：
+    // 栈展开为局部变量，BVH 展开为以常量包围盒为条件的嵌套 if。
+    //
+    // uniformParams == false：参数全部以字面量内联，场景变化需要重新生成并编译 shader；
+    // uniformParams == true ：参数从 uniform block SceneParams 读取 (内容由 pack_scene_params() 生成)，
+    //                         物体移动 / 变色只需重新上传缓冲。此时忽略 BVH，因为包围盒会随参数变化；
+    //                         物体的类型或顺序改变时仍需重新生成
+    // 同时生成
+    //     float mapDistCompiled(vec3 p)
+    // 只求距离 (步进、阴影与 AO 使用)，以及
+    //     vec4 mapGradCompiled(vec3 p, float h)
+    // 返回 vec4(梯度, 距离)，供 calcNormal() 使用：基元为解析梯度，分形以 h 为步长做四面体差分
+    std::string generate_glsl_map(const std::vector<float> &program,
+                                  const std::vector<float> &bvhData,
+                                  bool uniformParams);
+
+    // SceneParams 的内容 (std140 的 vec4 数组)：每个基元依次存放颜色与预先算好的参数
+    // (旋转矩阵、局部坐标基、四面体面方程等)，按 4 float 对齐
+    std::vector<float> pack_scene_params(const std::vector<float> &program);
+
+}
+
+#endif //ISR_GLSL_CODEGEN_H
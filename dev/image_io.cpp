@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include "image_io.h"
+
+namespace ImageIO {
+
+    namespace {
+
+        uint32_t crc32(const uint8_t *data, size_t len, uint32_t crc = 0) {
+            static uint32_t table[256];
+            static bool init = false;
+            if (!init) {
+                for (uint32_t i = 0; i < 256; i++) {
+                    uint32_t c = i;
+                    for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                    table[i] = c;
+                }
+                init = true;
+            }
+            crc = ~crc;
+            for (size_t i = 0; i < len; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+            return ~crc;
+        }
+
+        void put_u32_be(std::vector<uint8_t> &out, uint32_t v) {
+            out.push_back(uint8_t(v >> 24));
+            out.push_back(uint8_t(v >> 16));
+            out.push_back(uint8_t(v >> 8));
+            out.push_back(uint8_t(v));
+        }
+
+        void put_chunk(std::vector<uint8_t> &out, const char *type, const std::vector<uint8_t> &data) {
+            put_u32_be(out, uint32_t(data.size()));
+            size_t start = out.size();
+            out.insert(out.end(), type, type + 4);
+            out.insert(out.end(), data.begin(), data.end());
+            put_u32_be(out, crc32(out.data() + start, out.size() - start));
+        }
+
+        bool write_file(const std::string &path, const std::vector<uint8_t> &bytes) {
+            FILE *f = std::fopen(path.c_str(), "wb");
+            if (!f) {
+                std::cout << "[Error] Cannot open " << path << " for writing" << std::endl;
+                return false;
+            }
+            bool ok = std::fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size();
+            ok = (std::fclose(f) == 0) && ok;
+            if (!ok) std::cout << "[Error] Failed to write " << path << std::endl;
+            return ok;
+        }
+
+        uint8_t to_unorm8(float v) {
+            if (!(v > 0.0f)) return 0;          // 同时处理 NaN
+            if (v >= 1.0f) return 255;
+            return uint8_t(v * 255.0f + 0.5f);
+        }
+
+    }
+
+    bool write_png(const std::string &path, int width, int height, const std::vector<float> &rgb) {
+        // 扫描线：每行前置 filter 字节 0
+        size_t rowBytes = size_t(width) * 3 + 1;
+        std::vector<uint8_t> raw(rowBytes * height);
+        for (int y = 0; y < height; y++) {
+            uint8_t *row = &raw[rowBytes * y];
+            row[0] = 0;
+            for (int i = 0; i < width * 3; i++) row[1 + i] = to_unorm8(rgb[(size_t(y) * width) * 3 + i]);
+        }
+
+        // zlib 流，只使用 stored (不压缩) 块，省去 deflate 实现
+        std::vector<uint8_t> z;
+        z.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+        z.push_back(0x78);
+        z.push_back(0x01);
+        size_t pos = 0;
+        do {
+            size_t len = std::min<size_t>(65535, raw.size() - pos);
+            bool last = pos + len == raw.size();
+            z.push_back(last ? 1 : 0);
+            z.push_back(uint8_t(len));
+            z.push_back(uint8_t(len >> 8));
+            z.push_back(uint8_t(~len));
+            z.push_back(uint8_t(~len >> 8));
+            z.insert(z.end(), raw.begin() + pos, raw.begin() + pos + len);
+            pos += len;
+        } while (pos < raw.size());
+        uint32_t a = 1, b = 0;
+        for (uint8_t c : raw) {
+            a = (a + c) % 65521;
+            b = (b + a) % 65521;
+        }
+        put_u32_be(z, (b << 16) | a);
+
+        std::vector<uint8_t> ihdr;
+        put_u32_be(ihdr, uint32_t(width));
+        put_u32_be(ihdr, uint32_t(height));
+        ihdr.push_back(8);      // bit depth
+        ihdr.push_back(2);      // color type: RGB
+        ihdr.push_back(0);      // compression
+        ihdr.push_back(0);      // filter
+        ihdr.push_back(0);      // interlace
+
+        static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+        std::vector<uint8_t> out(signature, signature + 8);
+        put_chunk(out, "IHDR", ihdr);
+        put_chunk(out, "IDAT", z);
+        put_chunk(out, "IEND", {});
+        return write_file(path, out);
+    }
+
+    bool write_hdr(const std::string &path, int width, int height, const std::vector<float> &rgb) {
+        std::string header = "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y " + std::to_string(height) +
+                             " +X " + std::to_string(width) + "\n";
+        std::vector<uint8_t> out(header.begin(), header.end());
+        out.reserve(out.size() + size_t(width) * height * 4);
+
+        // 不做行程编码，平铺 RGBE
+        for (size_t i = 0; i < size_t(width) * height; i++) {
+            float r = rgb[i * 3 + 0], g = rgb[i * 3 + 1], b = rgb[i * 3 + 2];
+            r = r > 0.0f ? r : 0.0f;
+            g = g > 0.0f ? g : 0.0f;
+            b = b > 0.0f ? b : 0.0f;
+            float v = std::max(r, std::max(g, b));
+            if (v < 1e-32f) {
+                out.insert(out.end(), {0, 0, 0, 0});
+                continue;
+            }
+            int e;
+            float scale = std::frexp(v, &e) * 256.0f / v;
+            out.push_back(uint8_t(r * scale));
+            out.push_back(uint8_t(g * scale));
+            out.push_back(uint8_t(b * scale));
+            out.push_back(uint8_t(e + 128));
+        }
+        return write_file(path, out);
+    }
+
+}
@@ -0,0 +1,19 @@
+#ifndef ISR_IMAGE_IO_H
+#define ISR_IMAGE_IO_H
+
+#include <string>
+#include <vector>
+
+namespace ImageIO {
+
+    // rgb: width * height * 3 个 float，第 0 行为图像顶部
+
+    // 8-bit RGB PNG，数值先 clamp 到 [0,1] (NaN 按 0 处理，与写入 UNORM 帧缓冲一致)
+    bool write_png(const std::string &path, int width, int height, const std::vector<float> &rgb);
+
+    // Radiance .hdr (RGBE)，保存线性颜色
+    bool write_hdr(const std::string &path, int width, int height, const std::vector<float> &rgb);
+
+}
+
+#endif //ISR_IMAGE_IO_H
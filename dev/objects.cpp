@@ -1,7 +1,9 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
 #include <iostream>
 #include "objects.h"
+#include "bvh.h"
 
 glm::vec3 matrixToEulerZYX(const glm::mat3 &m) {
     float sy = std::sqrt(m[0][0] * m[0][0] + m[1][0] * m[1][0]);
@@ -21,17 +23,19 @@ glm::vec3 matrixToEulerZYX(const glm::mat3 &m) {
 
 namespace Objects {
 
-    std::vector<float> Object::packObjectToTextureData() {
-        std::vector<float> textureData(32);
-        textureData[0] = static_cast<float>(type); // type
-        textureData[1] = color.r; // R
-        textureData[2] = color.g; // G
-        textureData[3] = color.b; // B
-        textureData[4] = color.a; // A
-        for (int i = 0; i < 28; ++i) {
-            textureData[5 + i] = pos_args[i];
+    void Object::packObjectToTextureData(float *dst) const {
+        dst[0] = static_cast<float>(type); // type
+        dst[1] = color.r; // R
+        dst[2] = color.g; // G
+        dst[3] = color.b; // B
+        dst[4] = color.a; // A
+        for (int i = 0; i < 32 - 5; ++i) {         // 每条记录 32 float，pos_args 只放得下前 27 个
+            dst[5 + i] = pos_args[i];
+        }
+        if (fold_count > 0) {
+            dst[0] = static_cast<float>(type == UNION ? MULTI_UNION : MULTI_INTERSECTION);
+            dst[5] = static_cast<float>(fold_count);
         }
-        return textureData;
     }
 
     Object::Object(Objects::Object_type type, Objects::Color color,
@@ -61,43 +65,155 @@ namespace Objects {
         for (Object *object: object_list) {
             delete object;
         }
+        for (Object *unionObj: root_unions) {
+            delete unionObj;
+        }
+    }
+
+    void CSG_tree::collect_chain(Objects::Object *object, Object_type type,
+                                 std::vector<Object *> &operands, std::vector<Object *> &operators) {
+        if (object->type != type) {
+            operands.push_back(object);
+            return;
+        }
+        operators.push_back(object);
+        collect_chain(object->left, type, operands, operators);
+        collect_chain(object->right, type, operands, operators);
+    }
+
+    void CSG_tree::sort_chain(std::vector<Object *> &operands) {
+        // 需要栈深的操作数先算，其余每个只多占一格；深度相同的保持原来的顺序
+        std::stable_sort(operands.begin(), operands.end(), [](const Object *a, const Object *b) {
+            return a->max_stack_length > b->max_stack_length;
+        });
+    }
+
+    int CSG_tree::foldable_operands(const std::vector<Object *> &operands) {
+        int count = 0;
+        for (auto it = operands.rbegin(); it != operands.rend() && (*it)->left == nullptr; ++it) {
+            ++count;
+        }
+        return count >= 2 ? count : 0;
     }
 
     void CSG_tree::get_min_stack_order(Objects::Object *object) {
         assert((object->left == nullptr && object->right == nullptr) ||
                (object->left != nullptr && object->right != nullptr));
-        if (object->left != nullptr) {
-            get_min_stack_order(object->left);
-            get_min_stack_order(object->right);
-        }
         if (object->left == nullptr) {
             object->max_stack_length = 1;
+        } else if (object->type == UNION || object->type == INTERSECTION) {
+            // 并集 / 交集满足结合律与交换律：整条同类运算链展开成操作数列表一起排 (Sethi–Ullman)，
+            // 链的深度为 max(n0, n1 + 1)，n0 ≥ n1 为最深的两个操作数，与链本身的形状无关
+            std::vector<Object *> operands, operators;
+            collect_chain(object, object->type, operands, operators);
+            for (Object *operand: operands) {
+                get_min_stack_order(operand);
+            }
+            sort_chain(operands);
+            int folded = foldable_operands(operands);
+            int deep = static_cast<int>(operands.size()) - folded;
+            if (folded == 0) {
+                object->max_stack_length = std::max(operands[0]->max_stack_length, operands[1]->max_stack_length + 1);
+            } else {
+                // 基元直接合并进 MULTI_* 的累积格，不再另占一格；其余操作数先按链求值，剩一格后再压入累积格
+                int n1 = deep > 1 ? operands[1]->max_stack_length + 1 : 0;
+                object->max_stack_length = deep == 0 ? 1 : std::max(std::max(operands[0]->max_stack_length, n1), 2);
+            }
         } else {
-            assert(object->left != nullptr && object->right != nullptr);
-            int first_left_length = std::max(1 + object->right->max_stack_length, object->left->max_stack_length);
-            int first_right_length = std::max(1 + object->left->max_stack_length, object->right->max_stack_length);
-            object->first_left = first_left_length <= first_right_length;
-            object->max_stack_length = std::min(first_left_length, first_right_length);
+            // 差集不满足交换律，只能先算左侧
+            get_min_stack_order(object->left);
+            get_min_stack_order(object->right);
+            object->max_stack_length = std::max(object->left->max_stack_length, 1 + object->right->max_stack_length);
         }
     }
 
-    void CSG_tree::generate_texture_data_postorder(Objects::Object *object,
-                                                   std::vector<std::vector<float>> &textureData) {
+    void CSG_tree::generate_texture_data_postorder(Objects::Object *object, std::vector<Object *> &order) {
         assert((object->left == nullptr && object->right == nullptr) ||
                (object->left != nullptr && object->right != nullptr));
-        if (object->left != nullptr) {
-            if (object->first_left) {
-                generate_texture_data_postorder(object->left, textureData);
-                generate_texture_data_postorder(object->right, textureData);
-            } else {
-                generate_texture_data_postorder(object->right, textureData);
-                generate_texture_data_postorder(object->left, textureData);
+        if (object->left == nullptr) {
+            order.push_back(object);
+        } else if (object->type == UNION || object->type == INTERSECTION) {
+            // 链中的运算节点都是相同的记录，依次放在第 2、3、… 个操作数之后；
+            // 末尾的基元合并到一条 MULTI_* 之后 (借用一个运算节点)，剩余的运算节点不再输出
+            std::vector<Object *> operands, operators;
+            collect_chain(object, object->type, operands, operators);
+            sort_chain(operands);
+            int folded = foldable_operands(operands);
+            int deep = static_cast<int>(operands.size()) - folded;
+            size_t next_operator = 0;
+            for (int i = 0; i < deep; ++i) {
+                generate_texture_data_postorder(operands[i], order);
+                if (i > 0) order.push_back(operators[next_operator++]);
             }
+            if (folded > 0) {
+                Object *header = operators[next_operator++];
+                header->fold_count = folded;
+                order.push_back(header);
+                for (size_t i = deep; i < operands.size(); ++i) {
+                    order.push_back(operands[i]);
+                }
+                if (deep > 0) order.push_back(operators[next_operator++]);
+            }
+        } else {
+            generate_texture_data_postorder(object->left, order);
+            generate_texture_data_postorder(object->right, order);
+            order.push_back(object);
+        }
+    }
+
+    void CSG_tree::collect_union_members(Objects::Object *object, std::vector<Object *> &members) {
+        if (object == nullptr) {
+            return;
+        }
+        if (object->type == UNION) {
+            collect_union_members(object->left, members);
+            collect_union_members(object->right, members);
+        } else {
+            members.push_back(object);
         }
-        textureData.push_back(object->packObjectToTextureData());
     }
 
     std::vector<std::vector<float>> CSG_tree::generate_texture_data() {
+        std::vector<float> bvhData;
+        return generate_texture_data(bvhData);
+    }
+
+    std::vector<std::vector<float>> CSG_tree::generate_texture_data(std::vector<float> &bvhData) {
+        std::vector<float> program;
+        generate_texture_data(program, bvhData);
+        std::vector<std::vector<float>> textureData(program.size() / 32);
+        for (size_t i = 0; i < textureData.size(); ++i) {
+            textureData[i].assign(program.begin() + i * 32, program.begin() + (i + 1) * 32);
+        }
+        return textureData;
+    }
+
+    void CSG_tree::generate_texture_data(std::vector<float> &program, std::vector<float> &bvhData) {
+        finalize();
+        program.assign(program_cache.begin(), program_cache.end());
+        bvhData.assign(bvh_cache.begin(), bvh_cache.end());
+    }
+
+    bool CSG_tree::finalize() {
+        if (object_list.size() == finalized_objects) {
+            refresh_values(nullptr, nullptr, nullptr);
+            return false;
+        }
+        // 丢弃上次建的根部并集：其中的物体可能已被新的 CSG 运算用作操作数 (parent 已改写)，
+        // 只断开 parent 仍指向旧并集的物体。先全部断开再释放，链中的并集互为父子
+        for (Object *unionObj: root_unions) {
+            for (Object *child: {unionObj->left, unionObj->right}) {
+                if (child->parent == unionObj) {
+                    child->parent = nullptr;
+                }
+            }
+        }
+        for (Object *unionObj: root_unions) {
+            delete unionObj;
+        }
+        root_unions.clear();
+        root = nullptr;
+
         // build all the elements into the tree
         for (Object *object: object_list) {
             if (object->parent != nullptr) {
@@ -106,18 +222,188 @@ namespace Objects {
             if (root == nullptr) {
                 root = object;
             } else {
-                root = create_union(root, object);
+                root = new Object(UNION, {1.0f, 1.0f, 1.0f, 1.0f}, {}, root, object);
+                root->root_union = true;
+                root_unions.push_back(root);
+            }
+        }
+        finalized_objects = object_list.size();
+        rebuild_layout();
+        return true;
+    }
+
+    void CSG_tree::rebuild_layout() {
+        for (Object *object: object_list) {
+            object->slot = -1;
+            object->fold_count = 0;
+        }
+        // 根部的并集展开成成员，每个成员单独做后序遍历，再交给 BVH 排列
+        member_roots.clear();
+        collect_union_members(root, member_roots);
+        postorder_list.clear();
+        bvh_members.resize(member_roots.size());
+        for (size_t i = 0; i < member_roots.size(); ++i) {
+            size_t first = postorder_list.size();
+            get_min_stack_order(member_roots[i]);
+            generate_texture_data_postorder(member_roots[i], postorder_list);
+            bvh_members[i].count = static_cast<int>(postorder_list.size() - first);
+            bvh_members[i].box = member_roots[i]->bounding_box();
+        }
+        int size = build_bvh(bvh_members, bvh_cache, bvh_glue);
+
+        // 记录物体 -> 槽位，之后的 pack_texture_data() / update_dirty() 按槽位写入
+        slot_objects.assign(size, nullptr);
+        member_leaves.assign(member_roots.size(), -1);
+        size_t next = 0;
+        for (size_t i = 0; i < member_roots.size(); ++i) {
+            for (int k = 0; k < bvh_members[i].count; ++k) {
+                Object *object = postorder_list[next++];
+                object->slot = bvh_members[i].start + k;
+                object->member = static_cast<int>(i);
+                object->dirty = false;
+                slot_objects[object->slot] = object;
+            }
+            if (bvh_members[i].box.bounded) {
+                member_leaves[i] = bvh_members[i].leaf;
+            }
+        }
+
+        program_cache.resize(slot_objects.size() * 32);
+        pack_texture_data(program_cache.data());
+
+        int depth = 0, max_stack_length = 0, folding = 0;
+        fractals = false;
+        for (int i = 0; i < size; ++i) {
+            auto type = static_cast<Object_type>(static_cast<int>(program_cache[i * 32] + 0.5f));
+            if (type == MENGER_SPONGE || type == MANDELBULB || type == JULIA_SET_3D) {
+                fractals = true;
+            }
+            if (type == INTERSECTION || type == UNION || type == DIFFERENCE) {
+                depth -= 1;
+            } else if (type == MULTI_UNION || type == MULTI_INTERSECTION) {
+                depth += 1;
+                folding = static_cast<int>(program_cache[i * 32 + 5] + 0.5f);
+            } else {
+                if (folding > 0) {
+                    --folding;
+                } else {
+                    depth += 1;
+                }
             }
+            max_stack_length = std::max(max_stack_length, depth);
         }
-        // postorder traversal
-        get_min_stack_order(root);
-        std::vector<std::vector<float>> textureData;
-        generate_texture_data_postorder(root, textureData);
-        if (root->max_stack_length > 8) {
-            std::cout << "[Error] Oversized stack.Max stack length: " << root->max_stack_length << std::endl;
+        if (max_stack_length > 8) {
+            std::cout << "[Error] Oversized stack.Max stack length: " << max_stack_length << std::endl;
             assert(false);
         }
-        return textureData;
+        stack_length = max_stack_length;
+    }
+
+    void CSG_tree::pack_texture_data(float *dst) const {
+        for (size_t i = 0; i < slot_objects.size(); ++i) {
+            if (slot_objects[i] != nullptr) {
+                slot_objects[i]->packObjectToTextureData(dst + i * 32);
+            }
+        }
+        for (const GlueRecord &glue: bvh_glue) {
+            write_glue_record(dst + glue.slot * 32, glue.count);
+        }
+    }
+
+    void CSG_tree::refresh_values(std::vector<int> *slots, std::vector<AABB> *movedBounds, std::vector<int> *nodes) {
+        bool moved = false;
+        for (size_t i = 0; i < slot_objects.size(); ++i) {
+            Object *object = slot_objects[i];
+            if (object == nullptr || !object->dirty) {
+                continue;
+            }
+            if (!moved) {
+                moved_members.assign(member_roots.size(), 0);
+                moved = true;
+            }
+            object->packObjectToTextureData(&program_cache[i * 32]);
+            object->dirty = false;
+            moved_members[object->member] = 1;
+            if (slots != nullptr) {
+                slots->push_back(static_cast<int>(i));
+            }
+        }
+        if (!moved) {
+            return;
+        }
+        if (bvh_cache.empty()) {
+            if (movedBounds != nullptr) movedBounds->push_back(AABB());
+            return;
+        }
+        refit_leaves.clear();
+        for (size_t i = 0; i < member_roots.size(); ++i) {
+            if (!moved_members[i]) {
+                continue;
+            }
+            if (member_leaves[i] < 0) {
+                if (movedBounds != nullptr) movedBounds->push_back(AABB());     // 无界成员：影响范围无法限定
+                continue;
+            }
+            AABB box = member_roots[i]->bounding_box();
+            float *node = &bvh_cache[member_leaves[i] * BVH_NODE_STRIDE];
+            if (movedBounds != nullptr) {
+                AABB old;                                   // 叶子中还是上次拟合时的包围盒
+                old.min = glm::vec3(node[0], node[1], node[2]);
+                old.max = glm::vec3(node[4], node[5], node[6]);
+                old.bounded = true;
+                movedBounds->push_back(old);
+                movedBounds->push_back(box);
+            }
+            node[0] = box.min.x;
+            node[1] = box.min.y;
+            node[2] = box.min.z;
+            node[4] = box.max.x;
+            node[5] = box.max.y;
+            node[6] = box.max.z;
+            refit_leaves.push_back(member_leaves[i]);
+        }
+        if (!refit_leaves.empty()) {
+            refit_bvh(bvh_cache, refit_leaves, refit_nodes);
+            if (nodes != nullptr) {
+                nodes->insert(nodes->end(), refit_nodes.begin(), refit_nodes.end());
+            }
+        }
+    }
+
+    std::vector<int> CSG_tree::update_dirty(std::vector<float> &program, std::vector<float> &bvhData,
+                                            std::vector<AABB> *movedBounds, std::vector<int> *bvhNodes) {
+        std::vector<int> slots;
+        refit_nodes.clear();
+        refresh_values(&slots, movedBounds, bvhNodes);
+        if (program.size() != program_cache.size()) {
+            program = program_cache;
+        } else {
+            for (int slot: slots) {
+                std::copy(program_cache.begin() + slot * 32, program_cache.begin() + (slot + 1) * 32,
+                          program.begin() + slot * 32);
+            }
+        }
+        if (bvhData.size() != bvh_cache.size()) {
+            bvhData.assign(bvh_cache.begin(), bvh_cache.end());
+        } else {
+            for (int node: refit_nodes) {
+                std::copy(bvh_cache.begin() + node * BVH_NODE_STRIDE, bvh_cache.begin() + (node + 1) * BVH_NODE_STRIDE,
+                          bvhData.begin() + node * BVH_NODE_STRIDE);
+            }
+        }
+        return slots;
+    }
+
+    AABB CSG_tree::bounded_extent() const {
+        AABB extent;
+        for (Object *member: member_roots) {
+            AABB box = member->bounding_box();
+            if (!box.bounded) continue;
+            extent.min = extent.bounded ? glm::min(extent.min, box.min) : box.min;
+            extent.max = extent.bounded ? glm::max(extent.max, box.max) : box.max;
+            extent.bounded = true;
+        }
+        return extent;
     }
 
     Object *CSG_tree::create_sphere(Color color, glm::vec3 center, float radius, float texture, float para) {
@@ -159,19 +445,42 @@ namespace Objects {
         return tetrahedron;
     }
 
+    bool CSG_tree::check_operands(const Object *left, const Object *right) {
+        if (left == nullptr || right == nullptr) {
+            std::cout << "[Error] CSG operand is null (a previous operation was rejected)" << std::endl;
+            return false;
+        }
+        bool free_left = left->parent == nullptr || left->parent->root_union;
+        bool free_right = right->parent == nullptr || right->parent->root_union;
+        if (left == right || !free_left || !free_right) {
+            std::cout << "[Error] CSG operand already belongs to another operation" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
     Object *CSG_tree::create_intersection(Object *left, Object *right) {
+        if (!check_operands(left, right)) {
+            return nullptr;
+        }
         auto *intersection = new Object(INTERSECTION, {1.0f, 1.0f, 1.0f, 1.0f}, {}, left, right);
         object_list.push_back(intersection);
         return intersection;
     }
 
     Object *CSG_tree::create_union(Object *left, Object *right) {
+        if (!check_operands(left, right)) {
+            return nullptr;
+        }
         auto *unionObj = new Object(UNION, {1.0f, 1.0f, 1.0f, 1.0f}, {}, left, right);
         object_list.push_back(unionObj);
         return unionObj;
     }
 
     Object *CSG_tree::create_subtract(Object *left, Object *right) {
+        if (!check_operands(left, right)) {
+            return nullptr;
+        }
         auto *difference = new Object(DIFFERENCE, {1.0f, 1.0f, 1.0f, 1.0f}, {}, left, right);
         object_list.push_back(difference);
 
@@ -225,6 +534,7 @@ namespace Objects {
     }
 
     void Object::translate(const glm::vec3 &d) {
+        dirty = true;
         switch (type) {
             case SPHERE:
             case CUBOID:
@@ -246,10 +556,14 @@ namespace Objects {
                     pos_args[i + 2] += d.z;
                 }
                 break;
+
+            default:
+                break;
         }
     }
 
     void Object::scale(float s) {
+        dirty = true;
         switch (type) {
             case SPHERE:
                 pos_args[3] *= s;
@@ -323,12 +637,16 @@ namespace Objects {
                 pos_args[11] = v3.z;
                 break;
             }
+
+            default:
+                break;
         }
     }
 
     void Object::rotate(const glm::vec3 &axis,
                         float angleRad,
                         const glm::vec3 &pivot) {
+        dirty = true;
         glm::mat4 R4 = glm::rotate(glm::mat4(1.0f), angleRad, glm::normalize(axis));
         glm::mat3 R = glm::mat3(R4);
 
@@ -386,5 +704,110 @@ namespace Objects {
         }
     }
 
+    AABB Object::bounding_box() const {
+        auto vec3At = [&](int i) { return glm::vec3(pos_args[i], pos_args[i + 1], pos_args[i + 2]); };
+        // 半径为 r、法向为 axis 的圆盘在各坐标轴上的半宽
+        auto diskExtent = [](const glm::vec3 &axis, float r) {
+            glm::vec3 n = glm::normalize(axis);
+            return r * glm::sqrt(glm::max(glm::vec3(1.0f) - n * n, glm::vec3(0.0f)));
+        };
+
+        AABB box;
+        box.bounded = true;
+        switch (type) {
+            case SPHERE: {
+                glm::vec3 c = vec3At(0);
+                box.min = c - glm::vec3(pos_args[3]);
+                box.max = c + glm::vec3(pos_args[3]);
+                break;
+            }
+            case CONE: {
+                // 底面圆盘 (center, radius) 与顶点 vertex 的包围盒
+                glm::vec3 c = vec3At(0), v = vec3At(3);
+                glm::vec3 e = diskExtent(c - v, pos_args[6]);
+                box.min = glm::min(c - e, v);
+                box.max = glm::max(c + e, v);
+                break;
+            }
+            case CYLINDER: {
+                glm::vec3 a = vec3At(0), b = vec3At(3);
+                glm::vec3 e = diskExtent(b - a, pos_args[6]);
+                box.min = glm::min(a, b) - e;
+                box.max = glm::max(a, b) + e;
+                break;
+            }
+            case CUBOID: {
+                // 与 shader 中 sdBox 相同的旋转矩阵 (列主序)，局部坐标 q = R * p
+                float ca = std::cos(pos_args[6]), sa = std::sin(pos_args[6]);
+                float cb = std::cos(pos_args[7]), sb = std::sin(pos_args[7]);
+                float cg = std::cos(pos_args[8]), sg = std::sin(pos_args[8]);
+                glm::mat3 Rz_alpha(ca, -sa, 0.0f, sa, ca, 0.0f, 0.0f, 0.0f, 1.0f);
+                glm::mat3 Rx_beta(1.0f, 0.0f, 0.0f, 0.0f, cb, -sb, 0.0f, sb, cb);
+                glm::mat3 Rz_gamma(cg, -sg, 0.0f, sg, cg, 0.0f, 0.0f, 0.0f, 1.0f);
+                glm::mat3 R = Rz_gamma * Rx_beta * Rz_alpha;
+                glm::vec3 half = vec3At(3) * 0.5f;
+                glm::vec3 e;
+                for (int i = 0; i < 3; ++i) {
+                    e[i] = std::abs(R[i][0]) * half.x + std::abs(R[i][1]) * half.y + std::abs(R[i][2]) * half.z;
+                }
+                box.min = vec3At(0) - e;
+                box.max = vec3At(0) + e;
+                break;
+            }
+            case TETRAHEDRON:
+                box.min = glm::min(glm::min(vec3At(0), vec3At(3)), glm::min(vec3At(6), vec3At(9)));
+                box.max = glm::max(glm::max(vec3At(0), vec3At(3)), glm::max(vec3At(6), vec3At(9)));
+                break;
+            case MENGER_SPONGE:
+                box.min = vec3At(0) - glm::vec3(pos_args[3]);
+                box.max = vec3At(0) + glm::vec3(pos_args[3]);
+                break;
+            case MANDELBULB:
+                // |w| > 2 时第一次迭代即逃逸，距离估计远大于 0
+                box.min = vec3At(0) - glm::vec3(2.0f * pos_args[3]);
+                box.max = vec3At(0) + glm::vec3(2.0f * pos_args[3]);
+                break;
+            case JULIA_SET_3D:
+                // 逃逸半径为 4 (m2 > 16)
+                box.min = vec3At(0) - glm::vec3(4.0f * pos_args[3]);
+                box.max = vec3At(0) + glm::vec3(4.0f * pos_args[3]);
+                break;
+            case PLANE:
+                box.bounded = false;
+                return box;
+            case UNION:
+            case INTERSECTION:
+            case DIFFERENCE: {
+                AABB l = left->bounding_box(), r = right->bounding_box();
+                if (type == DIFFERENCE) {
+                    return l;                               // 差集总在左侧物体之内
+                }
+                if (type == INTERSECTION && l.bounded != r.bounded) {
+                    return l.bounded ? l : r;
+                }
+                if (!l.bounded || !r.bounded) {
+                    box.bounded = false;
+                    return box;
+                }
+                if (type == INTERSECTION) {
+                    // max(a, b) ≥ a，所以任一侧的包围盒都是保守的；两盒的重叠部分则不是 (距离场只是下界)
+                    glm::vec3 el = l.max - l.min, er = r.max - r.min;
+                    return el.x * el.y * el.z <= er.x * er.y * er.z ? l : r;
+                }
+                box.min = glm::min(l.min, r.min);
+                box.max = glm::max(l.max, r.max);
+                return box;
+            }
+            case MULTI_UNION:
+            case MULTI_INTERSECTION:
+                box.bounded = false;                        // 只出现在打包后的程序中，不是物体的类型
+                return box;
+        }
+        // 留出浮点误差的余量
+        box.min -= glm::vec3(1e-3f);
+        box.max += glm::vec3(1e-3f);
+        return box;
+    }
+
 
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <glm/vec3.hpp>
 #include <vector>
+#include "bvh.h"
 
 namespace Objects {
 
@@ -19,6 +20,10 @@ namespace Objects {
         MENGER_SPONGE,
         MANDELBULB,
         JULIA_SET_3D,
+        // 只出现在打包后的程序中：pos_args[0] 为 k，把其后 k 条基元依次并入 (交入) 栈中同一格，
+        // 与 k 个操作数的 UNION / INTERSECTION 链结果相同，但程序更短、只多占一格栈
+        MULTI_UNION,
+        MULTI_INTERSECTION,
     };
 
     struct Color {
@@ -35,9 +40,14 @@ namespace Objects {
         Object *right = nullptr;
         Object *parent = nullptr;
         int max_stack_length = 0;
-        bool first_left = true;
+        bool dirty = true;          // pos_args 在上次打包后被修改过
+        int slot = -1;              // 在 textureData 中的下标 (TBO 中第 slot * 8 个 texel 起)，未打包时为 -1
+        int member = -1;            // 所属根部并集成员的编号
+        int fold_count = 0;         // > 0 时该并集 / 交集节点打包为 MULTI_UNION / MULTI_INTERSECTION
+        bool root_union = false;    // finalize() 为把没有父节点的物体并入 root 而建的并集
 
-        std::vector<float> packObjectToTextureData();
+        // 写出 32 float 的记录：type, RGBA, pos_args[0..26]
+        void packObjectToTextureData(float *dst) const;
 
     public:
         Object(Object_type type, Color color, std::initializer_list<float> pos_args,
@@ -50,25 +60,108 @@ namespace Objects {
         void rotate(const glm::vec3 &axis,
                     float angleRad,
                     const glm::vec3 &pivot = glm::vec3(0.0f));
+
+        // 由 pos_args 计算保守的包围盒，分形取中心与逃逸半径 × scale
+        AABB bounding_box() const;
+
+        bool is_dirty() const { return dirty; }
+
+        int texture_slot() const { return slot; }
     };
 
     class CSG_tree {
 
         Object *root;
         std::vector<Object *> object_list;
+        std::vector<Object *> root_unions;      // finalize() 建的根部并集 (不在 object_list 中)，结构改变时丢弃重建
+        std::vector<Object *> slot_objects;     // 槽位 -> 物体，BVH 插入的 UNION 对应 nullptr
+        std::vector<Object *> member_roots;     // 根部并集的成员
+        std::vector<int> member_leaves;         // 成员所在的 BVH 叶子，无界成员为 -1
+        std::vector<float> program_cache;       // finalize() 的结果
+        std::vector<float> bvh_cache;
+        size_t finalized_objects = 0;           // 上次定型时 object_list 的大小；用户的物体只增不减，大小不变即结构未变
+        int stack_length = 0;                   // 线性求值整段程序所需的栈深
+        bool fractals = false;                  // 程序中是否有分形指令
+        // 以下只是重复使用的临时缓冲，避免每次打包都重新分配
+        std::vector<Object *> postorder_list;
+        std::vector<BVHMember> bvh_members;
+        std::vector<GlueRecord> bvh_glue;       // 槽位上没有物体的指令 (见 build_bvh)
+        std::vector<char> moved_members;
+        std::vector<int> refit_leaves;
+        std::vector<int> refit_nodes;
+
+        // 把以 object 为顶的同类运算链 (type 为 UNION 或 INTERSECTION) 展开为操作数与运算节点
+        void collect_chain(Object *object, Object_type type,
+                           std::vector<Object *> &operands, std::vector<Object *> &operators);
+
+        static void sort_chain(std::vector<Object *> &operands);
+
+        // 排序后末尾只需一格栈的基元个数，≥ 2 时打包为一条 MULTI_* 指令
+        static int foldable_operands(const std::vector<Object *> &operands);
 
         void get_min_stack_order(Object *object);
 
-        void generate_texture_data_postorder(Object *object,
-                                             std::vector<std::vector<float>> &textureData);
+        void generate_texture_data_postorder(Object *object, std::vector<Object *> &order);
+
+        void collect_union_members(Object *object, std::vector<Object *> &members);
+
+        void rebuild_layout();
+
+        void refresh_values(std::vector<int> *slots, std::vector<AABB> *movedBounds, std::vector<int> *nodes);
+
+        // CSG 运算的操作数必须是两个不同的、还不属于其他运算的非空物体 (属于根部并集的除外)；不满足时输出错误并返回 false
+        static bool check_operands(const Object *left, const Object *right);
 
     public:
         CSG_tree();
 
         ~CSG_tree();
 
+        // 定型：把没有父节点的物体并入 root，排好指令与 BVH，结果缓存在树中，可重复调用。
+        // 只有新建了物体 / CSG 运算 (结构改变) 才丢弃上次的根部并集、按当前没有父节点的物体重新合并，
+        // 并重新计算栈顺序、后序遍历和 BVH，返回 true；
+        // 否则只重新打包 translate / scale / rotate 过的物体并重新拟合 BVH，什么都没变时几乎没有开销
+        bool finalize();
+
+        const std::vector<float> &texture_data() const { return program_cache; }
+
+        const std::vector<float> &bvh_data() const { return bvh_cache; }
+
+        // 求值所需的栈深 (≤ 8)，shader 可以按它声明更小的栈数组
+        int stack_size() const { return stack_length; }
+
+        // 场景中是否有分形：分形的距离估计可能偏大，光线步进要用保守的步长系数；只有基元时距离是严格的下界
+        bool has_fractals() const { return fractals; }
+
+        // 根部并集中有界成员的包围盒之并 (按当前位置)；没有有界成员时 bounded == false
+        AABB bounded_extent() const;
+
+        // 以下几个接口都先调用 finalize()，再把缓存的结果拷贝给调用方
         std::vector<std::vector<float>> generate_texture_data();
 
+        // 根部并集的各个成员按 BVH 叶子顺序输出，每个成员的指令连续存放；
+        // bvhData 接收节点数组 (见 bvh.h)，shader 可据此跳过远处的子树
+        std::vector<std::vector<float>> generate_texture_data(std::vector<float> &bvhData);
+
+        // 同上，但直接写入一段连续的缓冲 (每条指令 32 float，即 TBO 的内容)。
+        // program 与 bvhData 只在变大时重新分配，逐帧调用时复用已有容量，每个物体不再单独分配内存
+        void generate_texture_data(std::vector<float> &program, std::vector<float> &bvhData);
+
+        // 按上次 generate_texture_data() 的排列把全部指令写到 dst (texture_data_size() * 32 float)，
+        // dst 可以是 glMapBufferRange 映射出的内存。不分配内存，也不改变树的结构
+        void pack_texture_data(float *dst) const;
+
+        int texture_data_size() const { return static_cast<int>(slot_objects.size()); }
+
+        // 只重新打包上次定型之后被 translate / scale / rotate 过的物体：
+        // 写回 program 中各自固定的槽位，并重新拟合它们所在成员的 BVH 叶子及祖先节点 (结构不变)。
+        // 返回改动的槽位 (升序)，调用方据此只上传 TBO 中对应的区间。
+        // movedBounds 非空时追加移动过的成员移动前后的包围盒 (各一个)，无界成员追加一个 bounded == false 的盒子。
+        // bvhNodes 非空时追加重新拟合的 BVH 节点 (叶子及其祖先，升序)，bvhData 中也只写回这些节点。
+        // 新建物体或新的 CSG 运算改变了树的结构，仍需重新调用 generate_texture_data()
+        std::vector<int> update_dirty(std::vector<float> &program, std::vector<float> &bvhData,
+                                      std::vector<AABB> *movedBounds = nullptr, std::vector<int> *bvhNodes = nullptr);
+
         Object *create_sphere(Color color, glm::vec3 center, float radius, float texture = 0, float para = 0.0f);
 
         Object *create_cone(Color color, glm::vec3 center, glm::vec3 vertex, float radius, 
@@ -97,6 +190,9 @@ namespace Objects {
                                     glm::vec2 c_param, int max_iterations = 64, 
                                     bool orbit_trap = false, float texture = 0, float para = 0.0f);
 
+        // 以下三个运算的操作数已经属于另一个运算 (或 left == right) 时拒绝，返回 nullptr，调用方需检查；
+        // 操作数为 nullptr (上一个运算被拒绝) 时同样返回 nullptr，嵌套调用不会解引用空指针。
+        // 定型时并入根部并集的物体仍可作为操作数
         Object *create_intersection(Object *left, Object *right);
 
         Object *create_union(Object *left, Object *right);
@@ -0,0 +1,137 @@
+#include <glm/glm.hpp>
+#include <iostream>
+#include "scenes.h"
+
+namespace Scenes {
+
+    using namespace Objects;
+
+    void build_default(CSG_tree &tree) {
+        // 创建地面
+        auto* ground = tree.create_plane({0.7f, 0.7f, 0.7f, 1.0f}, glm::vec3(0.0f, 1.0f, 0.0f), -1.0f);
+
+        // 创建Menger Sponge分形 - 左侧，金色
+        // auto* menger = tree.create_menger_sponge(
+        //     {1.0f, 0.8f, 0.3f, 1.0f},           // 颜色：金色
+        //     glm::vec3(-6.0f, 1.2f, 0.0f),       // 中心位置：左侧，更远
+        //     1.8f,                                // 大小
+        //     5,                                   // 迭代次数：4层精细度
+        //     0,                                   // 漫反射材质
+        //     0.0f                                 // 材质参数
+        // );
+
+        // // 创建Mandelbulb分形 - 中间，紫红色
+        // auto* mandelbulb = tree.create_mandelbulb(
+        //     {1.0f, 0.3f, 0.8f, 1.0f},           // 颜色：紫红色
+        //     glm::vec3(0.0f, 1.0f, 0.0f),        // 中心位置：中间
+        //     2.2f,                                // 缩放系数：更大一点
+        //     8.0f,                                // Mandelbulb幂次 (经典值)
+        //     80,                                  // 迭代次数：更高精度
+        //     0,                                   // 漫反射材质
+        //     0.0f                                 // 材质参数
+        // );
+
+        // 创建Julia Set 3D分形 - 左侧，不使用orbit trap，基础颜色
+        auto* julia3d_clean = tree.create_julia_set_3d(
+            {0.3f, 1.0f, 0.6f, 1.0f},           // 颜色：青绿色（基础颜色）
+            glm::vec3(-3.0f, 1.0f, 0.0f),       // 中心位置：左侧
+            2.0f,                                // 缩放系数
+            glm::vec2(-0.75f, 0.11f),           // 树枝状Julia参数
+            64,                                  // 迭代次数
+            false,                               // 不使用orbit trap (保持原始颜色)
+            0,                                   // 漫反射材质
+            0.0f                                 // 材质参数
+        );
+
+        // 创建Julia Set 3D分形 - 右侧，使用orbit trap，相同基础颜色
+        auto* julia3d_orbit = tree.create_julia_set_3d(
+            {0.3f, 1.0f, 0.6f, 1.0f},           // 颜色：相同的青绿色（会被orbit trap调制）
+            glm::vec3(3.0f, 1.0f, 0.0f),        // 中心位置：右侧
+            2.0f,                                // 缩放系数
+            glm::vec2(-0.75f, 0.11f),           // 相同的Julia参数
+            64,                                  // 迭代次数
+            true,                                // 使用orbit trap (会产生橙红色调制效果)
+            0,                                   // 漫反射材质
+            0.0f                                 // 材质参数
+        );
+    }
+
+    void build_mandelbulb(CSG_tree &tree) {
+        tree.create_plane({0.7f, 0.7f, 0.7f, 1.0f}, glm::vec3(0.0f, 1.0f, 0.0f), -1.0f);
+        tree.create_mandelbulb(
+            {1.0f, 0.3f, 0.8f, 1.0f},           // 颜色：紫红色
+            glm::vec3(0.0f, 1.0f, 0.0f),        // 中心位置：中间
+            2.2f,                                // 缩放系数
+            8.0f,                                // Mandelbulb幂次 (经典值)
+            80,                                  // 迭代次数
+            0,                                   // 漫反射材质
+            0.0f                                 // 材质参数
+        );
+    }
+
+    void build_menger(CSG_tree &tree) {
+        tree.create_plane({0.7f, 0.7f, 0.7f, 1.0f}, glm::vec3(0.0f, 1.0f, 0.0f), -1.0f);
+        tree.create_menger_sponge(
+            {1.0f, 0.8f, 0.3f, 1.0f},           // 颜色：金色
+            glm::vec3(0.0f, 1.2f, 0.0f),        // 中心位置：放在画面中间
+            1.8f,                                // 大小
+            5,                                   // 迭代次数
+            0,                                   // 漫反射材质
+            0.0f                                 // 材质参数
+        );
+    }
+
+    void build_csg_stress(CSG_tree &tree, int count) {
+        tree.create_plane({0.7f, 0.7f, 0.7f, 1.0f}, glm::vec3(0.0f, 1.0f, 0.0f), -1.0f);
+
+        // 每个格子 4 个基元：(立方体 ∩ 球) - 圆柱，再并上顶部的小球；格子铺在相机前方的地面上
+        int cells = count / 4;
+        int side = 1;
+        while (side * side < cells) ++side;
+        const float spacing = 1.0f;
+        for (int i = 0; i < cells; ++i) {
+            int gx = i % side, gz = i / side;
+            glm::vec3 c((gx - (side - 1) * 0.5f) * spacing, -0.65f, -1.0f + gz * spacing);
+            Color color = {0.3f + 0.7f * gx / side, 0.4f, 0.3f + 0.7f * gz / side, 1.0f};
+            Object *box = tree.create_cuboid(color, c, 0.6f, 0.6f, 0.6f, 0.0f, 0.0f, 0.0f);
+            Object *ball = tree.create_sphere(color, c, 0.4f);
+            Object *hole = tree.create_cylinder(color, c - glm::vec3(0.0f, 0.5f, 0.0f), c + glm::vec3(0.0f, 0.5f, 0.0f), 0.15f);
+            Object *cap = tree.create_sphere({1.0f, 1.0f, 1.0f, 1.0f}, c + glm::vec3(0.0f, 0.4f, 0.0f), 0.1f);
+            Object *cell = tree.create_union(tree.create_subtract(tree.create_intersection(box, ball), hole), cap);
+            if (cell == nullptr) {
+                std::cout << "[Error] csg_stress: cell " << i << " was rejected" << std::endl;
+                return;
+            }
+        }
+    }
+
+    void build_materials(CSG_tree &tree) {
+        tree.create_plane({0.7f, 0.7f, 0.7f, 1.0f}, glm::vec3(0.0f, 1.0f, 0.0f), -1.0f);
+        tree.create_sphere({0.9f, 0.9f, 0.9f, 1.0f}, glm::vec3(-1.8f, 0.2f, 0.5f), 1.2f, 1);        // 镜面
+        tree.create_sphere({1.0f, 1.0f, 1.0f, 1.0f}, glm::vec3(1.5f, 0.0f, 0.0f), 1.0f, 2, 1.5f);   // 折射
+        tree.create_cuboid({0.8f, 0.3f, 0.2f, 1.0f}, glm::vec3(0.0f, -0.2f, 3.0f), 1.6f, 1.6f, 1.6f,
+                           0.6f, 0.0f, 0.0f);
+    }
+
+    const std::vector<SceneEntry> &scene_list() {
+        static const std::vector<SceneEntry> scenes = {
+                {"julia",      build_default},
+                {"mandelbulb", build_mandelbulb},
+                {"menger",     build_menger},
+                {"csg_stress", [](CSG_tree &tree) { build_csg_stress(tree); }},
+                {"materials",  build_materials},
+        };
+        return scenes;
+    }
+
+    bool build_scene(const std::string &name, CSG_tree &tree) {
+        for (const SceneEntry &scene: scene_list()) {
+            if (name == scene.name) {
+                scene.build(tree);
+                return true;
+            }
+        }
+        return false;
+    }
+
+}
@@ -0,0 +1,38 @@
+#ifndef ISR_SCENES_H
+#define ISR_SCENES_H
+
+#include <string>
+#include <vector>
+#include "objects.h"
+
+namespace Scenes {
+
+    // 默认场景：地面 + 左右两个 Julia Set (右侧开启 orbit trap)
+    void build_default(Objects::CSG_tree &tree);
+
+    // 地面 + Mandelbulb (默认场景中注释掉的那一个)
+    void build_mandelbulb(Objects::CSG_tree &tree);
+
+    // 地面 + Menger Sponge (默认场景中注释掉的那一个)
+    void build_menger(Objects::CSG_tree &tree);
+
+    // CSG 压力场景：地面 + 网格排列的 (立方体 ∩ 球) - 圆柱 ∪ 小球，共 count 个基元 (向下取整到 4 的倍数)
+    void build_csg_stress(Objects::CSG_tree &tree, int count = 500);
+
+    // 材质场景：镜面球、折射球 (折射率 1.5)、漫反射立方体与地面
+    void build_materials(Objects::CSG_tree &tree);
+
+    struct SceneEntry {
+        const char *name;
+        void (*build)(Objects::CSG_tree &tree);
+    };
+
+    // 按名字登记的全部场景 (ISR_bench 的固定场景集)
+    const std::vector<SceneEntry> &scene_list();
+
+    // 找不到 name 时返回 false，tree 不变
+    bool build_scene(const std::string &name, Objects::CSG_tree &tree);
+
+}
+
+#endif //ISR_SCENES_H
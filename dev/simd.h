@@ -0,0 +1,626 @@
+#ifndef ISR_SIMD_H
+#define ISR_SIMD_H
+
+// CPU 批量求值用的最小 SIMD 封装。
+// 按编译选项选择宽度：AVX-512 16 路、AVX2 8 路、SSE2 4 路，其余平台退化为标量 (1 路)。
+// 包含前定义 ISR_SIMD_AVX512 / ISR_SIMD_AVX2 时直接使用该宽度 (运行时分发的翻译单元以 target 属性编译，
+// 编译选项中没有对应的 -m 参数，见 evaluator_simd.inl)。
+// 只提供 SDF 核函数需要的运算；超越函数为 Cephes 多项式近似 (单精度，误差约 1e-7 量级)。
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(ISR_SIMD_AVX512) || defined(ISR_SIMD_AVX2)
+#include <immintrin.h>
+#elif defined(__AVX512F__)
+#include <immintrin.h>
+#define ISR_SIMD_AVX512
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define ISR_SIMD_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ISR_SIMD_SSE2
+#else
+#define ISR_SIMD_SCALAR
+#endif
+
+// 每种宽度的函数放在各自的内联命名空间中：几个翻译单元以不同的指令集包含本文件时，内联函数不会同名
+#if defined(ISR_SIMD_AVX512)
+#define ISR_SIMD_NAMESPACE avx512
+#elif defined(ISR_SIMD_AVX2)
+#define ISR_SIMD_NAMESPACE avx2
+#elif defined(ISR_SIMD_SSE2)
+#define ISR_SIMD_NAMESPACE sse2
+#else
+#define ISR_SIMD_NAMESPACE scalar
+#endif
+
+namespace Simd { inline namespace ISR_SIMD_NAMESPACE {
+
+#if defined(ISR_SIMD_AVX512)
+    static const int LANES = 16;
+    static const char *const ISA = "AVX-512";
+    typedef __m512 native_f;
+    typedef __m512i native_i;
+    typedef __mmask16 native_m;
+#elif defined(ISR_SIMD_AVX2)
+    static const int LANES = 8;
+    static const char *const ISA = "AVX2";
+    typedef __m256 native_f;
+    typedef __m256i native_i;
+    typedef __m256 native_m;
+#elif defined(ISR_SIMD_SSE2)
+    static const int LANES = 4;
+    static const char *const ISA = "SSE2";
+    typedef __m128 native_f;
+    typedef __m128i native_i;
+    typedef __m128 native_m;
+#else
+    static const int LANES = 1;
+    static const char *const ISA = "scalar";
+    typedef float native_f;
+    typedef int32_t native_i;
+    typedef bool native_m;
+#endif
+
+    struct vfloat {
+        native_f v;
+    };
+
+    struct vint {
+        native_i v;
+    };
+
+    struct vmask {
+        native_m m;
+    };
+
+    /* ---------- 加载 / 存储 ---------- */
+
+    inline vfloat set1(float s) {
+#if defined(ISR_SIMD_AVX512)
+        return {_mm512_set1_ps(s)};
+#elif defined(ISR_SIMD_AVX2)
+        return {_mm256_set1_ps(s)};
+#elif defined(ISR_SIMD_SSE2)
+        return {_mm_set1_ps(s)};
+#else
+        return {s};
+#endif
+    }
+
+    inline vint set1i(int32_t s) {
+#if defined(ISR_SIMD_AVX512)
+        return {_mm512_set1_epi32(s)};
+#elif defined(ISR_SIMD_AVX2)
+        return {_mm256_set1_epi32(s)};
+#elif defined(ISR_SIMD_SSE2)
+        return {_mm_set1_epi32(s)};
+#else
+        return {s};
+#endif
+    }
+
+    inline vfloat load(const float *p) {
+#if defined(ISR_SIMD_AVX512)
+        return {_mm512_loadu_ps(p)};
+#elif defined(ISR_SIMD_AVX2)
+        return {_mm256_loadu_ps(p)};
+#elif defined(ISR_SIMD_SSE2)
+        return {_mm_loadu_ps(p)};
+#else
+        return {*p};
+#endif
+    }
+
+    inline void store(float *p, vfloat a) {
+#if defined(ISR_SIMD_AVX512)
+        _mm512_storeu_ps(p, a.v);
+#elif defined(ISR_SIMD_AVX2)
+        _mm256_storeu_ps(p, a.v);
+#elif defined(ISR_SIMD_SSE2)
+        _mm_storeu_ps(p, a.v);
+#else
+        *p = a.v;
+#endif
+    }
+
+    /* ---------- 算术 ---------- */
+
+#if defined(ISR_SIMD_AVX512)
+#define ISR_SIMD_BINARY(name, op) inline vfloat name(vfloat a, vfloat b) { return {_mm512_##op##_ps(a.v, b.v)}; }
+#elif defined(ISR_SIMD_AVX2)
+#define ISR_SIMD_BINARY(name, op) inline vfloat name(vfloat a, vfloat b) { return {_mm256_##op##_ps(a.v, b.v)}; }
+#elif defined(ISR_SIMD_SSE2)
+#define ISR_SIMD_BINARY(name, op) inline vfloat name(vfloat a, vfloat b) { return {_mm_##op##_ps(a.v, b.v)}; }
+#endif
+
+#if !defined(ISR_SIMD_SCALAR)
+    ISR_SIMD_BINARY(operator+, add)
+    ISR_SIMD_BINARY(operator-, sub)
+    ISR_SIMD_BINARY(operator*, mul)
+    ISR_SIMD_BINARY(operator/, div)
+    ISR_SIMD_BINARY(min, min)
+    ISR_SIMD_BINARY(max, max)
+#undef ISR_SIMD_BINARY
+#else
+    inline vfloat operator+(vfloat a, vfloat b) { return {a.v + b.v}; }
+    inline vfloat operator-(vfloat a, vfloat b) { return {a.v - b.v}; }
+    inline vfloat operator*(vfloat a, vfloat b) { return {a.v * b.v}; }
+    inline vfloat operator/(vfloat a, vfloat b) { return {a.v / b.v}; }
+    inline vfloat min(vfloat a, vfloat b) { return {b.v < a.v ? b.v : a.v}; }
+    inline vfloat max(vfloat a, vfloat b) { return {a.v < b.v ? b.v : a.v}; }
+#endif
+
+    inline vfloat operator+(vfloat a, float b) { return a + set1(b); }
+    inline vfloat operator-(vfloat a, float b) { return a - set1(b); }
+    inline vfloat operator*(vfloat a, float b) { return a * set1(b); }
+    inline vfloat operator/(vfloat a, float b) { return a / set1(b); }
+    inline vfloat operator+(float a, vfloat b) { return set1(a) + b; }
+    inline vfloat operator-(float a, vfloat b) { return set1(a) - b; }
+    inline vfloat operator*(float a, vfloat b) { return set1(a) * b; }
+    inline vfloat operator/(float a, vfloat b) { return set1(a) / b; }
+    inline vfloat min(vfloat a, float b) { return min(a, set1(b)); }
+    inline vfloat max(vfloat a, float b) { return max(a, set1(b)); }
+
+    inline vfloat sqrt(vfloat a) {
+#if defined(ISR_SIMD_AVX512)
+        return {_mm512_sqrt_ps(a.v)};
+#elif defined(ISR_SIMD_AVX2)
+        return {_mm256_sqrt_ps(a.v)};
+#elif defined(ISR_SIMD_SSE2)
+        return {_mm_sqrt_ps(a.v)};
+#else
+        return {std::sqrt(a.v)};
+#endif
+    }
+
+    inline vfloat floor(vfloat a) {
+#if defined(ISR_SIMD_AVX512)
+        return {_mm512_roundscale_ps(a.v, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC)};
+#elif defined(ISR_SIMD_AVX2)
+        return {_mm256_floor_ps(a.v)};
+#elif defined(ISR_SIMD_SSE2)
+        // SSE2 没有 floor：截断后对负数修正 (|a| < 2^31)
+        __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+        return {_mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a.v), _mm_set1_ps(1.0f)))};
+#else
+        return {std::floor(a.v)};
+#endif
+    }
+
+    /* ---------- 位运算 (浮点掩码与整数) ---------- */
+
+    inline vint as_int(vfloat a) {
+#if defined(ISR_SIMD_AVX512)
+        return {_mm512_castps_si512(a.v)};
+#elif defined(ISR_SIMD_AVX2)
+        return {_mm256_castps_si256(a.v)};
+#elif defined(ISR_SIMD_SSE2)
+        return {_mm_castps_si128(a.v)};
+#else
+        vint r;
+        std::memcpy(&r.v, &a.v, sizeof(float));
+        return r;
+#endif
+    }
+
+    inline vfloat as_float(vint a) {
+#if defined(ISR_SIMD_AVX512)
+        return {_mm512_castsi512_ps(a.v)};
+#elif defined(ISR_SIMD_AVX2)
+        return {_mm256_castsi256_ps(a.v)};
+#elif defined(ISR_SIMD_SSE2)
+        return {_mm_castsi128_ps(a.v)};
+#else
+        vfloat r;
+        std::memcpy(&r.v, &a.v, sizeof(float));
+        return r;
+#endif
+    }
+
+    inline vint operator+(vint a, vint b) {
+#if defined(ISR_SIMD_AVX512)
+        return {_mm512_add_epi32(a.v, b.v)};
+#elif defined(ISR_SIMD_AVX2)
+        return {_mm256_add_epi32(a.v, b.v)};
+#elif defined(ISR_SIMD_SSE2)
+        return {_mm_add_epi32(a.v, b.v)};
+#else
+        return {a.v + b.v};
+#endif
+    }
+
+    inline vint operator-(vint a, vint b) {
+#if defined(ISR_SIMD_AVX512)
+        return {_mm512_sub_epi32(a.v, b.v)};
+#elif defined(ISR_SIMD_AVX2)
+        return {_mm256_sub_epi32(a.v, b.v)};
+#elif defined(ISR_SIMD_SSE2)
+        return {_mm_sub_epi32(a.v, b.v)};
+#else
+        return {a.v - b.v};
+#endif
+    }
+
+    inline vint operator&(vint a, vint b) {
+#if defined(ISR_SIMD_AVX512)
+        return {_mm512_and_si512(a.v, b.v)};
+#elif defined(ISR_SIMD_AVX2)
+        return {_mm256_and_si256(a.v, b.v)};
+#elif defined(ISR_SIMD_SSE2)
+        return {_mm_and_si128(a.v, b.v)};
+#else
+        return {a.v & b.v};
+#endif
+    }
+
+    inline vint operator|(vint a, vint b) {
+#if defined(ISR_SIMD_AVX512)
+        return {_mm512_or_si512(a.v, b.v)};
+#elif defined(ISR_SIMD_AVX2)
+        return {_mm256_or_si256(a.v, b.v)};
+#elif defined(ISR_SIMD_SSE2)
+        return {_mm_or_si128(a.v, b.v)};
+#else
+        return {a.v | b.v};
+#endif
+    }
+
+    inline vint operator^(vint a, vint b) {
+#if defined(ISR_SIMD_AVX512)
+        return {_mm512_xor_si512(a.v, b.v)};
+#elif defined(ISR_SIMD_AVX2)
+        return {_mm256_xor_si256(a.v, b.v)};
+#elif defined(ISR_SIMD_SSE2)
+        return {_mm_xor_si128(a.v, b.v)};
+#else
+        return {a.v ^ b.v};
+#endif
+    }
+
+    template<int N>
+    inline vint shift_left(vint a) {
+#if defined(ISR_SIMD_AVX512)
+        return {_mm512_slli_epi32(a.v, N)};
+#elif defined(ISR_SIMD_AVX2)
+        return {_mm256_slli_epi32(a.v, N)};
+#elif defined(ISR_SIMD_SSE2)
+        return {_mm_slli_epi32(a.v, N)};
+#else
+        return {static_cast<int32_t>(static_cast<uint32_t>(a.v) << N)};
+#endif
+    }
+
+    template<int N>
+    inline vint shift_right(vint a) {     // 逻辑右移
+#if defined(ISR_SIMD_AVX512)
+        return {_mm512_srli_epi32(a.v, N)};
+#elif defined(ISR_SIMD_AVX2)
+        return {_mm256_srli_epi32(a.v, N)};
+#elif defined(ISR_SIMD_SSE2)
+        return {_mm_srli_epi32(a.v, N)};
+#else
+        return {static_cast<int32_t>(static_cast<uint32_t>(a.v) >> N)};
+#endif
+    }
+
+    inline vint truncate(vfloat a) {
+#if defined(ISR_SIMD_AVX512)
+        return {_mm512_cvttps_epi32(a.v)};
+#elif defined(ISR_SIMD_AVX2)
+        return {_mm256_cvttps_epi32(a.v)};
+#elif defined(ISR_SIMD_SSE2)
+        return {_mm_cvttps_epi32(a.v)};
+#else
+        return {static_cast<int32_t>(a.v)};
+#endif
+    }
+
+    inline vfloat to_float(vint a) {
+#if defined(ISR_SIMD_AVX512)
+        return {_mm512_cvtepi32_ps(a.v)};
+#elif defined(ISR_SIMD_AVX2)
+        return {_mm256_cvtepi32_ps(a.v)};
+#elif defined(ISR_SIMD_SSE2)
+        return {_mm_cvtepi32_ps(a.v)};
+#else
+        return {static_cast<float>(a.v)};
+#endif
+    }
+
+    inline vfloat operator-(vfloat a) {
+        return as_float(as_int(a) ^ set1i(INT32_MIN));
+    }
+
+    inline vfloat abs(vfloat a) {
+        return as_float(as_int(a) & set1i(0x7fffffff));
+    }
+
+    /* ---------- 比较与选择 ---------- */
+
+#if defined(ISR_SIMD_AVX512)
+#define ISR_SIMD_COMPARE(op, pred) inline vmask operator op(vfloat a, vfloat b) { return {_mm512_cmp_ps_mask(a.v, b.v, pred)}; }
+#elif defined(ISR_SIMD_AVX2)
+#define ISR_SIMD_COMPARE(op, pred) inline vmask operator op(vfloat a, vfloat b) { return {_mm256_cmp_ps(a.v, b.v, pred)}; }
+#endif
+
+#if defined(ISR_SIMD_AVX512) || defined(ISR_SIMD_AVX2)
+    ISR_SIMD_COMPARE(<, _CMP_LT_OQ)
+    ISR_SIMD_COMPARE(<=, _CMP_LE_OQ)
+    ISR_SIMD_COMPARE(>, _CMP_GT_OQ)
+    ISR_SIMD_COMPARE(>=, _CMP_GE_OQ)
+    ISR_SIMD_COMPARE(==, _CMP_EQ_OQ)
+#undef ISR_SIMD_COMPARE
+#elif defined(ISR_SIMD_SSE2)
+    inline vmask operator<(vfloat a, vfloat b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+    inline vmask operator<=(vfloat a, vfloat b) { return {_mm_cmple_ps(a.v, b.v)}; }
+    inline vmask operator>(vfloat a, vfloat b) { return {_mm_cmpgt_ps(a.v, b.v)}; }
+    inline vmask operator>=(vfloat a, vfloat b) { return {_mm_cmpge_ps(a.v, b.v)}; }
+    inline vmask operator==(vfloat a, vfloat b) { return {_mm_cmpeq_ps(a.v, b.v)}; }
+#else
+    inline vmask operator<(vfloat a, vfloat b) { return {a.v < b.v}; }
+    inline vmask operator<=(vfloat a, vfloat b) { return {a.v <= b.v}; }
+    inline vmask operator>(vfloat a, vfloat b) { return {a.v > b.v}; }
+    inline vmask operator>=(vfloat a, vfloat b) { return {a.v >= b.v}; }
+    inline vmask operator==(vfloat a, vfloat b) { return {a.v == b.v}; }
+#endif
+
+    inline vmask operator<(vfloat a, float b) { return a < set1(b); }
+    inline vmask operator<=(vfloat a, float b) { return a <= set1(b); }
+    inline vmask operator>(vfloat a, float b) { return a > set1(b); }
+    inline vmask operator>=(vfloat a, float b) { return a >= set1(b); }
+    inline vmask operator==(vfloat a, float b) { return a == set1(b); }
+
+    inline vmask operator&(vmask a, vmask b) {
+#if defined(ISR_SIMD_AVX512)
+        return {static_cast<__mmask16>(a.m & b.m)};
+#elif defined(ISR_SIMD_AVX2)
+        return {_mm256_and_ps(a.m, b.m)};
+#elif defined(ISR_SIMD_SSE2)
+        return {_mm_and_ps(a.m, b.m)};
+#else
+        return {a.m && b.m};
+#endif
+    }
+
+    inline vmask operator|(vmask a, vmask b) {
+#if defined(ISR_SIMD_AVX512)
+        return {static_cast<__mmask16>(a.m | b.m)};
+#elif defined(ISR_SIMD_AVX2)
+        return {_mm256_or_ps(a.m, b.m)};
+#elif defined(ISR_SIMD_SSE2)
+        return {_mm_or_ps(a.m, b.m)};
+#else
+        return {a.m || b.m};
+#endif
+    }
+
+    // a & !b
+    inline vmask and_not(vmask a, vmask b) {
+#if defined(ISR_SIMD_AVX512)
+        return {static_cast<__mmask16>(a.m & ~b.m)};
+#elif defined(ISR_SIMD_AVX2)
+        return {_mm256_andnot_ps(b.m, a.m)};
+#elif defined(ISR_SIMD_SSE2)
+        return {_mm_andnot_ps(b.m, a.m)};
+#else
+        return {a.m && !b.m};
+#endif
+    }
+
+    inline bool any(vmask a) {
+#if defined(ISR_SIMD_AVX512)
+        return a.m != 0;
+#elif defined(ISR_SIMD_AVX2)
+        return _mm256_movemask_ps(a.m) != 0;
+#elif defined(ISR_SIMD_SSE2)
+        return _mm_movemask_ps(a.m) != 0;
+#else
+        return a.m;
+#endif
+    }
+
+    inline vmask all_lanes() {
+        return set1(0.0f) == set1(0.0f);
+    }
+
+    // m 为真的通道取 a，否则取 b
+    inline vfloat select(vmask m, vfloat a, vfloat b) {
+#if defined(ISR_SIMD_AVX512)
+        return {_mm512_mask_blend_ps(m.m, b.v, a.v)};
+#elif defined(ISR_SIMD_AVX2)
+        return {_mm256_blendv_ps(b.v, a.v, m.m)};
+#elif defined(ISR_SIMD_SSE2)
+        return {_mm_or_ps(_mm_and_ps(m.m, a.v), _mm_andnot_ps(m.m, b.v))};
+#else
+        return {m.m ? a.v : b.v};
+#endif
+    }
+
+    inline vint select(vmask m, vint a, vint b) {
+        return as_int(select(m, as_float(a), as_float(b)));
+    }
+
+    /* ---------- 超越函数 (Cephes 单精度) ---------- */
+
+    inline vfloat clamp(vfloat x, float lo, float hi) {
+        return min(max(x, lo), hi);
+    }
+
+    inline vfloat sign(vfloat x) {
+        return select(x > 0.0f, set1(1.0f), select(x < 0.0f, set1(-1.0f), set1(0.0f)));
+    }
+
+    inline vfloat exp(vfloat x) {
+        x = clamp(x, -87.3f, 88.3f);
+        vfloat fn = floor(x * 1.44269504088896341f + 0.5f);
+        x = x - fn * 0.693359375f;
+        x = x - fn * -2.12194440e-4f;
+
+        vfloat z = x * x;
+        vfloat y = set1(1.9875691500e-4f);
+        y = y * x + 1.3981999507e-3f;
+        y = y * x + 8.3334519073e-3f;
+        y = y * x + 4.1665795894e-2f;
+        y = y * x + 1.6666665459e-1f;
+        y = y * x + 5.0000001201e-1f;
+        y = y * z + x + 1.0f;
+
+        vfloat pow2n = as_float(shift_left<23>(truncate(fn) + set1i(127)));
+        return y * pow2n;
+    }
+
+    // 仅对 x > 0 有意义；x <= 0 返回 -inf
+    inline vfloat log(vfloat x) {
+        vmask invalid = x <= 0.0f;
+        x = max(x, 1.17549435e-38f);
+
+        vint bits = as_int(x);
+        vfloat e = to_float(shift_right<23>(bits) - set1i(126));
+        x = as_float((bits & set1i(0x007fffff)) | set1i(0x3f000000));     // [0.5, 1)
+
+        vmask small = x < 0.707106781186547524f;
+        e = select(small, e - 1.0f, e);
+        x = select(small, x + x, x) - 1.0f;
+
+        vfloat z = x * x;
+        vfloat y = set1(7.0376836292e-2f);
+        y = y * x - 1.1514610310e-1f;
+        y = y * x + 1.1676998740e-1f;
+        y = y * x - 1.2420140846e-1f;
+        y = y * x + 1.4249322787e-1f;
+        y = y * x - 1.6668057665e-1f;
+        y = y * x + 2.0000714765e-1f;
+        y = y * x - 2.4999993993e-1f;
+        y = y * x + 3.3333331174e-1f;
+        y = y * x * z;
+        y = y + e * -2.12194440e-4f;
+        y = y - z * 0.5f;
+        x = x + y + e * 0.693359375f;
+        return select(invalid, set1(-INFINITY), x);
+    }
+
+    // a > 0
+    inline vfloat pow(vfloat a, float b) {
+        return exp(log(a) * b);
+    }
+
+    namespace detail {
+        // 把 x 规约到 [-pi/4, pi/4]，j 为象限序号 (偶数)
+        inline vfloat reduce_quadrant(vfloat x, vint &j) {
+            j = truncate(x * 1.27323954473516f);
+            j = (j + set1i(1)) & set1i(~1);
+            vfloat y = to_float(j);
+            x = x - y * 0.78515625f;
+            x = x - y * 2.4187564849853515625e-4f;
+            x = x - y * 3.77489497744594108e-8f;
+            return x;
+        }
+
+        inline vfloat cos_poly(vfloat z) {
+            vfloat y = set1(2.443315711809948e-5f);
+            y = y * z - 1.388731625493765e-3f;
+            y = y * z + 4.166664568298827e-2f;
+            return y * z * z - z * 0.5f + 1.0f;
+        }
+
+        inline vfloat sin_poly(vfloat x, vfloat z) {
+            vfloat y = set1(-1.9515295891e-4f);
+            y = y * z + 8.3321608736e-3f;
+            y = y * z - 1.6666654611e-1f;
+            return y * z * x + x;
+        }
+
+        inline vmask lane_bit_clear(vint j, int bit) {
+            vint t = j & set1i(bit);
+#if defined(ISR_SIMD_AVX512)
+            return {_mm512_cmpeq_epi32_mask(t.v, _mm512_setzero_si512())};
+#elif defined(ISR_SIMD_AVX2)
+            return {_mm256_castsi256_ps(_mm256_cmpeq_epi32(t.v, _mm256_setzero_si256()))};
+#elif defined(ISR_SIMD_SSE2)
+            return {_mm_castsi128_ps(_mm_cmpeq_epi32(t.v, _mm_setzero_si128()))};
+#else
+            return {t.v == 0};
+#endif
+        }
+
+        inline vfloat atan_positive(vfloat x) {
+            vmask big = x > 2.414213562373095f;
+            vmask mid = and_not(x > 0.4142135623730950f, big);
+            vfloat y0 = select(big, set1(1.57079632679489661923f),
+                               select(mid, set1(0.78539816339744830962f), set1(0.0f)));
+            x = select(big, -1.0f / x, select(mid, (x - 1.0f) / (x + 1.0f), x));
+
+            vfloat z = x * x;
+            vfloat y = set1(8.05374449538e-2f);
+            y = y * z - 1.38776856032e-1f;
+            y = y * z + 1.99777106478e-1f;
+            y = y * z - 3.33329491539e-1f;
+            return y * z * x + x + y0;
+        }
+    }
+
+    inline vfloat sin(vfloat x) {
+        vint sign_bit = as_int(x) & set1i(INT32_MIN);
+        x = abs(x);
+        vint j;
+        x = detail::reduce_quadrant(x, j);
+        sign_bit = sign_bit ^ shift_left<29>(j & set1i(4));
+
+        vfloat z = x * x;
+        vfloat y = select(detail::lane_bit_clear(j, 2), detail::sin_poly(x, z), detail::cos_poly(z));
+        return as_float(as_int(y) ^ sign_bit);
+    }
+
+    inline vfloat cos(vfloat x) {
+        x = abs(x);
+        vint j;
+        x = detail::reduce_quadrant(x, j);
+        j = j - set1i(2);
+        vint sign_bit = shift_left<29>((j ^ set1i(-1)) & set1i(4));
+
+        vfloat z = x * x;
+        vfloat y = select(detail::lane_bit_clear(j, 2), detail::sin_poly(x, z), detail::cos_poly(z));
+        return as_float(as_int(y) ^ sign_bit);
+    }
+
+    // 与 std::atan2 相同的值域 (-pi, pi]，atan2(0, 0) = 0
+    inline vfloat atan2(vfloat y, vfloat x) {
+        vfloat ay = abs(y), ax = abs(x);
+        vmask both_zero = (ax == 0.0f) & (ay == 0.0f);
+        vfloat a = detail::atan_positive(ay / select(both_zero, set1(1.0f), ax));
+        a = select(x < 0.0f, set1(3.14159265358979323846f) - a, a);
+        a = as_float(as_int(a) ^ (as_int(y) & set1i(INT32_MIN)));
+        return select(both_zero, set1(0.0f), a);
+    }
+
+    inline vfloat acos(vfloat x) {
+        return atan2(sqrt(max(1.0f - x * x, 0.0f)), x);
+    }
+
+    /* ---------- 三维向量 (SoA) ---------- */
+
+    struct vec3 {
+        vfloat x, y, z;
+    };
+
+    inline vec3 operator-(const vec3 &a, const vec3 &b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+
+    inline vec3 operator-(const vec3 &a, const float *b) { return {a.x - b[0], a.y - b[1], a.z - b[2]}; }
+
+    inline vec3 operator*(const vec3 &a, float s) { return {a.x * s, a.y * s, a.z * s}; }
+
+    inline vfloat dot(const vec3 &a, const vec3 &b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+    inline vfloat dot(const vec3 &a, const float *b) { return a.x * b[0] + a.y * b[1] + a.z * b[2]; }
+
+    inline vfloat length(const vec3 &a) { return sqrt(dot(a, a)); }
+
+    inline vec3 abs(const vec3 &a) { return {abs(a.x), abs(a.y), abs(a.z)}; }
+
+} }
+
+#endif //ISR_SIMD_H
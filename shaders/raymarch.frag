@@ -1,20 +1,61 @@
 #version 430 core
-out vec4 FragColor;
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out vec4 GeomOut;  // 边缘自适应抗锯齿第一遍 / G-buffer：第一次命中的法线与距离
+layout(location = 2) out float MaterialOut;  // G-buffer：第一次命中的材质参数
 in  vec2 fragCoord;
 
 uniform vec2  iResolution;          // 屏幕分辨率
 
 uniform samplerBuffer objectBuffer; // TBO 采样器
 uniform int           numObjects;   // 物体数量
+uniform samplerBuffer bvhBuffer;    // BVH 节点，每个节点 2 × vec4 (见 dev/bvh.h)
+uniform int           numBVHNodes;  // 0 表示不使用 BVH，线性遍历全部物体
 uniform samplerCube uEnvMap; 
 uniform int         uEnvEnable;
+uniform int         uAccumFrame;  // 0 = 每帧 2x2 网格超采样；k > 0 = 渐进累积的第 k 个抖动采样 (由主程序混合求平均)
+uniform int         uAAPass;      // 网格超采样的方式：0 = 每个像素；1 / 2 = 边缘自适应的两遍 (见 main)
+layout(binding = 3) uniform sampler2D uAAColor;     // 第一遍的结果，第二遍读取 (EdgeAA::COLOR_UNIT)
+layout(binding = 4) uniform sampler2D uAAGeom;      // (EdgeAA::GEOM_UNIT)
+uniform int         uConePass;    // 1 = 锥体预步进：视口为块数，每个片段写出一块的安全起点
+uniform int         uConeTile;    // > 0 时主光线从 uConeDepth 中所在块的距离开始步进，块边长为 uConeTile 像素
+layout(binding = 5) uniform sampler2D uConeDepth;   // ConePrepass::DEPTH_UNIT
+uniform float       uStepScale;   // 距离的安全系数：场景有分形时 0.7 (距离估计可能偏大)，只有基元时 1.0；未设置时按 0.7
+uniform float       uRelax;       // 过松弛系数 ω：≤ 1 为普通的球体追踪
+uniform int         uDeferred;    // 延迟着色：1 = 把第一次命中写进 G-buffer；2 = 单采样的绘制从 G-buffer 着色
+layout(binding = 6) uniform sampler2D uGAlbedo;     // G-buffer：基色 + 材质 ID (GBuffer::ALBEDO_UNIT)
+layout(binding = 7) uniform sampler2D uGGeom;       // G-buffer：法线 + 距离 (GEOM_UNIT)
+layout(binding = 8) uniform sampler2D uGMaterial;   // G-buffer：材质参数 (MATERIAL_UNIT)
+uniform int         uLightScale;  // > 0 时漫反射的第一次命中从 uGLighting 双边上采样软阴影与 AO (见 upsampleLighting)
+layout(binding = 9) uniform sampler2D uGLighting;   // 1 / uLightScale 分辨率的主光阴影 + AO (LIGHTING_UNIT)
+uniform int         uShadowPass;  // 1 = 画主光阴影缓存的第 uShadowSlice 层 (见 ShadowVolume)
+uniform int         uShadowSlice;
+uniform ivec3       uShadowRes;   // 阴影缓存的体素数
+uniform int         uShadowVolume;  // 1 = 主光阴影从 uShadowTex 三线性插值，体积外的点仍然步进
+layout(binding = 10) uniform sampler3D uShadowTex;   // ShadowVolume::SHADOW_UNIT
+uniform vec3        uShadowMin;   // 阴影缓存的世界坐标范围
+uniform vec3        uShadowMax;
+uniform float       uShadowOffset;  // 查询点沿法线的偏移 (1/4 个体素对角线)，减轻表面处被物体内部拉低的插值
+uniform int         uCountSteps;  // 1 = 把 march() 的总步数累加到 StepCounter (ISR_bench --steps)
+
+layout(std430, binding = 0) buffer StepCounter
+{
+    uint totalSteps;
+};
+int marchSteps = 0;
+// > 0 时 distOne() 在颜色通道中返回基元的梯度 (见 mapGrad)，值为分形做差分的步长
+float gradStep = 0.0;
+
+// 解释器的栈深度：主程序按场景实际需要的深度在 #version 之后定义 STACK_SIZE，栈越浅占用的寄存器越少
+#ifndef STACK_SIZE
+#define STACK_SIZE 8
+#endif
 
 float sdSphere(vec3 p, float r)
 {
     return length(p) - r;
 }
 
-float sdBox(vec3 p, float alpha, float beta, float gamma, vec3 b)
+mat3 boxRotation(float alpha, float beta, float gamma)
 {
     // rotate around Z axis
     mat3 Rz_alpha = mat3(
@@ -37,7 +78,18 @@ float sdBox(vec3 p, float alpha, float beta, float gamma, vec3 b)
         0.0,         0.0,        1.0
     );
 
-    mat3 R = Rz_gamma * Rx_beta * Rz_alpha;
+    return Rz_gamma * Rx_beta * Rz_alpha;
+}
+
+float sdBox(vec3 p, float alpha, float beta, float gamma, vec3 b)
+{
+    vec3 q = abs(boxRotation(alpha, beta, gamma) * p) - b;
+    return length(max(q, 0.0)) + min(max(q.x, max(q.y, q.z)), 0.0);
+}
+
+// 旋转矩阵已预先算好的 sdBox (场景编译时使用)
+float sdBoxFrame(vec3 p, mat3 R, vec3 b)
+{
     vec3 q = abs(R * p) - b;
     return length(max(q, 0.0)) + min(max(q.x, max(q.y, q.z)), 0.0);
 }
@@ -68,6 +120,13 @@ float sdCylinderFlat(vec3 p, vec3 a, vec3 b, float r)
     return min(max(d.x, d.y), 0.0) + length(max(d, 0.0));
 }
 
+// 已变换到圆柱局部坐标 (z 为轴向，原点在中点) 的 sdCylinderFlat (场景编译时使用)
+float sdCylinderLocal(vec3 lp, float r, float h2)
+{
+    vec2 d = abs(vec2(length(lp.xy), lp.z)) - vec2(r, h2);
+    return min(max(d.x, d.y), 0.0) + length(max(d, 0.0));
+}
+
 float sdCone(vec3 p, vec2 c, float h)
 {
     vec2 q = h * vec2(c.x / c.y, -1.0);
@@ -137,6 +196,110 @@ float sdPlane(vec3 p, vec3 n, float h)
     return dot(p, n) + h;  
 }
 
+/* ------------------------------------------------------------
+ * 解析梯度：sdg* 返回 vec4(梯度, 距离)，距离与对应的 sd* 相同。
+ * 梯度在局部坐标中求出后用同一个旋转矩阵变换回世界坐标
+ * ----------------------------------------------------------*/
+vec4 sdgSphere(vec3 p, float r)
+{
+    float l = length(p);
+    return vec4(p / max(l, 1e-20), l - r);
+}
+
+// p 已减去中心；局部坐标为 R * p
+vec4 sdgBoxFrame(vec3 p, mat3 R, vec3 b)
+{
+    vec3 lp = R * p;
+    vec3 w  = abs(lp) - b;
+    float g = max(w.x, max(w.y, w.z));
+    vec3 q  = max(w, 0.0);
+    float l = length(q);
+    // 外部指向最近点，内部指向最近的面
+    vec3 dir = g > 0.0 ? q / l
+             : (w.x > w.y && w.x > w.z) ? vec3(1.0, 0.0, 0.0)
+             : (w.y > w.z ? vec3(0.0, 1.0, 0.0) : vec3(0.0, 0.0, 1.0));
+    return vec4(transpose(R) * (sign(lp) * dir), l + min(g, 0.0));
+}
+
+// p 已减去中点；B 的三列为圆柱的局部坐标基 (z 为轴向)
+vec4 sdgCylinderFrame(vec3 p, mat3 B, float r, float h2)
+{
+    vec3  lp = p * B;
+    float rl = length(lp.xy);
+    vec2  d  = abs(vec2(rl, lp.z)) - vec2(r, h2);
+    vec2  q  = max(d, 0.0);
+    float l  = length(q);
+    vec2  g2 = max(d.x, d.y) > 0.0 ? q / l : (d.x > d.y ? vec2(1.0, 0.0) : vec2(0.0, 1.0));
+    vec3  g  = vec3(g2.x * lp.xy / max(rl, 1e-20), g2.y * sign(lp.z));
+    return vec4(B * g, min(max(d.x, d.y), 0.0) + l);
+}
+
+vec4 sdgCylinderFlat(vec3 p, vec3 a, vec3 b, float r)
+{
+    vec3  ba   = b - a;
+    float h2   = length(ba) * 0.5;
+    vec3  axis = ba / (h2 * 2.0);
+    vec3  up   = abs(axis.z) < 0.999 ? vec3(0,0,1) : vec3(1,0,0);
+    vec3  x    = normalize(cross(up, axis));
+    return sdgCylinderFrame(p - (a + b) * 0.5, mat3(x, cross(axis, x), axis), r, h2);
+}
+
+// 与 sdCone 相同的二维最近点，梯度为 (w - 最近点) 的方向，再由 w = (length(p.xz), p.y) 还原到三维
+vec4 sdgCone(vec3 p, vec2 c, float h)
+{
+    vec2 q = h * vec2(c.x / c.y, -1.0);
+
+    float rl = length(p.xz);
+    vec2 w = vec2(rl, p.y);
+    vec2 a = w - q * clamp(dot(w,q) / dot(q,q), 0.0, 1.0);
+    vec2 b = w - q * vec2(clamp(w.x / q.x, 0.0, 1.0), 1.0);
+    float k = sign(q.y);
+    float da = dot(a, a), db = dot(b, b);
+    float s = sign(max(k * (w.x * q.y - w.y * q.x), k * (w.y - q.y)));
+    vec2 v = da < db ? a : b;
+    float l = sqrt(min(da, db));
+    vec2 g2 = s * v / max(l, 1e-20);
+    return vec4(g2.x * p.x / max(rl, 1e-20), g2.y, g2.x * p.z / max(rl, 1e-20), l * s);
+}
+
+// p 已减去顶点；局部坐标为 transpose(B) * p
+vec4 sdgConeFrame(vec3 p, mat3 B, vec2 c, float h)
+{
+    vec4 g = sdgCone(p * B, c, h);
+    return vec4(B * g.xyz, g.w);
+}
+
+// 四个面的半空间取 max：梯度为距离最大的面的法线
+vec4 sdgMaxPlane(vec4 acc, vec3 p, vec3 n, float d)
+{
+    float e = dot(p, n) - d;
+    return e > acc.w ? vec4(n, e) : acc;
+}
+
+vec4 sdgTetrahedron(vec3 p, vec3 v0, vec3 v1, vec3 v2, vec3 v3)
+{
+    vec3 verts[4] = vec3[]( v0, v1, v2, v3 );
+    int faces[4][3] = int[4][3](
+      int[3](0,1,2),
+      int[3](0,2,3),
+      int[3](0,3,1),
+      int[3](1,3,2)
+    );
+
+    vec3 cen = (v0 + v1 + v2 + v3) * 0.25;
+
+    vec4 res = vec4(0.0, 0.0, 0.0, -1e20);
+    for(int i = 0; i < 4; ++i)
+    {
+        vec3 a = verts[faces[i][0]];
+        vec3 n = normalize( cross( verts[faces[i][1]] - a, verts[faces[i][2]] - a ) );
+        if( dot(cen - a, n) > 0.0 )
+            n = -n;
+        res = sdgMaxPlane(res, p, n, dot(a, n));
+    }
+    return res;
+}
+
 float sdMengerSponge(vec3 p, float size, int iterations)
 {
     p = p / size;
@@ -299,7 +462,75 @@ vec4 sdJuliaSet3D_WithColor(vec3 p, vec3 center, float scale, vec2 c, int maxIte
     return vec4(finalColor, d);
 }
 
-void distOne(int idx, vec3 p, inout vec4 stack[8], inout int stack_top, inout int matIDStack[8], inout float matParStack[8])
+// 只求距离的 Julia 集合：与 sdJuliaSet3D_WithColor 的距离相同，省去 orbit trap 与调色板
+float sdJuliaSet3D(vec3 p, vec3 center, float scale, vec2 c, int maxIter)
+{
+    vec3 z = (p - center) / scale;
+    float m2 = 0.0;
+    float dz = 1.0;
+
+    for(int i = 0; i < maxIter; i++)
+    {
+        m2 = dot(z, z);
+        if(m2 > 16.0) break;
+
+        dz = 2.0 * sqrt(m2) * dz + 1.0;
+
+        float x = z.x, y = z.y, zz = z.z;
+        z = vec3(
+            x*x - y*y - zz*zz + c.x,
+            2.0*x*y + c.y,
+            2.0*x*zz
+        );
+    }
+    return m2 > 16.0 ? 0.5 * sqrt(m2) * log(m2) / dz * scale : -0.1 * scale;
+}
+
+/* ------------------------------------------------------------
+ * 分形没有解析梯度：只对这一个分形做四面体差分 (4 次求值而不是中心差分的 6 次)，
+ * 距离取四个顶点的平均 (四个偏移之和为 0，误差为 h 的二阶小量)
+ * ----------------------------------------------------------*/
+const vec2 TETRA_K = vec2(1.0, -1.0);
+
+vec4 tetraGrad(float d0, float d1, float d2, float d3, float h)
+{
+    vec3 g = TETRA_K.xyy * d0 + TETRA_K.yyx * d1 + TETRA_K.yxy * d2 + TETRA_K.xxx * d3;
+    return vec4(g / (4.0 * h), (d0 + d1 + d2 + d3) * 0.25);
+}
+
+vec4 sdgMengerSponge(vec3 p, float size, int iterations, float h)
+{
+    return tetraGrad(sdMengerSponge(p + TETRA_K.xyy * h, size, iterations),
+                     sdMengerSponge(p + TETRA_K.yyx * h, size, iterations),
+                     sdMengerSponge(p + TETRA_K.yxy * h, size, iterations),
+                     sdMengerSponge(p + TETRA_K.xxx * h, size, iterations), h);
+}
+
+vec4 sdgMandelbulb(vec3 p, vec3 center, float scale, float power, int maxIter, float h)
+{
+    return tetraGrad(sdMandelbulb(p + TETRA_K.xyy * h, center, scale, power, maxIter),
+                     sdMandelbulb(p + TETRA_K.yyx * h, center, scale, power, maxIter),
+                     sdMandelbulb(p + TETRA_K.yxy * h, center, scale, power, maxIter),
+                     sdMandelbulb(p + TETRA_K.xxx * h, center, scale, power, maxIter), h);
+}
+
+vec4 sdgJuliaSet3D(vec3 p, vec3 center, float scale, vec2 c, int maxIter, float h)
+{
+    return tetraGrad(sdJuliaSet3D(p + TETRA_K.xyy * h, center, scale, c, maxIter),
+                     sdJuliaSet3D(p + TETRA_K.yyx * h, center, scale, c, maxIter),
+                     sdJuliaSet3D(p + TETRA_K.yxy * h, center, scale, c, maxIter),
+                     sdJuliaSet3D(p + TETRA_K.xxx * h, center, scale, c, maxIter), h);
+}
+
+/* ------------------------------------------------------------
+ * distOne
+ *   执行一条后序指令。MULTI_UNION / MULTI_INTERSECTION (12/13) 压入单位元并记下 foldLeft，
+ *   其后 foldLeft 条基元不再入栈，而是直接与栈顶合并 (规则与 6/5 相同)。
+ *   gradStep > 0 时栈中的 xyz 是梯度而不是颜色：CSG 只在两个距离中选一个，选中的梯度即为结果的梯度，
+ *   差集取反时梯度一起取反。
+ * ----------------------------------------------------------*/
+void distOne(int idx, vec3 p, inout vec4 stack[STACK_SIZE], inout int stack_top, inout int matIDStack[STACK_SIZE], inout float matParStack[STACK_SIZE],
+             inout int foldType, inout int foldLeft)
 {
     const int STRIDE = 8;               // 8 × vec4
     int base = idx * STRIDE;
@@ -313,6 +544,11 @@ void distOne(int idx, vec3 p, inout vec4 stack[8], inout int stack_top, inout in
     int  type = int(t0.x + 0.5);
     vec3 curColor  = t0.yzw;                 // rgb
 
+    vec4  prim    = vec4(0.0);
+    int   primID  = 0;
+    float primPar = 0.0;
+    bool  isPrim  = false;
+
     if (type == 0)                      /* ---------- SPHERE ---------- */
     {
         vec3 center = t1.yzw;           // (pos0~2)
@@ -320,10 +556,10 @@ void distOne(int idx, vec3 p, inout vec4 stack[8], inout int stack_top, inout in
         float texture = t2.y;
         float para = t2.z;
 
-        stack[stack_top] = vec4(curColor, sdSphere(p - center, radius));
-        matIDStack[stack_top]  = int(texture + 0.5);
-        matParStack[stack_top] = para;
-        stack_top += 1;
+        prim    = gradStep > 0.0 ? sdgSphere(p - center, radius) : vec4(curColor, sdSphere(p - center, radius));
+        primID  = int(texture + 0.5);
+        primPar = para;
+        isPrim  = true;
     }
     else if (type == 1)               /* ------------ CONE -------------*/
     {
@@ -347,10 +583,10 @@ void distOne(int idx, vec3 p, inout vec4 stack[8], inout int stack_top, inout in
         float angle = atan(radius, height);
         vec2  c     = vec2(sin(angle), cos(angle));
 
-        stack[stack_top] = vec4(curColor, sdCone(p_local, c, height));
-        matIDStack[stack_top]  = int(texture + 0.5);
-        matParStack[stack_top] = para;
-        stack_top += 1;
+        prim    = gradStep > 0.0 ? sdgConeFrame(p - vertex, basis, c, height) : vec4(curColor, sdCone(p_local, c, height));
+        primID  = int(texture + 0.5);
+        primPar = para;
+        isPrim  = true;
     }
     else if (type == 2)               /* ---------- CYLINDER ---------- */
     {
@@ -360,10 +596,10 @@ void distOne(int idx, vec3 p, inout vec4 stack[8], inout int stack_top, inout in
         float texture = t3.x;
         float para = t3.y;
 
-        stack[stack_top] = vec4(curColor, sdCylinderFlat(p, a, b, radius));
-        matIDStack[stack_top]  = int(texture + 0.5);
-        matParStack[stack_top] = para;
-        stack_top += 1;
+        prim    = gradStep > 0.0 ? sdgCylinderFlat(p, a, b, radius) : vec4(curColor, sdCylinderFlat(p, a, b, radius));
+        primID  = int(texture + 0.5);
+        primPar = para;
+        isPrim  = true;
     }
     else if (type == 3)                 /* ---------- CUBOID ---------- */
     {
@@ -375,10 +611,11 @@ void distOne(int idx, vec3 p, inout vec4 stack[8], inout int stack_top, inout in
         float texture = t3.z;
         float para = t3.w;
 
-        stack[stack_top] = vec4(curColor, sdBox(p - center, alpha, beta, gamma, halfExt));
-        matIDStack[stack_top]  = int(texture + 0.5);
-        matParStack[stack_top] = para;
-        stack_top += 1;
+        prim    = gradStep > 0.0 ? sdgBoxFrame(p - center, boxRotation(alpha, beta, gamma), halfExt)
+                                 : vec4(curColor, sdBox(p - center, alpha, beta, gamma, halfExt));
+        primID  = int(texture + 0.5);
+        primPar = para;
+        isPrim  = true;
     }
     else if (type == 4)                 /* ---------- Tetrahedron ---------- */
     {
@@ -389,10 +626,10 @@ void distOne(int idx, vec3 p, inout vec4 stack[8], inout int stack_top, inout in
         float texture = t4.y;
         float para = t4.z;
 
-        stack[stack_top] = vec4(curColor, sdTetrahedron(p, v0, v1, v2, v3));
-        matIDStack[stack_top]  = int(texture + 0.5);
-        matParStack[stack_top] = para;
-        stack_top += 1;
+        prim    = gradStep > 0.0 ? sdgTetrahedron(p, v0, v1, v2, v3) : vec4(curColor, sdTetrahedron(p, v0, v1, v2, v3));
+        primID  = int(texture + 0.5);
+        primPar = para;
+        isPrim  = true;
     }
     else if (type == 5)                 /* ---------- Intersect ---------- */
     {
@@ -438,7 +675,7 @@ void distOne(int idx, vec3 p, inout vec4 stack[8], inout int stack_top, inout in
         float pr2  = matParStack[stack_top-1];
         stack_top -= 1;
         float condition = step(sdf1, -sdf2);
-        stack[stack_top - 1] = mix(vec4(color1, sdf1), vec4(color2, -sdf2), condition);
+        stack[stack_top - 1] = mix(vec4(color1, sdf1), vec4(gradStep > 0.0 ? -color2 : color2, -sdf2), condition);
 
         matIDStack[stack_top-1]  = int( mix(float(id1), float(id2), condition) + 0.5 );
         matParStack[stack_top-1] = mix(pr1, pr2, condition);
@@ -449,10 +686,10 @@ void distOne(int idx, vec3 p, inout vec4 stack[8], inout int stack_top, inout in
         float h = t2.x;
         float texture = t2.y;
         float para = t2.z;
-        stack[stack_top] = vec4(curColor, sdPlane(p, n, h));
-        matIDStack[stack_top] = int(texture + 0.5);
-        matParStack[stack_top]= para;
-        stack_top += 1;
+        prim    = vec4(gradStep > 0.0 ? n : curColor, sdPlane(p, n, h));
+        primID  = int(texture + 0.5);
+        primPar = para;
+        isPrim  = true;
     }
     else if (type == 9)                 /* ---------- MENGER_SPONGE ---------- */
     {
@@ -462,10 +699,11 @@ void distOne(int idx, vec3 p, inout vec4 stack[8], inout int stack_top, inout in
         float texture = t2.z;
         float para = t2.w;
         
-        stack[stack_top] = vec4(curColor, sdMengerSponge(p - center, size, iterations));
-        matIDStack[stack_top] = int(texture + 0.5);
-        matParStack[stack_top]= para;
-        stack_top += 1;
+        prim    = gradStep > 0.0 ? sdgMengerSponge(p - center, size, iterations, gradStep)
+                                 : vec4(curColor, sdMengerSponge(p - center, size, iterations));
+        primID  = int(texture + 0.5);
+        primPar = para;
+        isPrim  = true;
     }
     else if (type == 10)                /* ---------- MANDELBULB ---------- */
     {
@@ -476,10 +714,11 @@ void distOne(int idx, vec3 p, inout vec4 stack[8], inout int stack_top, inout in
         float texture = t2.w;           // (pos6) 材质类型
         float para = t3.x;              // (pos7) 材质参数
         
-        stack[stack_top] = vec4(curColor, sdMandelbulb(p, center, scale, power, maxIter));
-        matIDStack[stack_top] = int(texture + 0.5);
-        matParStack[stack_top] = para;
-        stack_top += 1;
+        prim    = gradStep > 0.0 ? sdgMandelbulb(p, center, scale, power, maxIter, gradStep)
+                                 : vec4(curColor, sdMandelbulb(p, center, scale, power, maxIter));
+        primID  = int(texture + 0.5);
+        primPar = para;
+        isPrim  = true;
     }
     else if (type == 11)                /* ---------- JULIA_SET_3D ---------- */
     {
@@ -491,27 +730,166 @@ void distOne(int idx, vec3 p, inout vec4 stack[8], inout int stack_top, inout in
         float texture = t3.y;           // (pos8) 材质类型
         float para = t3.z;              // (pos9) 材质参数
         
-        // 每次查询都重新计算该位置的颜色和距离
-        vec4 result = sdJuliaSet3D_WithColor(p, center, scale, c_param, maxIter, orbitTrap, curColor);
-        
-        // result.xyz是动态计算的颜色，result.w是距离
-        stack[stack_top] = result;
-        matIDStack[stack_top] = int(texture + 0.5);
-        matParStack[stack_top] = para;
+        if (gradStep > 0.0)
+        {
+            prim = sdgJuliaSet3D(p, center, scale, c_param, maxIter, gradStep);
+        }
+        else
+        {
+            // 每次查询都重新计算该位置的颜色和距离
+            vec4 result = sdJuliaSet3D_WithColor(p, center, scale, c_param, maxIter, orbitTrap, curColor);
+
+            // result.xyz是动态计算的颜色，result.w是距离
+            prim    = result;
+        }
+        primID  = int(texture + 0.5);
+        primPar = para;
+        isPrim  = true;
+    }
+    else if (type == 12 || type == 13)  /* ---------- MULTI_UNION / MULTI_INTERSECTION ---------- */
+    {
+        stack[stack_top] = vec4(0.0, 0.0, 0.0, type == 12 ? 1e30 : -1e30);
+        matIDStack[stack_top]  = 0;
+        matParStack[stack_top] = 0.0;
         stack_top += 1;
+        foldType = type;
+        foldLeft = int(t1.y + 0.5);     // (pos0) 合并的基元条数
+    }
+
+    if (isPrim)
+    {
+        if (foldLeft > 0)
+        {
+            vec4  acc = stack[stack_top - 1];
+            float notCloser = step(acc.w, prim.w);    // 并集只在更近时替换，交集在不更近时替换
+            float condition = foldType == 12 ? notCloser : 1.0 - notCloser;
+            stack[stack_top - 1] = mix(prim, acc, condition);
+            matIDStack[stack_top - 1]  = int( mix(float(primID), float(matIDStack[stack_top - 1]), condition) + 0.5 );
+            matParStack[stack_top - 1] = mix(primPar, matParStack[stack_top - 1], condition);
+            foldLeft -= 1;
+        }
+        else
+        {
+            stack[stack_top] = prim;
+            matIDStack[stack_top]  = primID;
+            matParStack[stack_top] = primPar;
+            stack_top += 1;
+        }
     }
 }
 
-float map(vec3 p, out vec3 col, out int matID, out float matPar)
+/* ------------------------------------------------------------
+ * distOnly
+ *   distOne 的只求距离版本：栈中只有距离，不取颜色与材质，Julia 不做 orbit trap 着色。
+ *   步进、阴影与 AO 的内层循环只需要距离，颜色与材质在命中点由 map() 求一次
+ * ----------------------------------------------------------*/
+float primDist(int type, vec4 t1, vec4 t2, vec4 t3, vec4 t4, vec3 p)
 {
-    vec4 stack[8] = vec4[8](vec4(0.0), vec4(0.0), vec4(0.0), vec4(0.0), vec4(0.0), vec4(0.0), vec4(0.0), vec4(0.0));
-    int   idStack [8] = int[8](0, 0, 0, 0, 0, 0, 0, 0);
-    float parStack[8] = float[8](0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+    if (type == 0)                      /* SPHERE */
+    {
+        return sdSphere(p - t1.yzw, t2.x);
+    }
+    else if (type == 1)                 /* CONE */
+    {
+        vec3 center = t1.yzw, vertex = t2.xyz;
+        vec3 axis = normalize(center - vertex);
+        float height = length(center - vertex);
+        vec3 up = abs(axis.y) < 0.999 ? vec3(0,1,0) : vec3(1,0,0);
+        vec3 x  = normalize(cross(up, axis));
+        float angle = atan(t2.w, height);
+        return sdCone((p - vertex) * mat3(x, -axis, cross(axis, x)), vec2(sin(angle), cos(angle)), height);
+    }
+    else if (type == 2)                 /* CYLINDER */
+    {
+        return sdCylinderFlat(p, t1.yzw, t2.xyz, t2.w);
+    }
+    else if (type == 3)                 /* CUBOID */
+    {
+        return sdBox(p - t1.yzw, t2.w, t3.x, t3.y, t2.xyz * 0.5);
+    }
+    else if (type == 4)                 /* TETRAHEDRON */
+    {
+        return sdTetrahedron(p, t1.yzw, t2.xyz, vec3(t2.w, t3.x, t3.y), vec3(t3.z, t3.w, t4.x));
+    }
+    else if (type == 8)                 /* PLANE */
+    {
+        return sdPlane(p, t1.yzw, t2.x);
+    }
+    else if (type == 9)                 /* MENGER_SPONGE */
+    {
+        return sdMengerSponge(p - t1.yzw, t2.x, int(t2.y + 0.5));
+    }
+    else if (type == 10)                /* MANDELBULB */
+    {
+        return sdMandelbulb(p, t1.yzw, t2.x, t2.y, int(t2.z + 0.5));
+    }
+    return sdJuliaSet3D(p, t1.yzw, t2.x, t2.yz, int(t2.w + 0.5));   /* JULIA_SET_3D */
+}
+
+void distOnly(int idx, vec3 p, inout float stack[STACK_SIZE], inout int stack_top, inout int foldType, inout int foldLeft)
+{
+    const int STRIDE = 8;
+    int base = idx * STRIDE;
+    int type = int(texelFetch(objectBuffer, base).x + 0.5);
+    vec4 t1 = texelFetch(objectBuffer, base + 1);
+
+    if (type >= 5 && type <= 7)         /* Intersect / Union / Subtract */
+    {
+        float d1 = stack[stack_top - 2];
+        float d2 = stack[stack_top - 1];
+        stack_top -= 1;
+        stack[stack_top - 1] = type == 5 ? max(d1, d2) : (type == 6 ? min(d1, d2) : max(d1, -d2));
+    }
+    else if (type == 12 || type == 13)  /* MULTI_UNION / MULTI_INTERSECTION */
+    {
+        stack[stack_top] = type == 12 ? 1e30 : -1e30;
+        stack_top += 1;
+        foldType = type;
+        foldLeft = int(t1.y + 0.5);
+    }
+    else
+    {
+        float d = primDist(type, t1, texelFetch(objectBuffer, base + 2), texelFetch(objectBuffer, base + 3),
+                           texelFetch(objectBuffer, base + 4), p);
+        if (foldLeft > 0)
+        {
+            stack[stack_top - 1] = foldType == 12 ? min(stack[stack_top - 1], d) : max(stack[stack_top - 1], d);
+            foldLeft -= 1;
+        }
+        else
+        {
+            stack[stack_top] = d;
+            stack_top += 1;
+        }
+    }
+}
+
+float mapLinearDist(vec3 p)
+{
+    float stack[STACK_SIZE];
+    for (int k = 0; k < STACK_SIZE; ++k) stack[k] = 0.0;
+    int stack_top = 0;
+    int foldType = 0, foldLeft = 0;
+
+    for (int i = 0; i < numObjects; ++i)
+    {
+        distOnly(i, p, stack, stack_top, foldType, foldLeft);
+    }
+    return stack[0];
+}
+
+float mapLinear(vec3 p, out vec3 col, out int matID, out float matPar)
+{
+    vec4  stack   [STACK_SIZE];
+    int   idStack [STACK_SIZE];
+    float parStack[STACK_SIZE];
+    for (int k = 0; k < STACK_SIZE; ++k) { stack[k] = vec4(0.0); idStack[k] = 0; parStack[k] = 0.0; }
     int stack_top = 0;
+    int foldType = 0, foldLeft = 0;
     
     for (int i = 0; i < numObjects; ++i)
     {
-        distOne(i, p, stack, stack_top, idStack, parStack);
+        distOne(i, p, stack, stack_top, idStack, parStack, foldType, foldLeft);
     }
     col = stack[0].xyz;
     matID  = idStack[0];
@@ -519,21 +897,192 @@ float map(vec3 p, out vec3 col, out int matID, out float matPar)
     return stack[0].w;
 }
 
-vec3 calcNormal(vec3 p)
+float sdAABB(vec3 p, vec3 bmin, vec3 bmax)
 {
-    // 使用适合分形的精度参数
-    const float h = 5e-5;  // 适中的步长，平衡精度和性能
-    vec3 dummy;
-    int idDummy;
+    vec3 q = abs(p - (bmin + bmax) * 0.5) - (bmax - bmin) * 0.5;
+    return length(max(q, 0.0)) + min(max(q.x, max(q.y, q.z)), 0.0);
+}
+
+/* ------------------------------------------------------------
+ * mapBVH
+ *   根部并集的每个成员是 BVH 的一个叶子，对应 objectBuffer 中连续的一段后序指令。
+ *   包围盒距离不小于当前最近距离的子树整棵跳过；
+ *   叶子用独立的栈求值，再与当前结果求并。
+ * ----------------------------------------------------------*/
+float mapBVH(vec3 p, out vec3 col, out int matID, out float matPar)
+{
+    const int BVH_STACK = 32;
+    vec4  best    = vec4(0.0, 0.0, 0.0, 1e30);
+    int   bestID  = 0;
+    float bestPar = 0.0;
+
+    int   todo[BVH_STACK];
+    float todoDist[BVH_STACK];
+    int   todo_top = 0;
+    todo[0]     = 0;
+    todoDist[0] = sdAABB(p, texelFetch(bvhBuffer, 0).xyz, texelFetch(bvhBuffer, 1).xyz);
+    todo_top    = 1;
+
+    while (todo_top > 0)
+    {
+        todo_top -= 1;
+        if (todoDist[todo_top] >= best.w) continue;   // 包围盒比当前最近距离还远
+
+        int  node = todo[todo_top];
+        vec4 n0 = texelFetch(bvhBuffer, node * 2 + 0);   // min, 右子节点 / 指令起始
+        vec4 n1 = texelFetch(bvhBuffer, node * 2 + 1);   // max, 0 / 指令条数
+        int  count = int(n1.w + 0.5);
+
+        if (count > 0)                  /* ---------- 叶子 ---------- */
+        {
+            vec4  stack   [STACK_SIZE];
+            int   idStack [STACK_SIZE];
+            float parStack[STACK_SIZE];
+            for (int k = 0; k < STACK_SIZE; ++k) { stack[k] = vec4(0.0); idStack[k] = 0; parStack[k] = 0.0; }
+            int stack_top = 0;
+            int foldType = 0, foldLeft = 0;
+
+            int start = int(n0.w + 0.5);
+            for (int i = start; i < start + count; ++i)
+            {
+                distOne(i, p, stack, stack_top, idStack, parStack, foldType, foldLeft);
+            }
+            if (stack[0].w < best.w)
+            {
+                best    = stack[0];
+                bestID  = idStack[0];
+                bestPar = parStack[0];
+            }
+        }
+        else                            /* ---------- 内部节点：近的子节点后入栈、先访问 ---------- */
+        {
+            int left  = node + 1;
+            int right = int(n0.w + 0.5);
+            float dl = sdAABB(p, texelFetch(bvhBuffer, left * 2).xyz,  texelFetch(bvhBuffer, left * 2 + 1).xyz);
+            float dr = sdAABB(p, texelFetch(bvhBuffer, right * 2).xyz, texelFetch(bvhBuffer, right * 2 + 1).xyz);
+            bool leftFirst = dl <= dr;
+            todo[todo_top]     = leftFirst ? right : left;
+            todoDist[todo_top] = leftFirst ? dr : dl;
+            todo[todo_top + 1]     = leftFirst ? left : right;
+            todoDist[todo_top + 1] = leftFirst ? dl : dr;
+            todo_top += 2;
+        }
+    }
+    col    = best.xyz;
+    matID  = bestID;
+    matPar = bestPar;
+    return best.w;
+}
+
+// mapBVH 的只求距离版本，遍历规则相同
+float mapBVHDist(vec3 p)
+{
+    const int BVH_STACK = 32;
+    float best = 1e30;
+
+    int   todo[BVH_STACK];
+    float todoDist[BVH_STACK];
+    int   todo_top = 0;
+    todo[0]     = 0;
+    todoDist[0] = sdAABB(p, texelFetch(bvhBuffer, 0).xyz, texelFetch(bvhBuffer, 1).xyz);
+    todo_top    = 1;
+
+    while (todo_top > 0)
+    {
+        todo_top -= 1;
+        if (todoDist[todo_top] >= best) continue;
+
+        int  node = todo[todo_top];
+        vec4 n0 = texelFetch(bvhBuffer, node * 2 + 0);
+        vec4 n1 = texelFetch(bvhBuffer, node * 2 + 1);
+        int  count = int(n1.w + 0.5);
+
+        if (count > 0)
+        {
+            float stack[STACK_SIZE];
+            for (int k = 0; k < STACK_SIZE; ++k) stack[k] = 0.0;
+            int stack_top = 0;
+            int foldType = 0, foldLeft = 0;
+
+            int start = int(n0.w + 0.5);
+            for (int i = start; i < start + count; ++i)
+            {
+                distOnly(i, p, stack, stack_top, foldType, foldLeft);
+            }
+            best = min(best, stack[0]);
+        }
+        else
+        {
+            int left  = node + 1;
+            int right = int(n0.w + 0.5);
+            float dl = sdAABB(p, texelFetch(bvhBuffer, left * 2).xyz,  texelFetch(bvhBuffer, left * 2 + 1).xyz);
+            float dr = sdAABB(p, texelFetch(bvhBuffer, right * 2).xyz, texelFetch(bvhBuffer, right * 2 + 1).xyz);
+            bool leftFirst = dl <= dr;
+            todo[todo_top]     = leftFirst ? right : left;
+            todoDist[todo_top] = leftFirst ? dr : dl;
+            todo[todo_top + 1]     = leftFirst ? left : right;
+            todoDist[todo_top + 1] = leftFirst ? dl : dr;
+            todo_top += 2;
+        }
+    }
+    return best;
+}
+
+/* 场景编译 (COMPILED_SCENE) 时，main.cpp 在下面一行插入 glsl_codegen 生成的 mapCompiled()、mapDistCompiled() 与 mapGradCompiled() */
+// @SCENE_MAP@
+
+float map(vec3 p, out vec3 col, out int matID, out float matPar)
+{
+#ifdef COMPILED_SCENE
+    return mapCompiled(p, col, matID, matPar);
+#else
+    if (numBVHNodes > 0) return mapBVH(p, col, matID, matPar);
+    return mapLinear(p, col, matID, matPar);
+#endif
+}
+
+// 只求距离：步进、阴影、AO 与锥体预步进的内层循环使用，颜色与材质只在命中点由 map() 求一次
+float mapDist(vec3 p)
+{
+#ifdef COMPILED_SCENE
+    return mapDistCompiled(p);
+#else
+    if (numBVHNodes > 0) return mapBVHDist(p);
+    return mapLinearDist(p);
+#endif
+}
+
+// 返回 vec4(梯度, 距离)：与 map() 走同一遍求值，基元给出解析梯度，分形用步长 h 对自身做四面体差分。
+// 法线因此只需一次求值，而不是中心差分的 6 次完整的 map()
+vec4 mapGrad(vec3 p, float h)
+{
+#ifdef COMPILED_SCENE
+    return mapGradCompiled(p, h);
+#else
+    vec3  g;
+    int   idDummy;
     float parDummy;
-    
-    // 使用更精确的中心差分法
-    vec3 n = vec3(
-        map(p + vec3(h, 0.0, 0.0), dummy, idDummy, parDummy) - map(p - vec3(h, 0.0, 0.0), dummy, idDummy, parDummy),
-        map(p + vec3(0.0, h, 0.0), dummy, idDummy, parDummy) - map(p - vec3(0.0, h, 0.0), dummy, idDummy, parDummy),
-        map(p + vec3(0.0, 0.0, h), dummy, idDummy, parDummy) - map(p - vec3(0.0, 0.0, h), dummy, idDummy, parDummy)
-    );
-    return normalize(n);
+    gradStep = h;
+    float d = numBVHNodes > 0 ? mapBVH(p, g, idDummy, parDummy) : mapLinear(p, g, idDummy, parDummy);
+    gradStep = 0.0;
+    return vec4(g, d);
+#endif
+}
+
+// 一个像素在距离 t 处的宽度 (uv 中一个像素为 2 / iResolution.y，相机焦距为 1)。
+// 命中阈值与法线的差分步长都取它的一半：远处的表面不必追到亚像素精度，近处的分形细节也不会小于一个像素
+float pixelFootprint(float t)
+{
+    return t * 2.0 / iResolution.y;
+}
+
+// t 为命中点到光线起点的距离
+vec3 calcNormal(vec3 p, float t)
+{
+    // 下限为原来的固定步长 (适合分形的精度)
+    float h = max(5e-5, 0.5 * pixelFootprint(t));
+    vec3 n = mapGrad(p, h).xyz;
+    return n / max(length(n), 1e-20);
 }
 
 /* === Soft Shadow (directional) === */
@@ -544,10 +1093,7 @@ float softShadow(vec3 ro, vec3 rd, float mint, float maxt)
     for(int i = 0; i < 128 && t < maxt; ++i)   // 步数可 32~128
     {
         vec3  pos = ro + rd * t;
-        vec3  dump;
-        int   idDummy;
-        float parDummy;
-        float h   = map(pos, dump, idDummy, parDummy);          // 场景 SDF
+        float h   = mapDist(pos);                                // 场景 SDF
         if(h < 5e-5) return 0.0;             // 命中遮挡
         res = min(res, 8.0 * h / t);         // penumbra
         t  += clamp(h, 0.02, 0.25);          // 步长
@@ -564,10 +1110,7 @@ float calcAO(vec3 p, vec3 n)
     for(int i = 1; i <= SAMPLE; ++i)
     {
         float dist = 0.02 * float(i);     // 采样半径 (线性增长)
-        vec3  colDummy;
-        int   idDummy;
-        float parDummy;
-        float d = map(p + n * dist, colDummy, idDummy, parDummy);   // 距离场
+        float d = mapDist(p + n * dist);   // 距离场
 
         occ += (dist - d) * w;             // d 越小 → 遮挡越重
         w   *= 0.6;                        // 权重递减
@@ -575,37 +1118,88 @@ float calcAO(vec3 p, vec3 n)
     return clamp(1.0 - occ, 0.0, 1.0);     // 1→完全暴露, 0→全遮
 }
 
-float march(vec3 ro, vec3 rd, out vec3 pos, out vec3 col, out int matID, out float matPar)
+float stepScale()
 {
-    const float EPS  = 1e-5;   // 提高精度阈值，适合分形结构
+    return uStepScale > 0.0 ? uStepScale : 0.7;
+}
+
+// 过松弛球体追踪 (Keinert et al., Enhanced Sphere Tracing)：步长放大为 ω × d；
+// 相邻两点的无界球不再相交 (|d| + |d_prev| < 上一步长) 时可能已越过表面，退回上一点并改用 ω = 1 继续。
+// tStart 为已知安全的起点 (主光线来自锥体预步进，其余光线为 0)
+float march(vec3 ro, vec3 rd, float tStart, out vec3 pos, out vec3 col, out int matID, out float matPar)
+{
+    const float EPS  = 1e-5;   // 命中阈值的下限：远处按像素宽度放宽，见 pixelFootprint()
     const float TMAX = 100.0;
-    float t = 0.0;
+    float k = stepScale();
+    float omega = max(uRelax, 1.0);
+    float t = tStart;
+    float prevRadius = 0.0, stepLength = 0.0;
     
-    for (int i = 0; i < 1024; ++i)  // 增加最大迭代次数
+    for (int i = 0; i < 256; ++i)   // 命中阈值随距离放宽后，最长的光线也只需 100 步左右
     {
+        marchSteps++;
         pos = ro + rd * t;
-        float d = map(pos, col, matID, matPar);
-        
-        if (d < EPS) return t;
+        float d = mapDist(pos);
+        float radius = abs(d) * k;
         
-        // 对于分形结构，使用更保守的步长
-        t += d * 0.7;  // 进一步减小步长因子，提高精度
+        if (omega > 1.0 && radius + prevRadius < stepLength)
+        {
+            stepLength -= omega * stepLength;   // 退回上一点
+            omega = 1.0;
+        }
+        else
+        {
+            if (d < max(EPS, 0.5 * pixelFootprint(t)))
+            {
+                map(pos, col, matID, matPar);   // 颜色与材质只在命中点求一次
+                return t;
+            }
+            stepLength = d * k * omega;
+        }
+        prevRadius = radius;
+        t += stepLength;
         
         if (t > TMAX) break;
     }
+    col    = vec3(0.0);
+    matID  = 0;
+    matPar = 0.0;
     return -1.0;
 }
 
+const vec3 KEY_DIR = normalize(vec3(0.5, 0.7, -0.4));   // 关键光 (Key) 的方向
+
+// 主光软阴影：有阴影缓存且 pos 在体积内时直接插值，否则沿主光步进
+float keyShadow(vec3 pos, vec3 n)
+{
+    if(uShadowVolume == 1)
+    {
+        vec3 uvw = (pos + n * uShadowOffset - uShadowMin) / (uShadowMax - uShadowMin);
+        if(all(greaterThanEqual(uvw, vec3(0.0))) && all(lessThanEqual(uvw, vec3(1.0))))
+        {
+            return texture(uShadowTex, uvw).r;
+        }
+    }
+    return softShadow(pos + n * 1e-3, KEY_DIR, 0.05, 20.0);
+}
+
+// 主光软阴影与 AO：漫反射着色中唯二需要再求场景距离的项，都是低频量
+vec2 occlusion(vec3 pos, vec3 n)
+{
+    return vec2(keyShadow(pos, n), calcAO(pos, n));
+}
+
 /* ------------------------------------------------------------
  * diffuseShading
  *   pos      ─ 命中的世界坐标
  *   n        ─ 法向量（已归一化）
  *   viewDir  ─ 从表面指向相机的向量 (已归一化)
  *   albedo   ─ 物体基色 (可以是贴图 × 颜色，也可以纯 solid color)
+ *   occl     ─ 已知的 (主光阴影, AO)；x < 0 时在这里计算
  *
  * 返回值     ─ 线性色空间 (RGB 0–1)
  * ----------------------------------------------------------*/
-vec3 diffuseShading(vec3 pos, vec3 n, vec3 viewDir, vec3 albedo)
+vec3 diffuseShading(vec3 pos, vec3 n, vec3 viewDir, vec3 albedo, vec2 occl)
 {
     /* === 半球环境光 (Hemisphere Ambient) === */
     vec3 skyCol    = vec3(0.24, 0.32, 0.45);   // 天空色
@@ -613,12 +1207,13 @@ vec3 diffuseShading(vec3 pos, vec3 n, vec3 viewDir, vec3 albedo)
     vec3 hemi      = mix(groundCol, skyCol, n.y * 0.5 + 0.5);
 
     /* === 两盏方向光 === */
-    vec3 kDir  = normalize(vec3( 0.5, 0.7, -0.4));  // 关键光 (Key)
+    vec3 kDir  = KEY_DIR;                           // 关键光 (Key)
     vec3 fDir  = normalize(vec3(-0.4, 0.3,  0.5));  // 反向填充 (Fill/Rim)
     vec3 lightCol = vec3(1.08, 0.97, 0.90);
 
-    /* 主光软阴影 */
-    float kShadow = softShadow(pos + n * 1e-3, kDir, 0.05, 20.0);
+    /* 主光软阴影与 AO */
+    if(occl.x < 0.0) occl = occlusion(pos, n);
+    float kShadow = occl.x;
 
     /* === 漫反射 (Lambert) === */
     float kDiff = max(dot(n, kDir), 0.0) * kShadow;
@@ -631,7 +1226,7 @@ vec3 diffuseShading(vec3 pos, vec3 n, vec3 viewDir, vec3 albedo)
     float fSpec = pow(max(dot(n, halfF), 0.0), 64.0);
 
     /* === 环境光遮蔽 (Ambient Occlusion) === */
-    float ao = calcAO(pos, n);
+    float ao = occl.y;
 
     /* === 颜色合成 === */
     vec3 color =
@@ -642,138 +1237,347 @@ vec3 diffuseShading(vec3 pos, vec3 n, vec3 viewDir, vec3 albedo)
     return color;   // 线性色彩，留给 Tone Mapping 处理
 }
 
-void main()
+// 相机：屏幕坐标 (0..1) → 光线
+void cameraRay(vec2 sampleCoord, out vec3 ro, out vec3 rd)
+{
+    vec2 uv = (sampleCoord * 2.0 - 1.0);
+    uv.x *= iResolution.x / iResolution.y;
+
+    ro = vec3(0.0, 4.0, -6.0);          // 相机位置：更远的距离以观察分布更开的三个分形
+    rd = normalize(vec3(uv, 1.0));      // ray dir
+    float pitch = radians(-15.0);        // 俯视角度减小到15°
+    rd.yz = mat2(cos(pitch), -sin(pitch), sin(pitch),  cos(pitch)) * rd.yz;
+}
+
+// 锥体步进：沿块中心的光线前进，锥体半径 coneK * t 覆盖块内所有像素 (含子像素偏移) 的光线。
+// 单位方向的夹角不超过 coneK，同一 t 处块内光线离轴不超过 coneK * t，
+// 所以 stepScale() * d (与 march() 相同的保守系数) 减去锥体半径仍是块内每条光线的安全步长，直到锥体碰到表面
+float coneMarch(vec3 ro, vec3 rd, float coneK)
+{
+    const float TMAX = 100.0;
+    float t = 0.0;
+    for(int i = 0; i < 256; ++i)
+    {
+        float s = stepScale() * mapDist(ro + rd * t) - coneK * t;
+        if(s < 1e-4) break;
+        t += s;
+        if(t > TMAX) break;
+    }
+    return min(t, TMAX);
+}
+
+// 低分辨率光照的深度 / 法线容差：相对距离差超过 LIGHT_DEPTH_TOL 的样本权重为 0，法线权重为 dot^LIGHT_NORMAL_POW
+const float LIGHT_DEPTH_TOL  = 0.05;
+const float LIGHT_NORMAL_POW = 8.0;
+
+// 低分辨率的像素 q 在 G-buffer 中的代表像素 (块的左上角)，光照一遍在它的采样点上计算
+ivec2 lightingTexel(ivec2 q)
+{
+    return q * uLightScale;
+}
+
+// 双边上采样：像素 px (第一次命中 geom) 取周围 2x2 个低分辨率样本，双线性权重乘以深度与法线的相似度，
+// 跨越物体边界或折痕的样本被排除；没有可用样本时返回 -1，由调用方按全分辨率计算
+vec2 upsampleLighting(ivec2 px, vec4 geom)
+{
+    ivec2 lowMax = (ivec2(iResolution) - 1) / uLightScale;
+    ivec2 q0 = px / uLightScale;
+    vec2  f  = vec2(px - q0 * uLightScale) / float(uLightScale);
+
+    vec3  sum  = vec3(0.0);
+    for(int i = 0; i < 4; ++i)
+    {
+        ivec2 o = ivec2(i & 1, i >> 1);
+        ivec2 q = min(q0 + o, lowMax);
+        vec4  g = texelFetch(uGGeom, lightingTexel(q), 0);
+        vec2  b = mix(1.0 - f, f, vec2(o));
+        float w = b.x * b.y
+                * max(1.0 - abs(g.w - geom.w) / (LIGHT_DEPTH_TOL * geom.w), 0.0)
+                * pow(max(dot(g.xyz, geom.xyz), 0.0), LIGHT_NORMAL_POW);
+        // 未命中与非漫反射 (镜面 / 折射) 的低分辨率像素没有计算光照，只写了 vec2(1.0)，不参与平均
+        if(g.w < 0.0 || texelFetch(uGAlbedo, lightingTexel(q), 0).a >= 0.5) w = 0.0;
+        sum += vec3(texelFetch(uGLighting, q, 0).rg, 1.0) * w;
+    }
+    return sum.z > 1e-3 ? sum.xy / sum.z : vec2(-1.0);
+}
+
+/* ------------------------------------------------------------
+ * shadePath
+ *   沿路径追踪并着色，返回色调映射与伽马校正后的颜色。(ro, rd) 为主光线，从 tStart 开始步进；
+ *   geom 返回第一次命中的法线与距离 (未命中时 w = -1)，baseCol / hitMat / hitPar 为其材质。
+ *   deferred 与 uDeferred 含义相同：
+ *     0 = 前向渲染
+ *     1 = 求出第一次命中后立即返回 (写 G-buffer)
+ *     2 = 第一次命中由调用方从 G-buffer 读出 (geom 与材质为输入)，主光线不再步进
+ *   三种情况共用同一处 march() / calcNormal()：llvmpipe 在掩码下执行未走的分支，
+ *   多一个调用点就多一份完整的场景求值
+ * ----------------------------------------------------------*/
+vec3 shadePath(vec3 ro, vec3 rd, float tStart, int deferred, inout vec4 geom,
+               inout vec3 baseCol, inout int hitMat, inout float hitPar)
 {
-    // 抗锯齿开关：设为1启用2x2超采样，设为0禁用以提高性能
-    const bool ENABLE_AA = true;
     const int MAX_BOUNCES = 4; // 最大反射次数
+
+    vec3 accumColor = vec3(0.0);  // 累积颜色
+    vec3 throughput = vec3(1.0);  // 光线能量衰减系数
     
-    vec3 finalColor = vec3(0.0);
-    int samples = ENABLE_AA ? 4 : 1;
-    
-    for(int sampleIdx = 0; sampleIdx < samples; sampleIdx++)
+    // 光线追踪主循环
+    for(int bounce = 0; bounce < MAX_BOUNCES; bounce++)
     {
-        vec2 sampleCoord = fragCoord;
+        bool known = bounce == 0 && deferred == 2;
+
+        /* 光线步进 */
+        vec3 hitPos;
+        float t = geom.w;
+        if(!known) t = march(ro, rd, bounce == 0 ? tStart : 0.0, hitPos, baseCol, hitMat, hitPar);
         
-        if(ENABLE_AA)
+        /* 未命中 - 使用环境贴图 */
+        if(t < 0.0)
         {
-            int x = sampleIdx % 2;
-            int y = sampleIdx / 2;
-            vec2 offset = vec2(float(x), float(y)) * 0.5 - 0.25;
-            sampleCoord = fragCoord + offset / iResolution.xy;
+            vec3 env = (uEnvEnable == 1) ? textureLod(uEnvMap, rd, 0.0).rgb : vec3(0.0);
+            accumColor += throughput * env;
+            break;
         }
         
-        /* 1) 初始化光线 */
-        vec2 uv = (sampleCoord * 2.0 - 1.0);
-        uv.x *= iResolution.x / iResolution.y;
-
-        vec3 ro = vec3(0.0, 4.0, -6.0);    // 相机位置：更远的距离以观察分布更开的三个分形
-        vec3 rd = normalize(vec3(uv, 1.0)); // ray dir
-        float pitch = radians(-15.0);        // 俯视角度减小到15°
-        rd.yz = mat2(cos(pitch), -sin(pitch), sin(pitch),  cos(pitch)) * rd.yz;
-
-        /* 2) 光线追踪循环 */
-        vec3 accumColor = vec3(0.0);  // 累积颜色
-        vec3 throughput = vec3(1.0);  // 光线能量衰减系数
-        int bounceCount = 0;           // 当前反射次数
+        /* 命中表面 - 计算法线 */
+        vec3 n;
+        if(known)
+        {
+            hitPos = ro + rd * t;
+            n = geom.xyz;
+        }
+        else
+        {
+            n = calcNormal(hitPos, t);
+        }
+        vec3 viewDir = normalize(-rd);  // 从表面看向相机
+        if(bounce == 0)
+        {
+            geom = vec4(n, t);
+            if(deferred == 1) return vec3(0.0);
+        }
         
-        // 光线追踪主循环
-        for(int bounce = 0; bounce < MAX_BOUNCES; bounce++)
+        /* 3) 材质处理 */
+        if(hitMat == 0) // 漫反射材质
         {
-            bounceCount++;
-            
-            /* 光线步进 */
-            vec3 hitPos, baseCol;
-            int   hitMat;
-            float hitPar;
-            
-            float t = march(ro, rd, hitPos, baseCol, hitMat, hitPar);
-            
-            /* 未命中 - 使用环境贴图 */
-            if(t < 0.0)
-            {
-                vec3 env = (uEnvEnable == 1) ? textureLod(uEnvMap, rd, 0.0).rgb : vec3(0.0);
-                accumColor += throughput * env;
-                break;
-            }
+            vec2 occl = (known && uLightScale > 0) ? upsampleLighting(ivec2(gl_FragCoord.xy), geom) : vec2(-1.0);
+            vec3 color = diffuseShading(hitPos, n, viewDir, baseCol, occl);
+            accumColor += throughput * color;
+            break; // 漫反射不继续反射
+        }
+        else if(hitMat == 1) // 镜面反射
+        {
+            // 计算反射方向
+            rd = reflect(rd, n);
             
-            /* 命中表面 - 计算法线 */
-            vec3 n = calcNormal(hitPos);
-            vec3 viewDir = normalize(-rd);  // 从表面看向相机
+            // 更新光线起点（防止自交）
+            ro = hitPos + n * 1e-3;
             
-            /* 3) 材质处理 */
-            if(hitMat == 0) // 漫反射材质
-            {
-                vec3 color = diffuseShading(hitPos, n, viewDir, baseCol);
-                accumColor += throughput * color;
-                break; // 漫反射不继续反射
-            }
-            else if(hitMat == 1) // 镜面反射
-            {
-                // 计算反射方向
-                rd = reflect(rd, n);
-                
-                // 更新光线起点（防止自交）
-                ro = hitPos + n * 1e-3;
-                
-                // 更新能量衰减（反射损失）
-                throughput *= baseCol * 0.8;
-            }
-            else if(hitMat == 2) // 折射材质
-            {
-                vec3 n = calcNormal(hitPos);
-                bool  into = dot(rd, n) < 0.0;
-                float n1 = 1.0, n2 = hitPar;
-                float eta = into ? n1/n2 : n2/n1;
-
-                float cosI = clamp(dot(-rd, n), 0.0, 1.0);
-                float F0   = pow((n1 - n2)/(n1 + n2), 2.0);
-                float Fr   = F0 + (1.0 - F0)*pow(1.0 - cosI, 5.0);
-
-                vec3 reflDir = reflect(rd, n);
-                vec3 refrDir = refract(rd, into ? n : -n, eta);
-
-                /* 反射颜色 */
-                vec3 cRefl; int idD; float pD;
-                float tRefl = march(hitPos + n*1e-3, reflDir,
-                                    hitPos, cRefl, idD, pD);
-                vec3 reflCol = (tRefl < 0.0)
-                            ? textureLod(uEnvMap, reflDir, 0.0).rgb
-                            : cRefl;
-
-                /* 折射颜色（这里只直接天空盒，也可再 march 一次） */
-                vec3 refrCol = textureLod(uEnvMap, refrDir, 0.0).rgb;
-
-                /* Fresnel 线性混合并累加 */
-                accumColor += throughput * mix(refrCol, reflCol, Fr);
-
-                /* 终止这条路径 */
-                break;
-            }
-            
-            /* 4) 能量衰减检查 - 提前终止 */
-            float maxComponent = max(max(throughput.r, throughput.g), throughput.b);
-            if(maxComponent < 0.01) break;
+            // 更新能量衰减（反射损失）
+            throughput *= baseCol * 0.8;
+        }
+        else if(hitMat == 2) // 折射材质
+        {
+            bool  into = dot(rd, n) < 0.0;
+            float n1 = 1.0, n2 = hitPar;
+            float eta = into ? n1/n2 : n2/n1;
+
+            float cosI = clamp(dot(-rd, n), 0.0, 1.0);
+            float F0   = pow((n1 - n2)/(n1 + n2), 2.0);
+            float Fr   = F0 + (1.0 - F0)*pow(1.0 - cosI, 5.0);
+
+            vec3 reflDir = reflect(rd, n);
+            vec3 refrDir = refract(rd, into ? n : -n, eta);
+
+            /* 反射颜色 */
+            vec3 cRefl; int idD; float pD;
+            float tRefl = march(hitPos + n*1e-3, reflDir, 0.0,
+                                hitPos, cRefl, idD, pD);
+            vec3 reflCol = (tRefl < 0.0)
+                        ? textureLod(uEnvMap, reflDir, 0.0).rgb
+                        : cRefl;
+
+            /* 折射颜色（这里只直接天空盒，也可再 march 一次） */
+            vec3 refrCol = textureLod(uEnvMap, refrDir, 0.0).rgb;
+
+            /* Fresnel 线性混合并累加 */
+            accumColor += throughput * mix(refrCol, reflCol, Fr);
+
+            /* 终止这条路径 */
+            break;
         }
         
-        /* 5) 色调映射和伽马校正 */
-        float exposure = 0.9;
-        vec3 mappedColor = accumColor * exposure;
-        
-        // ACES 色调映射
-        mappedColor = (mappedColor * (2.51 * mappedColor + 0.03)) / 
-                     (mappedColor * (2.43 * mappedColor + 0.59) + 0.14);
-        
-        // 提升饱和度
-        float sat = 1.5;
-        float Y = dot(mappedColor, vec3(0.2126, 0.7152, 0.0722));
-        mappedColor = mix(vec3(Y), mappedColor, sat);
-        
-        // 伽马校正
-        mappedColor = pow(mappedColor, vec3(1.0/2.2));
-        
-        finalColor += mappedColor;
+        /* 4) 能量衰减检查 - 提前终止 */
+        float maxComponent = max(max(throughput.r, throughput.g), throughput.b);
+        if(maxComponent < 0.01) break;
     }
     
-    FragColor = vec4(finalColor / float(samples), 1.0);
-}
\ No newline at end of file
+    /* 5) 色调映射和伽马校正 */
+    float exposure = 0.9;
+    vec3 mappedColor = accumColor * exposure;
+    
+    // ACES 色调映射
+    mappedColor = (mappedColor * (2.51 * mappedColor + 0.03)) / 
+                 (mappedColor * (2.43 * mappedColor + 0.59) + 0.14);
+    
+    // 提升饱和度
+    float sat = 1.5;
+    float Y = dot(mappedColor, vec3(0.2126, 0.7152, 0.0722));
+    mappedColor = mix(vec3(Y), mappedColor, sat);
+    
+    // 伽马校正
+    mappedColor = pow(mappedColor, vec3(1.0/2.2));
+    return mappedColor;
+}
+
+// 像素中心为 center (0..1 的屏幕坐标) 时第 sampleIdx 个采样的屏幕坐标：
+// 渐进累积时按 uAccumFrame 抖动，samples == 4 时为 2x2 网格，否则为像素中心
+vec2 sampleCoordAt(vec2 center, int sampleIdx, int samples)
+{
+    if(uAccumFrame > 0)
+    {
+        // R2 低差异序列：第 1 个采样落在像素中心，之后均匀填满像素
+        vec2 offset = fract(0.5 + float(uAccumFrame - 1) * vec2(0.7548776662, 0.5698402910)) - 0.5;
+        return center + offset / iResolution.xy;
+    }
+    if(samples == 4)
+    {
+        int x = sampleIdx % 2;
+        int y = sampleIdx / 2;
+        vec2 offset = vec2(float(x), float(y)) * 0.5 - 0.25;
+        return center + offset / iResolution.xy;
+    }
+    return center;
+}
+
+// 边缘检测的阈值：深度二阶差分 (相对距离)、相邻法线夹角的余弦、亮度差
+const float AA_DEPTH_THRESHOLD  = 0.1;
+const float AA_NORMAL_THRESHOLD = 0.8;
+const float AA_LUMA_THRESHOLD   = 0.1;
+
+float luma(vec3 c)
+{
+    return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// 根据第一遍的结果判断像素是否在边缘上：分别与水平、竖直方向的两个邻居比较，
+// 物体 / 天空交界、深度不连续 (二阶差分，平面即使掠射也接近 0)、法线突变或亮度突变都算边缘
+bool isEdgePixel(ivec2 px)
+{
+    ivec2 maxPx = ivec2(iResolution) - 1;
+    vec4  g = texelFetch(uAAGeom, px, 0);
+    float l = luma(texelFetch(uAAColor, px, 0).rgb);
+    for(int axis = 0; axis < 2; axis++)
+    {
+        ivec2 d  = axis == 0 ? ivec2(1, 0) : ivec2(0, 1);
+        ivec2 pa = clamp(px - d, ivec2(0), maxPx);
+        ivec2 pb = clamp(px + d, ivec2(0), maxPx);
+        vec4 ga = texelFetch(uAAGeom, pa, 0);
+        vec4 gb = texelFetch(uAAGeom, pb, 0);
+        if((ga.w < 0.0) != (g.w < 0.0) || (gb.w < 0.0) != (g.w < 0.0)) return true;
+        if(g.w >= 0.0)
+        {
+            if(abs(ga.w + gb.w - 2.0 * g.w) > AA_DEPTH_THRESHOLD * g.w) return true;
+            if(min(dot(g.xyz, ga.xyz), dot(g.xyz, gb.xyz)) < AA_NORMAL_THRESHOLD) return true;
+        }
+        float la = luma(texelFetch(uAAColor, pa, 0).rgb);
+        float lb = luma(texelFetch(uAAColor, pb, 0).rgb);
+        if(max(abs(la - l), abs(lb - l)) > AA_LUMA_THRESHOLD) return true;
+    }
+    return false;
+}
+
+void main()
+{
+    // 抗锯齿开关：设为1启用2x2超采样，设为0禁用以提高性能
+    const bool ENABLE_AA = true;
+
+    // 边缘自适应抗锯齿：第一遍每个像素在中心追踪 1 个采样，写出颜色与第一次命中的几何信息；
+    // 第二遍只对边缘像素做 2x2 网格超采样 (与逐像素超采样的结果相同)，其余像素直接沿用第一遍的颜色
+    // 锥体预步进：片段坐标为块的序号，块中心的光线带着覆盖整块的锥体步进
+    if(uConePass == 1)
+    {
+        float tile = float(uConeTile);
+        vec3 ro, rd;
+        cameraRay((floor(gl_FragCoord.xy) + 0.5) * tile / iResolution.xy, ro, rd);
+        // 半对角线加 1 个像素的余量 (抗锯齿与抖动的子像素偏移)，uv 中一个像素为 2 / iResolution.y
+        float coneK = (tile * 0.7072 + 1.0) * 2.0 / iResolution.y;
+        FragColor = vec4(coneMarch(ro, rd, coneK), 0.0, 0.0, 1.0);
+        return;
+    }
+    // 主光阴影缓存：片段坐标与 uShadowSlice 为体素的序号，在体素中心沿主光步进一次
+    if(uShadowPass == 1)
+    {
+        vec3 voxel = vec3(gl_FragCoord.xy, float(uShadowSlice) + 0.5) / vec3(uShadowRes);
+        FragColor = vec4(softShadow(mix(uShadowMin, uShadowMax, voxel), KEY_DIR, 0.05, 20.0), 0.0, 0.0, 1.0);
+        return;
+    }
+
+    // 低分辨率光照：在每个低分辨率像素的代表像素处 (采样点与 G-buffer 相同) 计算漫反射表面的主光阴影与 AO
+    if(uDeferred == 3)
+    {
+        ivec2 px = lightingTexel(ivec2(gl_FragCoord.xy));
+        vec4  g  = texelFetch(uGGeom, px, 0);
+        vec2  occl = vec2(1.0);
+        if(g.w >= 0.0 && texelFetch(uGAlbedo, px, 0).a < 0.5)
+        {
+            vec3 ro, rd;
+            cameraRay(sampleCoordAt((vec2(px) + 0.5) / iResolution.xy, 0, 1), ro, rd);
+            occl = occlusion(ro + rd * g.w, g.xyz);
+        }
+        FragColor = vec4(occl, 0.0, 1.0);
+        return;
+    }
+    float tStart = uConeTile > 0 ? texelFetch(uConeDepth, ivec2(gl_FragCoord.xy) / uConeTile, 0).r : 0.0;
+
+    bool progressive = uAccumFrame > 0;
+    bool primaryPass = !progressive && uAAPass == 1;
+
+    // 延迟着色：第一遍 (uDeferred == 1) 只步进主光线，把第一次命中写进 G-buffer；第二遍在每个像素只有一个采样时
+    // (渐进累积的一帧、边缘自适应的第一遍) 从 G-buffer 着色，不再步进主光线，边缘像素的 2x2 超采样仍逐个采样追踪
+    int deferred = (uDeferred == 1 || (uDeferred == 2 && (progressive || primaryPass))) ? uDeferred : 0;
+    if(deferred == 0 && !progressive && uAAPass == 2)
+    {
+        ivec2 px = ivec2(gl_FragCoord.xy);
+        if(!ENABLE_AA || !isEdgePixel(px))
+        {
+            FragColor = vec4(texelFetch(uAAColor, px, 0).rgb, 1.0);
+            return;
+        }
+    }
+
+    vec3 finalColor = vec3(0.0);
+    vec4 geom;
+    vec3 baseCol;
+    int hitMat;
+    float hitPar;
+    int samples = (ENABLE_AA && !progressive && !primaryPass && deferred == 0) ? 4 : 1;
+
+    for(int sampleIdx = 0; sampleIdx < samples; sampleIdx++)
+    {
+        vec3 ro, rd;
+        cameraRay(sampleCoordAt(fragCoord, sampleIdx, samples), ro, rd);
+        geom = vec4(0.0, 0.0, 0.0, -1.0);
+        if(deferred == 2)
+        {
+            ivec2 px    = ivec2(gl_FragCoord.xy);
+            vec4 albedo = texelFetch(uGAlbedo, px, 0);
+            geom    = texelFetch(uGGeom, px, 0);
+            baseCol = albedo.rgb;
+            hitMat  = int(albedo.a + 0.5);
+            hitPar  = texelFetch(uGMaterial, px, 0).r;
+        }
+        finalColor += shadePath(ro, rd, tStart, deferred, geom, baseCol, hitMat, hitPar);
+    }
+
+    if(deferred == 1)
+    {
+        FragColor   = vec4(baseCol, float(hitMat));
+        MaterialOut = hitPar;
+    }
+    else
+    {
+        FragColor = vec4(finalColor / float(samples), 1.0);
+    }
+    GeomOut = geom;
+    if(uCountSteps == 1) atomicAdd(totalSteps, uint(marchSteps));                 // 只有第一遍的 FBO 接了第二个颜色附件
+}
@@ -0,0 +1,44 @@
+#include "cone_prepass.h"
+#include <iostream>
+
+void ConePrepass::resize(int width, int height) {
+    int tx = tiles(width), ty = tiles(height);
+    if (tx == tilesX && ty == tilesY) return;
+    destroy();
+    tilesX = tx;
+    tilesY = ty;
+    glGenTextures(1, &depth);
+    glBindTexture(GL_TEXTURE_2D, depth);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, tx, ty);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, depth, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "锥体预步进帧缓冲不完整: " << tx << "x" << ty << '\n';
+    }
+}
+
+void ConePrepass::begin(GLuint prog, int width, int height) const {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, tiles(width), tiles(height));
+    glUniform1i(glGetUniformLocation(prog, "uConeTile"), TILE);
+    glUniform1i(glGetUniformLocation(prog, "uConePass"), 1);
+}
+
+void ConePrepass::end(GLuint prog, GLuint target, int width, int height) const {
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
+    glViewport(0, 0, width, height);
+    glActiveTexture(GL_TEXTURE0 + DEPTH_UNIT);
+    glBindTexture(GL_TEXTURE_2D, depth);
+    glUniform1i(glGetUniformLocation(prog, "uConePass"), 0);
+}
+
+void ConePrepass::destroy() {
+    if (fbo == 0) return;
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &depth);
+    fbo = depth = 0;
+    tilesX = tilesY = 0;
+}
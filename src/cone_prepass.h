@@ -0,0 +1,34 @@
+#ifndef ISR_CONE_PREPASS_H
+#define ISR_CONE_PREPASS_H
+
+#include <glad/glad.h>
+
+// 锥体预步进 (raymarch.frag 的 uConePass)：每 TILE × TILE 个像素一条带锥体的光线，
+// 把整块光线都安全的起点距离写进 R32F 纹理，主光线从这个距离开始步进，省去相机附近空旷区域的步数。
+// 纹理按窗口尺寸对应的块数分配，视口可以更小 (动态分辨率只改变视口)
+class ConePrepass {
+public:
+    static const int TILE = 8;
+    static const int DEPTH_UNIT = 5;            // 主渲染读取起点距离的纹理单元 (raymarch.frag 中 uConeDepth 的 binding)
+
+    // 按 width × height 个像素分配纹理；块数不变时什么都不做
+    void resize(int width, int height);
+
+    // 绑定内部 FBO、把视口设为 width × height 个像素对应的块数并设置 uConePass = 1、uConeTile = TILE，
+    // 随后由调用方画全屏 quad
+    void begin(GLuint prog, int width, int height) const;
+
+    // 绑定 target 并恢复 width × height 的视口，把结果纹理绑到 DEPTH_UNIT 并设置 uConePass = 0，
+    // 之后的绘制从块的起点距离开始步进
+    void end(GLuint prog, GLuint target, int width, int height) const;
+
+    void destroy();
+
+    static int tiles(int pixels) { return (pixels + TILE - 1) / TILE; }
+
+private:
+    GLuint fbo = 0, depth = 0;
+    int tilesX = 0, tilesY = 0;
+};
+
+#endif //ISR_CONE_PREPASS_H
@@ -0,0 +1,26 @@
+#include "dynamic_resolution.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    const double HEADROOM = 0.9;        // 目标为预算的 90%，给 CPU 与耗时波动留余量
+    const float DEADBAND = 0.02f;       // 比例变化小于此值时不动
+    const float DOWN_RATE = 0.5f;       // 超预算时每次走完差距的一半
+    const float UP_RATE = 0.1f;         // 有余量时缓慢回升
+}
+
+DynamicResolution::DynamicResolution(double budget_ms, float min_scale, float max_scale)
+        : budget_ms(budget_ms), min_scale(min_scale), max_scale(max_scale), current(max_scale) {
+}
+
+void DynamicResolution::update(double gpu_ms, float frame_scale) {
+    if (gpu_ms <= 0.0 || frame_scale <= 0.0f) return;
+    double cost = gpu_ms / (double(frame_scale) * frame_scale);         // scale = 1 时的估计耗时
+    float target = static_cast<float>(std::sqrt(budget_ms * HEADROOM / cost));
+    target = std::min(max_scale, std::max(min_scale, target));
+    float delta = target - current;
+    if (std::fabs(delta) < DEADBAND && target != min_scale && target != max_scale) return;
+    current += delta * (delta < 0.0f ? DOWN_RATE : UP_RATE);
+    if (std::fabs(target - current) < DEADBAND * 0.5f) current = target;
+    current = std::min(max_scale, std::max(min_scale, current));
+}
@@ -0,0 +1,24 @@
+#ifndef ISR_DYNAMIC_RESOLUTION_H
+#define ISR_DYNAMIC_RESOLUTION_H
+
+// 动态分辨率：按测得的 GPU 耗时调整光线步进的内部渲染比例 (宽高同比缩放，像素数 ∝ scale²)。
+// 假设耗时与像素数成正比，由一帧的 (耗时, 比例) 估计每单位面积的代价，再求出恰好落在预算内的比例；
+// 降得快、升得慢，并留一小段死区，避免在两个比例之间来回跳
+class DynamicResolution {
+public:
+    explicit DynamicResolution(double budget_ms = 1000.0 / 60.0, float min_scale = 0.5f, float max_scale = 1.0f);
+
+    // gpu_ms 为某一帧的 GPU 耗时，frame_scale 为那一帧实际使用的比例 (GPU 计时有一两帧延迟，不一定等于 scale())
+    void update(double gpu_ms, float frame_scale);
+
+    float scale() const { return current; }
+
+    double budget() const { return budget_ms; }
+
+private:
+    double budget_ms;
+    float min_scale, max_scale;
+    float current;
+};
+
+#endif //ISR_DYNAMIC_RESOLUTION_H
@@ -0,0 +1,57 @@
+#include "edge_aa.h"
+#include <iostream>
+
+namespace {
+
+    GLuint create_texture(GLenum format, int width, int height) {
+        GLuint tex;
+        glGenTextures(1, &tex);
+        glBindTexture(GL_TEXTURE_2D, tex);
+        glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        return tex;
+    }
+
+}
+
+void EdgeAA::resize(int w, int h) {
+    if (w == width && h == height) return;
+    destroy();
+    width = w;
+    height = h;
+    color = create_texture(GL_RGBA8, w, h);
+    geom = create_texture(GL_RGBA16F, w, h);           // 法线 + 距离，只用于比较，半精度足够
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, geom, 0);
+    const GLenum buffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(2, buffers);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "边缘抗锯齿帧缓冲不完整: " << w << "x" << h << '\n';
+    }
+}
+
+void EdgeAA::begin_primary(GLuint prog) const {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glUniform1i(glGetUniformLocation(prog, "uAAPass"), 1);
+}
+
+void EdgeAA::begin_resolve(GLuint prog, GLuint target) const {
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
+    glActiveTexture(GL_TEXTURE0 + COLOR_UNIT);
+    glBindTexture(GL_TEXTURE_2D, color);
+    glActiveTexture(GL_TEXTURE0 + GEOM_UNIT);
+    glBindTexture(GL_TEXTURE_2D, geom);
+    glUniform1i(glGetUniformLocation(prog, "uAAPass"), 2);
+}
+
+void EdgeAA::destroy() {
+    if (fbo == 0) return;
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &color);
+    glDeleteTextures(1, &geom);
+    fbo = color = geom = 0;
+    width = height = 0;
+}
@@ -0,0 +1,30 @@
+#ifndef ISR_EDGE_AA_H
+#define ISR_EDGE_AA_H
+
+#include <glad/glad.h>
+
+// 边缘自适应抗锯齿 (raymarch.frag 的 uAAPass)：第一遍每个像素只追踪 1 个采样，把颜色与第一次命中的
+// 法线 / 距离写进两张纹理；第二遍读这两张纹理找出边缘像素，只对它们做 2x2 网格超采样，结果写到目标帧缓冲。
+// 纹理按窗口尺寸分配，视口可以更小 (动态分辨率只改变视口)
+class EdgeAA {
+public:
+    static const int COLOR_UNIT = 3;            // 第二遍读取第一遍结果的纹理单元 (raymarch.frag 中 uAAColor / uAAGeom 的 binding)
+    static const int GEOM_UNIT = 4;
+
+    // 按 width × height 分配纹理；尺寸不变时什么都不做
+    void resize(int width, int height);
+
+    // 第一遍：绑定内部 FBO (两个颜色附件) 并设置 uAAPass = 1，随后由调用方画全屏 quad
+    void begin_primary(GLuint prog) const;
+
+    // 第二遍：绑定 target，把第一遍的纹理绑到 COLOR_UNIT / GEOM_UNIT 并设置 uAAPass = 2，随后由调用方画全屏 quad
+    void begin_resolve(GLuint prog, GLuint target) const;
+
+    void destroy();
+
+private:
+    GLuint fbo = 0, color = 0, geom = 0;
+    int width = 0, height = 0;
+};
+
+#endif //ISR_EDGE_AA_H
@@ -0,0 +1,244 @@
+#include "frame_stats.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+void FrameStats::init() {
+    glGenQueries(QUERY_COUNT, queries);
+    free_queries.assign(queries, queries + QUERY_COUNT);
+    frame_start = Clock::now();
+}
+
+bool FrameStats::open_csv(const std::string &path) {
+    csv.open(path);
+    if (!csv) {
+        std::cerr << "无法写入统计文件: " << path << '\n';
+        return false;
+    }
+    csv << "frame,cpu_ms,upload_ms,swap_ms,gpu_ms,scale\n";
+    return true;
+}
+
+double FrameStats::ms_since(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void FrameStats::begin_upload() {
+    upload_start = Clock::now();
+}
+
+void FrameStats::end_upload() {
+    frame_sample.upload_ms = ms_since(upload_start);
+}
+
+void FrameStats::begin_gpu() {
+    current = 0;
+    if (free_queries.empty()) {
+        return;                                 // 两个查询都还在途：不计时，也不等待
+    }
+    current = free_queries.back();
+    free_queries.pop_back();
+    glBeginQuery(GL_TIME_ELAPSED, current);
+}
+
+void FrameStats::end_gpu() {
+    if (current != 0) {
+        glEndQuery(GL_TIME_ELAPSED);
+    }
+}
+
+void FrameStats::begin_swap() {
+    swap_start = Clock::now();
+}
+
+void FrameStats::end_swap() {
+    frame_sample.swap_ms = ms_since(swap_start);
+}
+
+void FrameStats::set_scale(double scale) {
+    frame_sample.scale = scale;
+}
+
+void FrameStats::end_frame() {
+    Clock::time_point now = Clock::now();
+    frame_sample.frame = frame_index++;
+    frame_sample.cpu_ms = std::chrono::duration<double, std::milli>(now - frame_start).count();
+    frame_start = now;
+
+    Pending p;
+    p.query = current;
+    p.sample = frame_sample;
+    in_flight.push_back(p);
+    current = 0;
+    frame_sample = Sample();
+
+    collect(false);
+}
+
+void FrameStats::collect(bool wait) {
+    while (!in_flight.empty()) {
+        Pending &p = in_flight.front();
+        if (p.query != 0) {
+            GLint available = 0;
+            glGetQueryObjectiv(p.query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available && !wait) {
+                return;
+            }
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(p.query, GL_QUERY_RESULT, &ns);
+            p.sample.gpu_ms = ns * 1e-6;
+            free_queries.push_back(p.query);
+        }
+        // 第 0 帧包含着色器的延迟编译等一次性开销 (部分驱动的第一个查询结果也不可靠)，不计入
+        if (p.sample.frame > 0) {
+            resolved.push_back(p.sample);
+            if (csv.is_open()) {
+                write_row(std::to_string(p.sample.frame), p.sample);
+            }
+        }
+        in_flight.pop_front();
+    }
+}
+
+void FrameStats::write_row(const std::string &label, const Sample &s) {
+    char buf[128];
+    std::snprintf(buf, sizeof(buf), ",%.4f,%.4f,%.4f,", s.cpu_ms, s.upload_ms, s.swap_ms);
+    csv << label << buf;
+    if (s.gpu_ms >= 0.0) {
+        std::snprintf(buf, sizeof(buf), "%.4f", s.gpu_ms);
+        csv << buf;
+    }
+    std::snprintf(buf, sizeof(buf), ",%.3f", s.scale);
+    csv << buf << '\n';
+}
+
+namespace {
+
+    // 最近秩法：q 分位数为排序后第 ceil(q * n) 个值
+    double percentile_of(std::vector<double> &values, double q) {
+        std::sort(values.begin(), values.end());
+        size_t rank = static_cast<size_t>(std::max(1.0, std::ceil(q * values.size())));
+        return values[std::min(rank, values.size()) - 1];
+    }
+
+    double mean_of(std::vector<double> &values) {
+        double sum = 0.0;
+        for (double v: values) sum += v;
+        return sum / values.size();
+    }
+
+    // 逐列归约；没有 GPU 计时的帧不参与 gpu_ms，空列为 -1
+    template<typename Reduce>
+    FrameStats::Sample reduce_columns(const std::vector<FrameStats::Sample> &samples, Reduce reduce) {
+        std::vector<double> cols[5];
+        for (const auto &s: samples) {
+            cols[0].push_back(s.cpu_ms);
+            cols[1].push_back(s.upload_ms);
+            cols[2].push_back(s.swap_ms);
+            if (s.gpu_ms >= 0.0) cols[3].push_back(s.gpu_ms);
+            cols[4].push_back(s.scale);
+        }
+        double out[5];
+        for (int k = 0; k < 5; ++k) {
+            out[k] = cols[k].empty() ? -1.0 : reduce(cols[k]);
+        }
+        FrameStats::Sample r;
+        r.cpu_ms = out[0];
+        r.upload_ms = out[1];
+        r.swap_ms = out[2];
+        r.gpu_ms = out[3];
+        r.scale = out[4];
+        return r;
+    }
+
+}
+
+FrameStats::Sample FrameStats::percentile(double q) const {
+    return reduce_columns(resolved, [q](std::vector<double> &v) { return percentile_of(v, q); });
+}
+
+FrameStats::Sample FrameStats::mean() const {
+    return reduce_columns(resolved, [](std::vector<double> &v) { return mean_of(v); });
+}
+
+std::string FrameStats::summary() const {
+    size_t n = std::min<size_t>(resolved.size(), 30);
+    if (n == 0) return "";
+    double cpu = 0.0, gpu = 0.0;
+    int gpuCount = 0;
+    for (size_t i = resolved.size() - n; i < resolved.size(); ++i) {
+        cpu += resolved[i].cpu_ms;
+        if (resolved[i].gpu_ms >= 0.0) {
+            gpu += resolved[i].gpu_ms;
+            ++gpuCount;
+        }
+    }
+    cpu /= n;
+    if (gpuCount > 0) gpu /= gpuCount;
+    char buf[128];
+    std::snprintf(buf, sizeof(buf), "GPU %.2f ms | CPU %.2f ms | %.1f fps", gpu, cpu, cpu > 0.0 ? 1000.0 / cpu : 0.0);
+    return buf;
+}
+
+std::string FrameStats::percentiles() const {
+    std::string out;
+    const double qs[3] = {0.5, 0.9, 0.99};
+    const char *names[3] = {"p50", "p90", "p99"};
+    for (int k = 0; k < 3; ++k) {
+        Sample s = percentile(qs[k]);
+        char buf[160];
+        std::snprintf(buf, sizeof(buf), "%s  gpu %.3f  cpu %.3f  upload %.3f  swap %.3f ms\n",
+                      names[k], s.gpu_ms, s.cpu_ms, s.upload_ms, s.swap_ms);
+        out += buf;
+    }
+    return out;
+}
+
+void FrameStats::draw_overlay(int width, int height, double budget_ms) const {
+    const int barWidth = 2, graphHeight = std::min(100, height / 4), margin = 8;
+    const double scale = graphHeight / (2.0 * budget_ms);   // 预算线在图高的一半
+    if (graphHeight <= 0 || width < margin * 2) return;
+
+    GLfloat clear[4];
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clear);
+    glEnable(GL_SCISSOR_TEST);
+
+    int bars = std::min<int>(HISTORY, static_cast<int>(resolved.size()));
+    bars = std::min(bars, (width - margin * 2) / barWidth);
+    glScissor(margin, margin, HISTORY * barWidth, graphHeight);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    for (int i = 0; i < bars; ++i) {
+        const Sample &s = resolved[resolved.size() - bars + i];
+        if (s.gpu_ms < 0.0) continue;
+        int h = std::max(1, std::min(graphHeight, static_cast<int>(s.gpu_ms * scale)));
+        glScissor(margin + i * barWidth, margin, barWidth - 1, h);
+        if (s.gpu_ms > budget_ms) glClearColor(0.9f, 0.2f, 0.2f, 1.0f);
+        else glClearColor(0.2f, 0.8f, 0.3f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+
+    glScissor(margin, margin + graphHeight / 2, HISTORY * barWidth, 1);
+    glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glDisable(GL_SCISSOR_TEST);
+    glClearColor(clear[0], clear[1], clear[2], clear[3]);
+}
+
+void FrameStats::close() {
+    if (queries[0] == 0) return;
+    collect(true);
+    if (csv.is_open()) {
+        write_row("p50", percentile(0.5));
+        write_row("p90", percentile(0.9));
+        write_row("p99", percentile(0.99));
+        write_row("max", percentile(1.0));
+        csv.close();
+    }
+    glDeleteQueries(QUERY_COUNT, queries);
+    std::fill(queries, queries + QUERY_COUNT, 0u);
+    free_queries.clear();
+}
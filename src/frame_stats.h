@@ -0,0 +1,100 @@
+#ifndef ISR_FRAME_STATS_H
+#define ISR_FRAME_STATS_H
+
+#include <glad/glad.h>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// 每帧耗时统计：GPU 时间用 GL_TIME_ELAPSED 查询包住全屏 quad 的绘制，
+// CPU 时间分为整帧、上传 (update_dirty + glBufferSubData) 与 glfwSwapBuffers 三项。
+// 查询对象双缓冲：结果就绪后才读取 (通常晚一帧)，两个查询都还在途时这一帧不计 GPU 时间，从不等待 GPU
+class FrameStats {
+public:
+    static const int QUERY_COUNT = 2;
+    static const int HISTORY = 120;             // 叠加层显示的帧数
+
+    struct Sample {
+        long long frame = 0;
+        double cpu_ms = 0.0;                    // 整帧 CPU 时间 (上一帧 end_frame 到本帧 end_frame)
+        double upload_ms = 0.0;
+        double swap_ms = 0.0;
+        double gpu_ms = -1.0;                   // < 0 表示这一帧没有 GPU 计时
+        double scale = 1.0;                     // 光线步进的内部渲染比例 (动态分辨率)
+    };
+
+    // 需要当前线程上有 GL 上下文
+    void init();
+
+    // 逐帧写入 CSV；关闭时在末尾追加 p50 / p90 / p99 / max 四行
+    bool open_csv(const std::string &path);
+
+    void begin_upload();
+
+    void end_upload();
+
+    void begin_gpu();
+
+    void end_gpu();
+
+    void begin_swap();
+
+    void end_swap();
+
+    // 记录本帧的内部渲染比例，随样本一起输出，使 GPU 耗时能与渲染的像素数对应
+    void set_scale(double scale);
+
+    // 帧末调用：记录 CPU 时间，并收取已经就绪的 GPU 查询
+    void end_frame();
+
+    // 左下角画最近 HISTORY 帧的 GPU 耗时柱状图 (glScissor + glClear，不需要额外的着色器)，
+    // 超过 budget_ms 的帧为红色，白线为预算
+    void draw_overlay(int width, int height, double budget_ms = 1000.0 / 60.0) const;
+
+    // 最近 30 帧的平均值，适合放在窗口标题里
+    std::string summary() const;
+
+    // 全部已收取样本的分位数 (最近秩法) 与平均值；没有 GPU 计时的帧不参与 gpu_ms 的统计，
+    // 一个样本都没有时对应的字段为 -1
+    Sample percentile(double q) const;
+
+    Sample mean() const;
+
+    // p50 / p90 / p99 三行文本
+    std::string percentiles() const;
+
+    const std::vector<Sample> &samples() const { return resolved; }
+
+    // 等待在途的查询、写完 CSV 并释放查询对象；须在销毁 GL 上下文之前调用
+    void close();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Pending {
+        GLuint query = 0;                       // 0 = 没有 GPU 计时
+        Sample sample;
+    };
+
+    GLuint queries[QUERY_COUNT] = {};
+    std::vector<GLuint> free_queries;
+    std::deque<Pending> in_flight;              // 按帧序排列，只从队首收取，保证输出有序
+    GLuint current = 0;                         // 本帧使用的查询
+    Sample frame_sample;
+    long long frame_index = 0;
+    Clock::time_point frame_start, upload_start, swap_start;
+
+    std::vector<Sample> resolved;
+    std::ofstream csv;
+
+    static double ms_since(Clock::time_point start);
+
+    // 收取队首已就绪的帧；wait 为 true 时等到全部收完
+    void collect(bool wait);
+
+    void write_row(const std::string &label, const Sample &s);
+};
+
+#endif //ISR_FRAME_STATS_H
@@ -0,0 +1,87 @@
+#include "gbuffer.h"
+#include <iostream>
+
+namespace {
+
+    GLuint create_texture(GLenum format, int width, int height) {
+        GLuint tex;
+        glGenTextures(1, &tex);
+        glBindTexture(GL_TEXTURE_2D, tex);
+        glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        return tex;
+    }
+
+}
+
+void GBuffer::resize(int w, int h) {
+    if (w == width && h == height) return;
+    destroy();
+    width = w;
+    height = h;
+    albedo = create_texture(GL_RGBA16F, w, h);          // 基色 + 材质 ID (小整数，半精度可精确表示)
+    geom = create_texture(GL_RGBA32F, w, h);            // 法线 + 距离：第二遍由距离重建命中点，需要全精度
+    material = create_texture(GL_R32F, w, h);
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedo, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, geom, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, material, 0);
+    const GLenum buffers[3] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
+    glDrawBuffers(3, buffers);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "G-buffer 帧缓冲不完整: " << w << "x" << h << '\n';
+    }
+    lighting = create_texture(GL_RG16F, light_size(w), light_size(h));  // 主光阴影 + AO
+    glGenFramebuffers(1, &lightFbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, lightFbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, lighting, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "低分辨率光照帧缓冲不完整: " << light_size(w) << "x" << light_size(h) << '\n';
+    }
+}
+
+void GBuffer::begin_geometry(GLuint prog) const {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glUniform1i(glGetUniformLocation(prog, "uDeferred"), 1);
+}
+
+void GBuffer::begin_lighting(GLuint prog, int w, int h) const {
+    glBindFramebuffer(GL_FRAMEBUFFER, lightFbo);
+    glViewport(0, 0, light_size(w), light_size(h));
+    bind_textures();
+    glUniform1i(glGetUniformLocation(prog, "uLightScale"), LIGHT_SCALE);
+    glUniform1i(glGetUniformLocation(prog, "uDeferred"), 3);
+}
+
+void GBuffer::begin_shading(GLuint prog, GLuint target, int w, int h, bool withLighting) const {
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
+    glViewport(0, 0, w, h);
+    bind_textures();
+    glActiveTexture(GL_TEXTURE0 + LIGHTING_UNIT);
+    glBindTexture(GL_TEXTURE_2D, lighting);
+    glUniform1i(glGetUniformLocation(prog, "uLightScale"), withLighting ? LIGHT_SCALE : 0);
+    glUniform1i(glGetUniformLocation(prog, "uDeferred"), 2);
+}
+
+void GBuffer::bind_textures() const {
+    glActiveTexture(GL_TEXTURE0 + ALBEDO_UNIT);
+    glBindTexture(GL_TEXTURE_2D, albedo);
+    glActiveTexture(GL_TEXTURE0 + GEOM_UNIT);
+    glBindTexture(GL_TEXTURE_2D, geom);
+    glActiveTexture(GL_TEXTURE0 + MATERIAL_UNIT);
+    glBindTexture(GL_TEXTURE_2D, material);
+}
+
+void GBuffer::destroy() {
+    if (fbo == 0) return;
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &albedo);
+    glDeleteTextures(1, &geom);
+    glDeleteTextures(1, &material);
+    glDeleteFramebuffers(1, &lightFbo);
+    glDeleteTextures(1, &lighting);
+    fbo = albedo = geom = material = lightFbo = lighting = 0;
+    width = height = 0;
+}
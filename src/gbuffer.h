@@ -0,0 +1,46 @@
+#ifndef ISR_GBUFFER_H
+#define ISR_GBUFFER_H
+
+#include <glad/glad.h>
+
+// 延迟着色 (raymarch.frag 的 uDeferred)：第一遍只步进主光线，把第一次命中的基色 + 材质 ID、法线 + 距离
+// 与材质参数写进 G-buffer；第二遍从 G-buffer 着色 (软阴影、AO 与反射 / 折射)，每个像素只着色一次。
+// 着色与步进分开画，可以分别计时。两遍之间可以再画一遍 1 / LIGHT_SCALE 分辨率的光照 (uDeferred = 3)：
+// 在 G-buffer 上计算漫反射表面的主光软阴影与 AO，着色时按深度与法线双边上采样。
+// 纹理按窗口尺寸分配，视口可以更小 (动态分辨率只改变视口)
+class GBuffer {
+public:
+    static const int ALBEDO_UNIT = 6;           // 第二遍读取 G-buffer 的纹理单元 (raymarch.frag 中 uG* 的 binding)
+    static const int GEOM_UNIT = 7;
+    static const int MATERIAL_UNIT = 8;
+    static const int LIGHTING_UNIT = 9;
+    static const int LIGHT_SCALE = 2;           // 光照一遍的降采样倍数
+
+    static int light_size(int pixels) { return (pixels + LIGHT_SCALE - 1) / LIGHT_SCALE; }
+
+    // 按 width × height 分配纹理；尺寸不变时什么都不做
+    void resize(int width, int height);
+
+    // 第一遍：绑定 G-buffer 的 FBO (三个颜色附件，须关闭混合) 并设置 uDeferred = 1，随后由调用方画全屏 quad
+    void begin_geometry(GLuint prog) const;
+
+    // 低分辨率光照：绑定光照 FBO 与 G-buffer 纹理，把视口设为 width × height 的 1 / LIGHT_SCALE
+    // 并设置 uDeferred = 3，随后由调用方画全屏 quad
+    void begin_lighting(GLuint prog, int width, int height) const;
+
+    // 第二遍：绑定 target 并恢复 width × height 的视口，把 G-buffer 绑到 ALBEDO_UNIT / GEOM_UNIT / MATERIAL_UNIT
+    // 并设置 uDeferred = 2；之后单采样的绘制 (渐进累积或边缘自适应的第一遍) 都从 G-buffer 着色。
+    // withLighting 为 true 时 (之前画过 begin_lighting 的一遍) 软阴影与 AO 从低分辨率光照上采样
+    void begin_shading(GLuint prog, GLuint target, int width, int height, bool withLighting) const;
+
+    void destroy();
+
+private:
+    void bind_textures() const;
+
+    GLuint fbo = 0, albedo = 0, geom = 0, material = 0;
+    GLuint lightFbo = 0, lighting = 0;
+    int width = 0, height = 0;
+};
+
+#endif //ISR_GBUFFER_H
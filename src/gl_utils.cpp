@@ -0,0 +1,276 @@
+#define STB_IMAGE_IMPLEMENTATION
+#include "gl_utils.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "stb_image.h"
+#include "bvh.h"
+
+std::string loadShader(const char *path) {
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs) {
+        std::cerr << "无法打开着色器文件: " << path << '\n';
+        return "";
+    }
+    std::ostringstream oss;
+    oss << ifs.rdbuf();
+    return oss.str();
+}
+
+// 每条记录 stride 个 float：下标连续的记录合并为一次 glBufferSubData
+static void uploadRecords(GLuint buffer, const std::vector<int> &indices, const std::vector<float> &data, int stride) {
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    for (size_t i = 0; i < indices.size();) {
+        size_t j = i + 1;
+        while (j < indices.size() && indices[j] == indices[j - 1] + 1) {
+            ++j;
+        }
+        int first = indices[i];
+        int count = static_cast<int>(j - i);
+        glBufferSubData(GL_TEXTURE_BUFFER,
+                        first * stride * sizeof(float),
+                        count * stride * sizeof(float),
+                        data.data() + first * stride);
+        i = j;
+    }
+}
+
+void uploadDirtySlots(GLuint tbo, const std::vector<int> &slots, const std::vector<float> &gpuData) {
+    uploadRecords(tbo, slots, gpuData, 32);
+}
+
+void uploadDirtyNodes(GLuint tbo, const std::vector<int> &nodes, const std::vector<float> &bvhData) {
+    uploadRecords(tbo, nodes, bvhData, Objects::BVH_NODE_STRIDE);
+}
+
+std::string insertDefine(const std::string &src, const std::string &define) {
+    std::string out = src;
+    size_t eol = out.find('\n');
+    out.insert(eol == std::string::npos ? out.size() : eol + 1, "#define " + define + "\n");
+    return out;
+}
+
+std::string injectSceneCode(const std::string &src, const std::string &sceneCode) {
+    const std::string marker = "// @SCENE_MAP@";
+    size_t pos = src.find(marker);
+    if (pos == std::string::npos) {
+        std::cerr << "着色器中没有场景代码标记: " << marker << '\n';
+        return src;
+    }
+    std::string out = src;
+    out.replace(pos, marker.size(), sceneCode);
+    return insertDefine(out, "COMPILED_SCENE");
+}
+
+GLuint linkProgram(GLuint vs, GLuint fs) {
+    GLuint p = glCreateProgram();
+    glAttachShader(p, vs);
+    glAttachShader(p, fs);
+    glLinkProgram(p);
+
+    GLint ok = 0;
+    glGetProgramiv(p, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetProgramInfoLog(p, 1024, nullptr, log);
+        std::cerr << "Program 链接失败:\n" << log << '\n';
+    }
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+    return p;
+}
+
+GLuint compileShader(GLenum type, const char *src) {
+    GLuint s = glCreateShader(type);
+    glShaderSource(s, 1, &src, nullptr);
+    glCompileShader(s);
+
+    GLint ok = 0;
+    glGetShaderiv(s, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetShaderInfoLog(s, 1024, nullptr, log);
+        std::cerr << "着色器编译失败:\n" << log << '\n';
+    }
+    return s;
+}
+
+GLuint buildRaymarchProgram(const std::string &shaderDir, int stackSize, const std::string &sceneCode) {
+    std::string vsrc = loadShader((shaderDir + "/raymarch.vert").c_str());
+    std::string fsrc = loadShader((shaderDir + "/raymarch.frag").c_str());
+    fsrc = insertDefine(fsrc, "STACK_SIZE " + std::to_string(std::max(1, stackSize)));
+    if (!sceneCode.empty()) {
+        fsrc = injectSceneCode(fsrc, sceneCode);
+    }
+    GLuint vs = compileShader(GL_VERTEX_SHADER, vsrc.c_str());
+    GLuint fs = compileShader(GL_FRAGMENT_SHADER, fsrc.c_str());
+    return linkProgram(vs, fs);
+}
+
+GLuint createTextureBuffer(const std::vector<float> &data, GLuint &buffer) {
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER,
+                 data.size() * sizeof(float),
+                 data.data(),
+                 GL_DYNAMIC_DRAW);
+
+    GLuint tex;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_BUFFER, tex);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+    return tex;
+}
+
+
+GLuint createRenderTarget(int width, int height, GLuint &colorBuffer, GLenum format) {
+    GLuint fbo;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, format, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "离屏帧缓冲不完整: " << width << "x" << height << '\n';
+    }
+    return fbo;
+}
+
+void readPixelsRGB(int width, int height, std::vector<float> &rgb) {
+    std::vector<float> rows(size_t(width) * height * 3);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_FLOAT, rows.data());
+    // GL 的第 0 行在底部
+    rgb.resize(rows.size());
+    size_t stride = size_t(width) * 3;
+    for (int y = 0; y < height; ++y) {
+        std::copy(rows.begin() + (height - 1 - y) * stride, rows.begin() + (height - y) * stride,
+                  rgb.begin() + y * stride);
+    }
+}
+
+static const char* vsSrc = R"(#version 330 core
+layout(location=0) in vec3 aPos;
+out vec3 vDir;
+uniform mat4 uView;   // 每个面单独传
+void main(){
+    vDir = mat3(uView)*aPos;    // 方向向量 (已旋转到当前面)
+    gl_Position = vec4(aPos,1.0);
+})";
+
+static const char* fsSrc = R"(#version 330 core
+in  vec3 vDir;
+out vec4 FragColor;
+uniform sampler2D equirect;    // 已加载的 2D HDR
+const float PI = 3.1415926;
+void main(){
+    vec3 d = normalize(vDir);
+    float u = atan(d.z, d.x) / (2.0*PI) + 0.5;
+    float v = asin(clamp(d.y,-1,1)) / PI + 0.5;
+    vec3 hdr = textureLod(equirect, vec2(u,1.0-v), 0.0).rgb; // 反转 v
+    FragColor = vec4(hdr,1.0);
+})";
+
+/* -------------------------------------------------------------- */
+GLuint equirectToCubemap(const std::string& path, int cubemapSize)
+{
+    /* 1. 读取 HDR 到 2D 纹理 */
+    int w,h,comp;
+    float* data = stbi_loadf(path.c_str(), &w,&h,&comp, 0);
+    if(!data){ fprintf(stderr,"load %s fail\n",path.c_str()); return 0; }
+
+    GLuint tex2D; glGenTextures(1, &tex2D);
+    glBindTexture(GL_TEXTURE_2D, tex2D);
+    GLenum fmt = (comp==3) ? GL_RGB : GL_RGBA;
+    glTexImage2D(GL_TEXTURE_2D,0,GL_RGB16F,w,h,0,fmt,GL_FLOAT,data);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D,0);
+    stbi_image_free(data);
+
+    /* 2. 创建空 Cubemap */
+    GLuint cube; glGenTextures(1,&cube);
+    glBindTexture(GL_TEXTURE_CUBE_MAP,cube);
+    for(int i=0;i<6;++i)
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X+i,0,GL_RGB16F,
+                     cubemapSize,cubemapSize,0,GL_RGB,GL_FLOAT,nullptr);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP,GL_TEXTURE_MIN_FILTER,GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP,GL_TEXTURE_WRAP_R,GL_CLAMP_TO_EDGE);
+
+    /* 3. FBO 与着色器 */
+    GLuint fbo; glGenFramebuffers(1,&fbo);
+    GLuint rbo; glGenRenderbuffers(1,&rbo);           // 无需深度
+    glBindFramebuffer(GL_FRAMEBUFFER,fbo);
+    glBindRenderbuffer(GL_RENDERBUFFER,rbo);
+    glRenderbufferStorage(GL_RENDERBUFFER,GL_DEPTH_COMPONENT24,cubemapSize,cubemapSize);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER,GL_DEPTH_ATTACHMENT,GL_RENDERBUFFER,rbo);
+
+    GLuint vs = compileShader(GL_VERTEX_SHADER,vsSrc);
+    GLuint fs = compileShader(GL_FRAGMENT_SHADER,fsSrc);
+    GLuint prog = linkProgram(vs,fs);
+    glDeleteShader(vs); glDeleteShader(fs);
+
+    GLuint vao,vbo;
+    float cubeVerts[] = {
+        -1,-1,-1,  1,-1,-1,  1, 1,-1,  1, 1,-1, -1, 1,-1, -1,-1,-1, // -Z
+        -1,-1, 1,  1,-1, 1,  1, 1, 1,  1, 1, 1, -1, 1, 1, -1,-1, 1, // +Z
+        -1, 1,-1,  1, 1,-1,  1, 1, 1,  1, 1, 1, -1, 1, 1, -1, 1,-1, // +Y
+        -1,-1,-1,  1,-1,-1,  1,-1, 1,  1,-1, 1, -1,-1, 1, -1,-1,-1, // -Y
+        1,-1,-1,  1,-1, 1,  1, 1, 1,  1, 1, 1,  1, 1,-1,  1,-1,-1, // +X
+       -1,-1,-1, -1,-1, 1, -1, 1, 1, -1, 1, 1, -1, 1,-1, -1,-1,-1  // -X
+    };
+    glGenVertexArrays(1,&vao);
+    glGenBuffers(1,&vbo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER,vbo);
+    glBufferData(GL_ARRAY_BUFFER,sizeof(cubeVerts),cubeVerts,GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(float),0);
+
+    /* 4. 视矩阵 (lookAt 六方向) */
+    glm::mat4 views[6] = {
+        glm::lookAt(glm::vec3(0), glm::vec3(-1,0,0), glm::vec3(0,-1,0)), // +X
+        glm::lookAt(glm::vec3(0), glm::vec3(1,0,0), glm::vec3(0,-1,0)), // -X
+        glm::lookAt(glm::vec3(0), glm::vec3(0, 1,0), glm::vec3(0,0,1)),  // +Y
+        glm::lookAt(glm::vec3(0), glm::vec3(0,-1,0), glm::vec3(0,0,-1)), // -Y
+        glm::lookAt(glm::vec3(0), glm::vec3(0,0, 1), glm::vec3(0,-1,0)), // +Z
+        glm::lookAt(glm::vec3(0), glm::vec3(0,0,-1), glm::vec3(0,-1,0))  // -Z
+    };
+
+    /* 5. 渲染到 6 面 */
+    glUseProgram(prog);
+    glUniform1i(glGetUniformLocation(prog,"equirect"),0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D,tex2D);
+
+    glViewport(0,0,cubemapSize,cubemapSize);
+    for(int i=0;i<6;++i){
+        glUniformMatrix4fv(glGetUniformLocation(prog,"uView"),1,GL_FALSE,&views[i][0][0]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,
+                               GL_TEXTURE_CUBE_MAP_POSITIVE_X+i,cube,0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glBindVertexArray(vao);
+        glDrawArrays(GL_TRIANGLES,0,36);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER,0);
+
+    glDeleteVertexArrays(1,&vao);
+    glDeleteBuffers(1,&vbo);
+    glDeleteProgram(prog);
+    glDeleteTextures(1,&tex2D);
+    glDeleteRenderbuffers(1,&rbo);
+    glDeleteFramebuffers(1,&fbo);
+
+    /* 6. 生成 Mip-map 后返回 cubemap 句柄 */
+    glBindTexture(GL_TEXTURE_CUBE_MAP,cube);
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    return cube;
+}
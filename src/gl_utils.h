@@ -0,0 +1,44 @@
+#ifndef ISR_GL_UTILS_H
+#define ISR_GL_UTILS_H
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+
+// 窗口程序 (main.cpp) 与 ISR_bench 共用的 GL 辅助函数：着色器装配、TBO 上传与环境贴图烘焙
+
+std::string loadShader(const char *path);
+
+// 只上传改动的槽位：连续的槽位合并为一次 glBufferSubData
+void uploadDirtySlots(GLuint tbo, const std::vector<int> &slots, const std::vector<float> &gpuData);
+
+// 同上，按 BVH 节点 (每个 8 float) 上传 update_dirty 重新拟合的节点，nodes 需升序
+void uploadDirtyNodes(GLuint tbo, const std::vector<int> &nodes, const std::vector<float> &bvhData);
+
+// 在 #version 的下一行插入宏定义
+std::string insertDefine(const std::string &src, const std::string &define);
+
+// 定义 COMPILED_SCENE，并把生成的场景代码放到 raymarch.frag 中的标记处
+std::string injectSceneCode(const std::string &src, const std::string &sceneCode);
+
+GLuint linkProgram(GLuint vs, GLuint fs);
+
+GLuint compileShader(GLenum type, const char *src);
+
+// 读取 raymarch.vert / raymarch.frag 并链接：按场景的栈深定义 STACK_SIZE，
+// sceneCode 非空时注入场景编译生成的 mapCompiled()，否则使用 TBO 解释器
+GLuint buildRaymarchProgram(const std::string &shaderDir, int stackSize, const std::string &sceneCode);
+
+// 创建 GL_TEXTURE_BUFFER 并以 RGBA32F 纹理的形式暴露，buffer 接收缓冲对象，返回纹理
+GLuint createTextureBuffer(const std::vector<float> &data, GLuint &buffer);
+
+// 离屏渲染目标：默认 RGBA8 颜色缓冲 (与窗口默认帧缓冲的格式相同)，渐进累积时用 GL_RGBA32F；
+// colorBuffer 接收 renderbuffer，返回 FBO
+GLuint createRenderTarget(int width, int height, GLuint &colorBuffer, GLenum format = GL_RGBA8);
+
+// 读回当前帧缓冲，rgb 为 width * height * 3 个 float，第 0 行为图像顶部 (与 ImageIO 一致)
+void readPixelsRGB(int width, int height, std::vector<float> &rgb);
+
+GLuint equirectToCubemap(const std::string &path, int cubemapSize = 1024);
+
+#endif //ISR_GL_UTILS_H
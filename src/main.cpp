@@ -1,5 +1,4 @@
 // main.cpp
-#define STB_IMAGE_IMPLEMENTATION
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm/ext/vector_float3.hpp>
@@ -8,190 +7,152 @@
 #include <iostream>
 #include <vector>
 #include "objects.h"
+#include "scenes.h"
+#include "glsl_codegen.h"
+#include "frame_stats.h"
+#include "dynamic_resolution.h"
+#include "edge_aa.h"
+#include "cone_prepass.h"
+#include "gbuffer.h"
+#include "shadow_volume.h"
+#include "gl_utils.h"
+#include "image_io.h"
+#ifdef ISR_HAS_EGL
+#include "offscreen_context.h"
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <fstream>
 #include <sstream>
-#include "stb_image.h" 
 #include <string> 
 #include <glm/gtc/matrix_transform.hpp>
-#include <glad/glad.h>
 #include <glm/glm.hpp>
 
-std::string loadShader(const char *path) {
-    std::ifstream ifs(path, std::ios::binary);
-    if (!ifs) {
-        std::cerr << "无法打开着色器文件: " << path << '\n';
-        return "";
+// 没有 EGL 时的无窗口上下文：GLFW 的 null 平台 + OSMesa，窗口不可见，只借用它的上下文
+static GLFWwindow *createOsmesaContext(int width, int height) {
+    if (glfwPlatformSupported(GLFW_PLATFORM_NULL)) glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+    if (!glfwInit()) return nullptr;
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    GLFWwindow *win = glfwCreateWindow(width, height, "Ray Marching", nullptr, nullptr);
+    if (!win) {
+        glfwTerminate();
+        return nullptr;
     }
-    std::ostringstream oss;
-    oss << ifs.rdbuf();
-    return oss.str();
+    glfwMakeContextCurrent(win);
+    return win;
 }
 
-GLuint linkProgram(GLuint vs, GLuint fs) {
-    GLuint p = glCreateProgram();
-    glAttachShader(p, vs);
-    glAttachShader(p, fs);
-    glLinkProgram(p);
-
-    GLint ok = 0;
-    glGetProgramiv(p, GL_LINK_STATUS, &ok);
-    if (!ok) {
-        char log[1024];
-        glGetProgramInfoLog(p, 1024, nullptr, log);
-        std::cerr << "Program 链接失败:\n" << log << '\n';
+// ISR [--csv frames.csv] [--no-hud] [--no-vsync] [--scene julia] [--budget 16.6] [--fixed-res]
+//     [--always-render] [--spp 64] [--full-aa] [--no-cone] [--relax 1.5] [--forward]
+//     [--full-lighting] [--no-shadow-cache]
+//     [--headless [-w 1280] [-h 720] [--frames 1] [-o render.png]]
+//   --csv       逐帧写出 CPU / GPU 耗时，结束时追加分位数
+//   --no-hud    启动时不显示左下角的 GPU 耗时图 (运行中按 H 切换)
+//   --no-vsync  窗口模式下不等垂直同步，帧率不再被限制在刷新率
+//   --budget    动态分辨率的 GPU 预算 (ms)：光线步进先画到内部 FBO，按测得的 GPU 耗时
+//               在窗口分辨率的 50% ~ 100% 之间调整，再线性放大到窗口
+//   --fixed-res 关闭动态分辨率，始终按窗口分辨率渲染 (无窗口模式总是如此)
+//   --always-render 每帧都重新光线步进；默认画面没有变化时只把上一帧复制到窗口
+//   --spp       渐进累积的采样数上限：画面变化后先画 1 个采样，静止时每帧再叠加一个抖动采样，
+//               在 RGBA32F 缓冲中求平均，攒够后停止；0 = 每帧 2x2 网格超采样。
+//               窗口默认 64，无窗口默认 0 (指定时至少画 spp 帧)
+//   --full-aa   spp 为 0 时每个像素都做 2x2 超采样；默认先每像素 1 个采样找出边缘，只对边缘超采样
+//   --no-cone   关闭锥体预步进，主光线从相机处开始步进
+//   --relax     过松弛球体追踪的系数 ω (越过表面时自动退回)，1 = 普通球体追踪
+//   --forward   关闭延迟着色，步进与着色在同一遍里做 (--full-aa 时总是如此)
+//   --full-lighting 延迟着色时按全分辨率计算软阴影与 AO；默认在 1/2 分辨率计算再双边上采样
+//   --no-shadow-cache 每次着色都沿主光步进软阴影；默认预先算进三维纹理，物体移动时只重画受影响的体素
+//   --headless  不创建窗口：EGL surfaceless 上下文 (没有 EGL 时用 OSMesa)，
+//               渲染到 w × h 的 FBO，连续画 frames 帧后把最后一帧写成 PNG
+int main(int argc, char **argv) {
+    std::string csvPath, outPath = "render.png", sceneName = "julia";
+    bool showHud = true, vsync = true, headless = false, dynamicRes = true, alwaysRender = false;
+    bool edgeAA = true, conePrepass = true, deferred = true, lowResLighting = true;
+    bool shadowCache = true;
+    int width = 1280, height = 720, frames = 1, spp = -1;
+    double budgetMs = 1000.0 / 60.0;
+    float relax = 1.5f;
+    for (int i = 1; i < argc; i++) {
+        auto next = [&]() -> const char * {
+            if (i + 1 >= argc) {
+                std::cout << "[Error] Missing value for " << argv[i] << std::endl;
+                std::exit(1);
+            }
+            return argv[++i];
+        };
+        if (!std::strcmp(argv[i], "--csv")) csvPath = next();
+        else if (!std::strcmp(argv[i], "--no-hud")) showHud = false;
+        else if (!std::strcmp(argv[i], "--no-vsync")) vsync = false;
+        else if (!std::strcmp(argv[i], "--scene")) sceneName = next();
+        else if (!std::strcmp(argv[i], "--budget")) budgetMs = std::atof(next());
+        else if (!std::strcmp(argv[i], "--fixed-res")) dynamicRes = false;
+        else if (!std::strcmp(argv[i], "--always-render")) alwaysRender = true;
+        else if (!std::strcmp(argv[i], "--spp")) spp = std::atoi(next());
+        else if (!std::strcmp(argv[i], "--full-aa")) edgeAA = false;
+        else if (!std::strcmp(argv[i], "--no-cone")) conePrepass = false;
+        else if (!std::strcmp(argv[i], "--relax")) relax = static_cast<float>(std::atof(next()));
+        else if (!std::strcmp(argv[i], "--forward")) deferred = false;
+        else if (!std::strcmp(argv[i], "--full-lighting")) lowResLighting = false;
+        else if (!std::strcmp(argv[i], "--no-shadow-cache")) shadowCache = false;
+        else if (!std::strcmp(argv[i], "--headless")) headless = true;
+        else if (!std::strcmp(argv[i], "-w")) width = std::atoi(next());
+        else if (!std::strcmp(argv[i], "-h")) height = std::atoi(next());
+        else if (!std::strcmp(argv[i], "--frames")) frames = std::atoi(next());
+        else if (!std::strcmp(argv[i], "-o")) outPath = next();
+        else {
+            std::cout << "[Error] Unknown argument " << argv[i] << std::endl;
+            return 1;
+        }
     }
-    glDeleteShader(vs);
-    glDeleteShader(fs);
-    return p;
-}
-
-GLuint compileShader(GLenum type, const char *src) {
-    GLuint s = glCreateShader(type);
-    glShaderSource(s, 1, &src, nullptr);
-    glCompileShader(s);
-
-    GLint ok = 0;
-    glGetShaderiv(s, GL_COMPILE_STATUS, &ok);
-    if (!ok) {
-        char log[1024];
-        glGetShaderInfoLog(s, 1024, nullptr, log);
-        std::cerr << "着色器编译失败:\n" << log << '\n';
+    if (width <= 0 || height <= 0 || frames <= 0) {
+        std::cout << "[Error] Invalid resolution or frame count" << std::endl;
+        return 1;
     }
-    return s;
-}
-
-static const char* vsSrc = R"(#version 330 core
-layout(location=0) in vec3 aPos;
-out vec3 vDir;
-uniform mat4 uView;   // 每个面单独传
-void main(){
-    vDir = mat3(uView)*aPos;    // 方向向量 (已旋转到当前面)
-    gl_Position = vec4(aPos,1.0);
-})";
-
-static const char* fsSrc = R"(#version 330 core
-in  vec3 vDir;
-out vec4 FragColor;
-uniform sampler2D equirect;    // 已加载的 2D HDR
-const float PI = 3.1415926;
-void main(){
-    vec3 d = normalize(vDir);
-    float u = atan(d.z, d.x) / (2.0*PI) + 0.5;
-    float v = asin(clamp(d.y,-1,1)) / PI + 0.5;
-    vec3 hdr = textureLod(equirect, vec2(u,1.0-v), 0.0).rgb; // 反转 v
-    FragColor = vec4(hdr,1.0);
-})";
-
-/* -------------------------------------------------------------- */
-GLuint equirectToCubemap(const std::string& path, int cubemapSize = 1024)
-{
-    /* 1. 读取 HDR 到 2D 纹理 */
-    int w,h,comp;
-    float* data = stbi_loadf(path.c_str(), &w,&h,&comp, 0);
-    if(!data){ fprintf(stderr,"load %s fail\n",path.c_str()); return 0; }
-
-    GLuint tex2D; glGenTextures(1, &tex2D);
-    glBindTexture(GL_TEXTURE_2D, tex2D);
-    GLenum fmt = (comp==3) ? GL_RGB : GL_RGBA;
-    glTexImage2D(GL_TEXTURE_2D,0,GL_RGB16F,w,h,0,fmt,GL_FLOAT,data);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
-    glBindTexture(GL_TEXTURE_2D,0);
-    stbi_image_free(data);
-
-    /* 2. 创建空 Cubemap */
-    GLuint cube; glGenTextures(1,&cube);
-    glBindTexture(GL_TEXTURE_CUBE_MAP,cube);
-    for(int i=0;i<6;++i)
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X+i,0,GL_RGB16F,
-                     cubemapSize,cubemapSize,0,GL_RGB,GL_FLOAT,nullptr);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP,GL_TEXTURE_MIN_FILTER,GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP,GL_TEXTURE_WRAP_R,GL_CLAMP_TO_EDGE);
-
-    /* 3. FBO 与着色器 */
-    GLuint fbo; glGenFramebuffers(1,&fbo);
-    GLuint rbo; glGenRenderbuffers(1,&rbo);           // 无需深度
-    glBindFramebuffer(GL_FRAMEBUFFER,fbo);
-    glBindRenderbuffer(GL_RENDERBUFFER,rbo);
-    glRenderbufferStorage(GL_RENDERBUFFER,GL_DEPTH_COMPONENT24,cubemapSize,cubemapSize);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER,GL_DEPTH_ATTACHMENT,GL_RENDERBUFFER,rbo);
-
-    GLuint vs = compileShader(GL_VERTEX_SHADER,vsSrc);
-    GLuint fs = compileShader(GL_FRAGMENT_SHADER,fsSrc);
-    GLuint prog = linkProgram(vs,fs);
-    glDeleteShader(vs); glDeleteShader(fs);
-
-    GLuint vao,vbo;
-    float cubeVerts[] = {
-        -1,-1,-1,  1,-1,-1,  1, 1,-1,  1, 1,-1, -1, 1,-1, -1,-1,-1, // -Z
-        -1,-1, 1,  1,-1, 1,  1, 1, 1,  1, 1, 1, -1, 1, 1, -1,-1, 1, // +Z
-        -1, 1,-1,  1, 1,-1,  1, 1, 1,  1, 1, 1, -1, 1, 1, -1, 1,-1, // +Y
-        -1,-1,-1,  1,-1,-1,  1,-1, 1,  1,-1, 1, -1,-1, 1, -1,-1,-1, // -Y
-        1,-1,-1,  1,-1, 1,  1, 1, 1,  1, 1, 1,  1, 1,-1,  1,-1,-1, // +X
-       -1,-1,-1, -1,-1, 1, -1, 1, 1, -1, 1, 1, -1, 1,-1, -1,-1,-1  // -X
-    };
-    glGenVertexArrays(1,&vao);
-    glGenBuffers(1,&vbo);
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER,vbo);
-    glBufferData(GL_ARRAY_BUFFER,sizeof(cubeVerts),cubeVerts,GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3*sizeof(float),0);
-
-    /* 4. 视矩阵 (lookAt 六方向) */
-    glm::mat4 views[6] = {
-        glm::lookAt(glm::vec3(0), glm::vec3(-1,0,0), glm::vec3(0,-1,0)), // +X
-        glm::lookAt(glm::vec3(0), glm::vec3(1,0,0), glm::vec3(0,-1,0)), // -X
-        glm::lookAt(glm::vec3(0), glm::vec3(0, 1,0), glm::vec3(0,0,1)),  // +Y
-        glm::lookAt(glm::vec3(0), glm::vec3(0,-1,0), glm::vec3(0,0,-1)), // -Y
-        glm::lookAt(glm::vec3(0), glm::vec3(0,0, 1), glm::vec3(0,-1,0)), // +Z
-        glm::lookAt(glm::vec3(0), glm::vec3(0,0,-1), glm::vec3(0,-1,0))  // -Z
-    };
-
-    /* 5. 渲染到 6 面 */
-    glUseProgram(prog);
-    glUniform1i(glGetUniformLocation(prog,"equirect"),0);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D,tex2D);
-
-    glViewport(0,0,cubemapSize,cubemapSize);
-    for(int i=0;i<6;++i){
-        glUniformMatrix4fv(glGetUniformLocation(prog,"uView"),1,GL_FALSE,&views[i][0][0]);
-        glFramebufferTexture2D(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,
-                               GL_TEXTURE_CUBE_MAP_POSITIVE_X+i,cube,0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glBindVertexArray(vao);
-        glDrawArrays(GL_TRIANGLES,0,36);
+    if (budgetMs <= 0.0) {
+        std::cout << "[Error] Invalid frame budget" << std::endl;
+        return 1;
     }
-    glBindFramebuffer(GL_FRAMEBUFFER,0);
-
-    glDeleteVertexArrays(1,&vao);
-    glDeleteBuffers(1,&vbo);
-    glDeleteProgram(prog);
-    glDeleteTextures(1,&tex2D);
-    glDeleteRenderbuffers(1,&rbo);
-    glDeleteFramebuffers(1,&fbo);
-
-    /* 6. 生成 Mip-map 后返回 cubemap 句柄 */
-    glBindTexture(GL_TEXTURE_CUBE_MAP,cube);
-    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
-    return cube;
-}
+    if (headless) dynamicRes = false;                   // 输出图像按 -w / -h 原样渲染
+    if (spp < 0) spp = headless ? 0 : 64;
+    if (headless) frames = std::max(frames, spp);
+    if (spp > 0) edgeAA = false;                        // 渐进累积本身就在像素内多次采样
+    if (spp == 0 && !edgeAA) deferred = false;          // 逐像素 2x2 超采样每个像素有 4 个命中点，G-buffer 只存 1 个
 
-int main() {
     /* ---------- 1. 初始化窗口与 OpenGL ---------- */
-    if (!glfwInit()) return -1;
-    GLFWwindow *win = glfwCreateWindow(1280, 720, "Ray Marching", nullptr, nullptr);
-    if (!win) {
-        glfwTerminate();
-        return -1;
+    GLFWwindow *win = nullptr;
+#ifdef ISR_HAS_EGL
+    OffscreenContext offscreen;
+    bool useEgl = headless && offscreen.create();
+#else
+    bool useEgl = false;
+#endif
+    if (useEgl) {
+#ifdef ISR_HAS_EGL
+        if (!gladLoadGLLoader((GLADloadproc) OffscreenContext::proc_address)) return -1;
+#endif
+    } else if (headless) {
+        win = createOsmesaContext(width, height);
+        if (!win) {
+            std::cout << "[Error] Cannot create a headless OpenGL context (EGL / OSMesa)" << std::endl;
+            return -1;
+        }
+        if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) return -1;
+    } else {
+        if (!glfwInit()) return -1;
+        win = glfwCreateWindow(width, height, "Ray Marching", nullptr, nullptr);
+        if (!win) {
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(win);
+        if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) return -1;
+        glfwSwapInterval(vsync ? 1 : 0);
     }
-    glfwMakeContextCurrent(win);
-    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) return -1;
-    glfwSwapInterval(1);
 
     /* ---------- 2. 创建全屏四边形 ---------- */
     float quad[8] = {-1, -1, 1, -1, -1, 1, 1, 1};       // 两个三角形 strip
@@ -206,126 +167,309 @@ int main() {
 
     GLuint envTex = equirectToCubemap("shaders/glacier.hdr", 1024);                         
 
-    /* ---------- 3. 编译 / 链接着色器 ---------- */
-    std::string vsrc = loadShader("shaders/raymarch.vert");
-    std::string fsrc = loadShader("shaders/raymarch.frag");
-    GLuint vs = compileShader(GL_VERTEX_SHADER, vsrc.c_str());
-    GLuint fs = compileShader(GL_FRAGMENT_SHADER, fsrc.c_str());
-    GLuint prog = linkProgram(vs, fs);
-
-    glUseProgram(prog);
-
-    /* ① 告诉着色器：uEnvMap 来自 texture unit 1 */
-    glUniform1i(glGetUniformLocation(prog, "uEnvMap"), 1);
-
-    glUniform1i(glGetUniformLocation(prog,"uEnvEnable"), 1);   // 1 = ON
-
-    /* ② 依旧把 objectBuffer 绑定到槽 0（已有） */
-    glUniform1i(glGetUniformLocation(prog, "objectBuffer"), 0);
-
     /* ---------- 4. 在 CPU 端创建任意数量的物体 ---------- */
     using namespace Objects;
     CSG_tree tree = CSG_tree();
     
-    // 创建地面
-    auto* ground = tree.create_plane({0.7f, 0.7f, 0.7f, 1.0f}, glm::vec3(0.0f, 1.0f, 0.0f), -1.0f);
-    
-    // 创建Menger Sponge分形 - 左侧，金色
-    // auto* menger = tree.create_menger_sponge(
-    //     {1.0f, 0.8f, 0.3f, 1.0f},           // 颜色：金色
-    //     glm::vec3(-6.0f, 1.2f, 0.0f),       // 中心位置：左侧，更远
-    //     1.8f,                                // 大小
-    //     5,                                   // 迭代次数：4层精细度
-    //     0,                                   // 漫反射材质
-    //     0.0f                                 // 材质参数
-    // );
-    
-    // // 创建Mandelbulb分形 - 中间，紫红色
-    // auto* mandelbulb = tree.create_mandelbulb(
-    //     {1.0f, 0.3f, 0.8f, 1.0f},           // 颜色：紫红色
-    //     glm::vec3(0.0f, 1.0f, 0.0f),        // 中心位置：中间
-    //     2.2f,                                // 缩放系数：更大一点
-    //     8.0f,                                // Mandelbulb幂次 (经典值)
-    //     80,                                  // 迭代次数：更高精度
-    //     0,                                   // 漫反射材质
-    //     0.0f                                 // 材质参数
-    // );
-    
-    // 创建Julia Set 3D分形 - 左侧，不使用orbit trap，基础颜色
-    auto* julia3d_clean = tree.create_julia_set_3d(
-        {0.3f, 1.0f, 0.6f, 1.0f},           // 颜色：青绿色（基础颜色）
-        glm::vec3(-3.0f, 1.0f, 0.0f),       // 中心位置：左侧
-        2.0f,                                // 缩放系数
-        glm::vec2(-0.75f, 0.11f),           // 树枝状Julia参数
-        64,                                  // 迭代次数
-        false,                               // 不使用orbit trap (保持原始颜色)
-        0,                                   // 漫反射材质
-        0.0f                                 // 材质参数
-    );
-    
-    // 创建Julia Set 3D分形 - 右侧，使用orbit trap，相同基础颜色
-    auto* julia3d_orbit = tree.create_julia_set_3d(
-        {0.3f, 1.0f, 0.6f, 1.0f},           // 颜色：相同的青绿色（会被orbit trap调制）
-        glm::vec3(3.0f, 1.0f, 0.0f),        // 中心位置：右侧
-        2.0f,                                // 缩放系数
-        glm::vec2(-0.75f, 0.11f),           // 相同的Julia参数
-        64,                                  // 迭代次数
-        true,                                // 使用orbit trap (会产生橙红色调制效果)
-        0,                                   // 漫反射材质
-        0.0f                                 // 材质参数
-    );
+    if (!Scenes::build_scene(sceneName, tree)) {
+        std::cout << "[Error] Unknown scene " << sceneName << std::endl;
+        return 1;
+    }
 
     /* ---------- 5. 打包成连续 float ---------- */
-    std::vector<float> gpuData;
-    auto data = tree.generate_texture_data();  // 每个物体 32 float
-    gpuData.reserve(data.size() * 32);
-    for (auto &d: data) {
-        gpuData.insert(gpuData.end(), d.begin(), d.end());
+    std::vector<float> gpuData;                         // 每个物体 32 float，直接打包成 TBO 的内容
+    std::vector<float> bvhData;                         // 每个节点 8 float
+    tree.generate_texture_data(gpuData, bvhData);
+    const int numObjects = static_cast<int>(gpuData.size() / 32);
+
+    /* ---------- 5.5 编译 / 链接着色器 ---------- */
+    // 场景编译：由 glsl_codegen 把场景生成为 GLSL 的 mapCompiled()，代替 TBO 解释器；
+    // SCENE_PARAMS_IN_UBO 为 true 时参数放在 uniform block 中，物体运动只需更新缓冲而不必重新编译；
+    // 内联模式把参数 (连同 BVH 的包围盒) 写死在 shader 里，物体移动后在 7-2 按新的参数重新生成并链接，
+    // 每次都要重新编译，场景中有连续运动的物体时应使用 UBO 模式或关闭 COMPILE_SCENE
+    const bool COMPILE_SCENE = true;
+    const bool SCENE_PARAMS_IN_UBO = false;
+
+    std::string sceneCode = COMPILE_SCENE ? generate_glsl_map(gpuData, bvhData, SCENE_PARAMS_IN_UBO) : "";
+    GLuint prog = buildRaymarchProgram("shaders", tree.stack_size(), sceneCode);
+
+    /* ④ 场景参数 uniform block 使用绑定点 0 */
+    GLuint paramUbo = 0;
+    if (COMPILE_SCENE && SCENE_PARAMS_IN_UBO) {
+        std::vector<float> params = pack_scene_params(gpuData);
+        glGenBuffers(1, &paramUbo);
+        glBindBuffer(GL_UNIFORM_BUFFER, paramUbo);
+        glBufferData(GL_UNIFORM_BUFFER, params.size() * sizeof(float), params.data(), GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, 0, paramUbo);
     }
 
-    /* ---------- 6. 生成 TBO + 纹理 ---------- */
-    GLuint tbo, tex;
-    glGenBuffers(1, &tbo);
-    glBindBuffer(GL_TEXTURE_BUFFER, tbo);
-    glBufferData(GL_TEXTURE_BUFFER,
-                 gpuData.size() * sizeof(float),
-                 gpuData.data(),
-                 GL_DYNAMIC_DRAW);
-
-    glGenTextures(1, &tex);
-    glBindTexture(GL_TEXTURE_BUFFER, tex);
-    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, tbo);
-    
-    /* ---------- 7. 渲染循环 ---------- */
-    while (!glfwWindowShouldClose(win)) {
-        /* 7-1 更新窗口尺寸 / 清屏 */
-        int w, h;
-        glfwGetFramebufferSize(win, &w, &h);
-        glViewport(0, 0, w, h);
-        glClear(GL_COLOR_BUFFER_BIT);
+    // 链接后只需设置一次的 uniform；内联模式重新链接后再调用一次
+    auto setupProgram = [&]() {
+        glUseProgram(prog);
 
-        /* 7-2 绑定纹理并设置 uniform */
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_BUFFER, tex);
+        /* ① 告诉着色器：uEnvMap 来自 texture unit 1 */
+        glUniform1i(glGetUniformLocation(prog, "uEnvMap"), 1);
 
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, envTex);
+        glUniform1i(glGetUniformLocation(prog,"uEnvEnable"), 1);   // 1 = ON
 
-        glUseProgram(prog);
-        glUniform1i(glGetUniformLocation(prog, "objectBuffer"), 0);              // 绑定槽 0
-        glUniform1i(glGetUniformLocation(prog, "numObjects"), (int) data.size());
-        glUniform2f(glGetUniformLocation(prog, "iResolution"), (float) w, (float) h);
-        glUniform1f(glGetUniformLocation(prog, "iTime"), (float) glfwGetTime());
+        /* ② 依旧把 objectBuffer 绑定到槽 0（已有） */
+        glUniform1i(glGetUniformLocation(prog, "objectBuffer"), 0);
+
+        /* ③ BVH 节点使用槽 2 */
+        glUniform1i(glGetUniformLocation(prog, "bvhBuffer"), 2);
+
+        /* ③' 步长：只有基元时距离是严格的下界，不必再乘 0.7；在此基础上按 relax 过松弛 */
+        glUniform1f(glGetUniformLocation(prog, "uStepScale"), tree.has_fractals() ? 0.7f : 1.0f);
+        glUniform1f(glGetUniformLocation(prog, "uRelax"), relax);
+
+        if (paramUbo != 0) glUniformBlockBinding(prog, glGetUniformBlockIndex(prog, "SceneParams"), 0);
+    };
+    setupProgram();
 
-        /* 7-3 画全屏 quad */
-        glBindVertexArray(vao);
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    /* ---------- 6. 生成 TBO + 纹理 ---------- */
+    GLuint tbo, bvhTbo;
+    GLuint tex = createTextureBuffer(gpuData, tbo);
+    GLuint bvhTex = createTextureBuffer(bvhData, bvhTbo);
+
+    /* ---------- 6.1 主光阴影缓存 (第一次渲染时画) ---------- */
+    ShadowVolume shadow;
+    if (shadowCache) shadow.resize(tree.bounded_extent());
+    
+    /* ---------- 6.5 帧耗时统计 ---------- */
+    FrameStats stats;
+    stats.init();
+    if (!csvPath.empty()) stats.open_csv(csvPath);
+    auto startTime = std::chrono::steady_clock::now();
+    auto seconds = [&]() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    };
+    double titleTime = 0.0;
+    bool hudKeyDown = false;
+
+    /* ---------- 6.6 渲染目标 ---------- */
+    // 无窗口时直接渲染到 w × h 的 FBO；窗口模式先渲染到内部 FBO，再放大 (动态分辨率) 或原样复制到窗口。
+    // 内部 FBO 按窗口尺寸分配，只在窗口尺寸变化时重建；比例变化只改变视口，不重新分配。
+    // 它同时保存着上一帧：画面没有变化时不再光线步进，只把它复制到窗口。
+    // 渐进累积时为 RGBA32F，保存已累积采样的平均值
+    const GLenum targetFormat = spp > 0 ? GL_RGBA32F : GL_RGBA8;
+    GLuint target = 0, targetColor = 0;
+    int targetW = 0, targetH = 0;
+    EdgeAA edge;
+    ConePrepass cone;
+    GBuffer gbuffer;
+    if (headless) {
+        target = createRenderTarget(width, height, targetColor, targetFormat);
+        if (edgeAA) edge.resize(width, height);
+        if (conePrepass) cone.resize(width, height);
+        if (deferred) gbuffer.resize(width, height);
+    }
+    DynamicResolution dynres(budgetMs);
+    size_t seenSamples = 0;
+
+    // 着色器不读 iTime 时 uniform 会被编译器剔除 (位置为 -1)，画面只取决于场景与窗口尺寸
+    const bool usesTime = glGetUniformLocation(prog, "iTime") >= 0;
+    bool haveFrame = false;                             // 内部 FBO 中是否有可复用的一帧
+    int rw = 0, rh = 0;                                 // 该帧的渲染尺寸
+    int accumCount = 0;                                 // 该帧已累积的采样数
 
+    /* ---------- 7. 渲染循环 ---------- */
+    int frame = 0;
+    while (headless ? frame < frames : !glfwWindowShouldClose(win)) {
+        /* 7-1 更新窗口尺寸 */
+        int w = width, h = height;
+        bool resized = false;
+        if (!headless) {
+            glfwGetFramebufferSize(win, &w, &h);
+            if (w > 0 && h > 0 && (w != targetW || h != targetH)) {
+                if (target != 0) {
+                    glDeleteRenderbuffers(1, &targetColor);
+                    glDeleteFramebuffers(1, &target);
+                }
+                target = createRenderTarget(w, h, targetColor, targetFormat);
+                if (edgeAA) edge.resize(w, h);
+                if (conePrepass) cone.resize(w, h);
+                if (deferred) gbuffer.resize(w, h);
+                targetW = w;
+                targetH = h;
+                resized = true;
+            }
+        }
+
+        /* 7-2 只上传移动过的物体与重新拟合的 BVH 节点 (内联的场景编译则重新链接)；阴影缓存中受影响的体素随之失效 */
+        stats.begin_upload();
+        std::vector<AABB> movedBounds;
+        std::vector<int> dirtyNodes;
+        std::vector<int> dirtySlots = tree.update_dirty(gpuData, bvhData, &movedBounds, &dirtyNodes);
+        shadow.invalidate(movedBounds);
+        if (!dirtySlots.empty()) {
+            uploadDirtySlots(tbo, dirtySlots, gpuData);
+            uploadDirtyNodes(bvhTbo, dirtyNodes, bvhData);
+            if (COMPILE_SCENE && !SCENE_PARAMS_IN_UBO) {
+                glDeleteProgram(prog);
+                sceneCode = generate_glsl_map(gpuData, bvhData, false);
+                prog = buildRaymarchProgram("shaders", tree.stack_size(), sceneCode);
+                setupProgram();
+            }
+            if (paramUbo != 0) {
+                std::vector<float> params = pack_scene_params(gpuData);
+                glBindBuffer(GL_UNIFORM_BUFFER, paramUbo);
+                glBufferSubData(GL_UNIFORM_BUFFER, 0, params.size() * sizeof(float), params.data());
+            }
+        }
+        stats.end_upload();
+
+        /* 7-3 是否需要重新光线步进：场景、窗口尺寸或时间有变化时重新开始；
+         *     画面静止后若上一帧是降低分辨率画的，按满分辨率重新开始，否则继续累积采样，攒够 spp 个后停止 */
+        bool changed = !haveFrame || resized || !dirtySlots.empty() || usesTime;
+        if (headless) changed = frame == 0 || spp == 0;
+        bool refine = !changed && (rw != w || rh != h);
+        bool accumulate = !changed && !refine && accumCount < spp;
+        bool restart = changed || refine || (alwaysRender && !accumulate);
+        if ((restart || accumulate) && w > 0 && h > 0) {
+            glBindFramebuffer(GL_FRAMEBUFFER, target);
+            if (restart) {
+                float scale = dynamicRes && changed ? dynres.scale() : 1.0f;
+                rw = std::max(1, static_cast<int>(w * scale + 0.5f));
+                rh = std::max(1, static_cast<int>(h * scale + 0.5f));
+                accumCount = 0;
+                glClear(GL_COLOR_BUFFER_BIT);
+            }
+            glViewport(0, 0, rw, rh);
+
+            /* 7-4 绑定纹理并设置 uniform */
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_BUFFER, tex);
+
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, envTex);
+
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_BUFFER, bvhTex);
+
+            glUseProgram(prog);
+            glUniform1i(glGetUniformLocation(prog, "objectBuffer"), 0);              // 绑定槽 0
+            glUniform1i(glGetUniformLocation(prog, "numObjects"), numObjects);
+            glUniform1i(glGetUniformLocation(prog, "numBVHNodes"), (int) bvhData.size() / 8);
+            glUniform2f(glGetUniformLocation(prog, "iResolution"), (float) rw, (float) rh);
+            glUniform1f(glGetUniformLocation(prog, "iTime"), (float) seconds());
+
+            /* 7-5 画全屏 quad：先重画阴影缓存中失效的体素 (在 GPU 计时之外：重画量取决于物体移动了多少，
+             *     与渲染比例无关，不应计入动态分辨率的预算)；GPU 计时只包住画面本身的绘制：
+             *     重新开始时做锥体预步进 (累积采样时几何不变，沿用上一次的结果)，
+             *     延迟着色先写 G-buffer、画低分辨率的阴影与 AO 再着色，边缘自适应抗锯齿分两遍画 */
+            glBindVertexArray(vao);
+            shadow.update(prog, target, rw, rh);
+            stats.begin_gpu();
+            if (conePrepass && restart) {
+                cone.begin(prog, rw, rh);
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+                cone.end(prog, target, rw, rh);
+            }
+
+            int accumFrame = spp > 0 ? ++accumCount : 0;
+            glUniform1i(glGetUniformLocation(prog, "uAccumFrame"), accumFrame);
+            if (deferred) {
+                gbuffer.begin_geometry(prog);
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+                if (lowResLighting) {
+                    gbuffer.begin_lighting(prog, rw, rh);
+                    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+                }
+                gbuffer.begin_shading(prog, target, rw, rh, lowResLighting);
+            }
+
+            // 渐进累积：混合成累计平均 dst = src / n + dst * (1 - 1 / n)，第 1 个采样直接覆盖 (G-buffer 不混合)
+            if (spp > 0) {
+                glEnable(GL_BLEND);
+                glBlendColor(0.0f, 0.0f, 0.0f, 1.0f / accumCount);
+                glBlendFunc(GL_CONSTANT_ALPHA, GL_ONE_MINUS_CONSTANT_ALPHA);
+            }
+            if (edgeAA) {
+                edge.begin_primary(prog);
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+                edge.begin_resolve(prog, target);
+            }
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            stats.end_gpu();
+            glDisable(GL_BLEND);
+            haveFrame = true;
+        }
+        const bool rendered = (restart || accumulate) && w > 0 && h > 0;
+        if (w > 0) stats.set_scale(static_cast<double>(rw) / w);     // 显示的这一帧的比例
+
+        /* 7-6 无窗口：等这一帧画完 (代替 swap)，不画叠加层，免得写进输出图像 */
+        if (headless) {
+            stats.begin_swap();
+            glFinish();
+            stats.end_swap();
+            stats.end_frame();
+            ++frame;
+            continue;
+        }
+
+        /* 7-7 把内部 FBO 的左下角 rw × rh 放大到窗口 (与窗口同尺寸时为逐像素复制) */
+        if (haveFrame) {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, target);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            glBlitFramebuffer(0, 0, rw, rh, 0, 0, w, h, GL_COLOR_BUFFER_BIT,
+                              rw == w && rh == h ? GL_NEAREST : GL_LINEAR);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+        glViewport(0, 0, w, h);
+
+        /* 7-8 耗时叠加层与窗口标题 */
+        if (showHud) stats.draw_overlay(w, h, budgetMs);
+        if (seconds() - titleTime > 0.5) {
+            titleTime = seconds();
+            std::string title = "Ray Marching | " + stats.summary();
+            if (dynamicRes) title += " | " + std::to_string(rw) + "x" + std::to_string(rh);
+            if (spp > 0) title += " | " + std::to_string(accumCount) + " spp";
+            if (!rendered) title += " | idle";
+            glfwSetWindowTitle(win, title.c_str());
+        }
+
+        stats.begin_swap();
         glfwSwapBuffers(win);
-        glfwPollEvents();
+        stats.end_swap();
+        // 画面静止时不空转：等到有输入 / 尺寸变化，最多 0.1 s 后再检查一次场景
+        if (rendered) glfwPollEvents();
+        else glfwWaitEventsTimeout(0.1);
+
+        bool hudKey = glfwGetKey(win, GLFW_KEY_H) == GLFW_PRESS;
+        if (hudKey && !hudKeyDown) showHud = !showHud;
+        hudKeyDown = hudKey;
+        stats.end_frame();
+
+        /* 7-9 用新收到的 GPU 计时调整下一帧的比例 (只取最新的一个，计时本身晚一两帧) */
+        const std::vector<FrameStats::Sample> &samples = stats.samples();
+        if (dynamicRes && samples.size() > seenSamples) {
+            seenSamples = samples.size();
+            dynres.update(samples.back().gpu_ms, static_cast<float>(samples.back().scale));
+        }
+    }
+
+    /* ---------- 8. 无窗口时输出最后一帧 ---------- */
+    if (headless) {
+        std::vector<float> rgb;
+        readPixelsRGB(width, height, rgb);
+        if (!ImageIO::write_png(outPath, width, height, rgb)) {
+            std::cout << "[Error] Cannot write " << outPath << std::endl;
+        }
+        std::cout << width << "x" << height << ", " << frames << " frames, "
+                  << seconds() / frames * 1000.0 << " ms/frame -> " << outPath << std::endl;
+    }
+    edge.destroy();
+    cone.destroy();
+    gbuffer.destroy();
+    shadow.destroy();
+    if (target != 0) {
+        glDeleteRenderbuffers(1, &targetColor);
+        glDeleteFramebuffers(1, &target);
     }
 
-    /* ---------- 8. 资源释放 ---------- */
+    /* ---------- 9. 资源释放 ---------- */
+    stats.close();
+    std::cout << stats.percentiles();
     glfwTerminate();
     return 0;
 }
@@ -0,0 +1,88 @@
+#include "offscreen_context.h"
+#include <glad/glad.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <cstring>
+#include <iostream>
+
+OffscreenContext::~OffscreenContext() {
+    destroy();
+}
+
+bool OffscreenContext::create() {
+    EGLDisplay dpy = EGL_NO_DISPLAY;
+    const char *clientExts = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (clientExts && std::strstr(clientExts, "EGL_MESA_platform_surfaceless")) {
+        dpy = eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (dpy == EGL_NO_DISPLAY) {
+        dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    EGLint major = 0, minor = 0;
+    if (dpy == EGL_NO_DISPLAY || !eglInitialize(dpy, &major, &minor)) {
+        std::cout << "[Error] Cannot initialize EGL display" << std::endl;
+        return false;
+    }
+    display = dpy;
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        std::cout << "[Error] EGL does not support desktop OpenGL" << std::endl;
+        return false;
+    }
+
+    const EGLint configAttribs[] = {
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+            EGL_NONE
+    };
+    EGLConfig config = nullptr;
+    EGLint numConfigs = 0;
+    if (!eglChooseConfig(dpy, configAttribs, &config, 1, &numConfigs) || numConfigs == 0) {
+        config = nullptr;                       // surfaceless 平台可能不提供 pbuffer 配置
+    }
+
+    const EGLint contextAttribs[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 4,
+            EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+    };
+    EGLContext ctx = eglCreateContext(dpy, config ? config : EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttribs);
+    if (ctx == EGL_NO_CONTEXT) {
+        std::cout << "[Error] Cannot create an OpenGL 4.3 core context (EGL error 0x" << std::hex << eglGetError()
+                  << std::dec << ")" << std::endl;
+        return false;
+    }
+    context = ctx;
+
+    // 不需要默认帧缓冲；没有 EGL_KHR_surfaceless_context 时绑一个 1x1 的 pbuffer
+    if (!eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, ctx)) {
+        const EGLint pbufferAttribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+        EGLSurface pbuffer = config ? eglCreatePbufferSurface(dpy, config, pbufferAttribs) : EGL_NO_SURFACE;
+        if (pbuffer == EGL_NO_SURFACE || !eglMakeCurrent(dpy, pbuffer, pbuffer, ctx)) {
+            std::cout << "[Error] Cannot make the offscreen context current" << std::endl;
+            return false;
+        }
+        surface = pbuffer;
+    }
+    return true;
+}
+
+void OffscreenContext::destroy() {
+    if (display == nullptr) return;
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (surface) eglDestroySurface(display, surface);
+    if (context) eglDestroyContext(display, context);
+    eglTerminate(display);
+    display = context = surface = nullptr;
+}
+
+void *OffscreenContext::proc_address(const char *name) {
+    return reinterpret_cast<void *>(eglGetProcAddress(name));
+}
+
+std::string OffscreenContext::renderer() {
+    const char *renderer = reinterpret_cast<const char *>(glGetString(GL_RENDERER));
+    const char *version = reinterpret_cast<const char *>(glGetString(GL_VERSION));
+    return std::string(renderer ? renderer : "?") + " / " + (version ? version : "?");
+}
@@ -0,0 +1,35 @@
+#ifndef ISR_OFFSCREEN_CONTEXT_H
+#define ISR_OFFSCREEN_CONTEXT_H
+
+#include <string>
+
+// 无窗口的 OpenGL 4.3 core 上下文 (EGL)，可在没有显示环境的机器上用 Mesa llvmpipe 渲染。
+// 优先使用 Mesa 的 surfaceless 平台，不支持时退回默认 display；不创建窗口表面，渲染目标须自备 FBO
+class OffscreenContext {
+public:
+    OffscreenContext() = default;
+
+    OffscreenContext(const OffscreenContext &) = delete;
+
+    OffscreenContext &operator=(const OffscreenContext &) = delete;
+
+    ~OffscreenContext();
+
+    // 创建上下文并设为当前上下文，失败时输出原因并返回 false
+    bool create();
+
+    void destroy();
+
+    // 供 gladLoadGLLoader 使用
+    static void *proc_address(const char *name);
+
+    // GL_RENDERER / GL_VERSION，须在 GL 函数加载之后调用
+    static std::string renderer();
+
+private:
+    void *display = nullptr;
+    void *context = nullptr;
+    void *surface = nullptr;
+};
+
+#endif //ISR_OFFSCREEN_CONTEXT_H
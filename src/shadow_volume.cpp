@@ -0,0 +1,137 @@
+#include "shadow_volume.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <iostream>
+
+glm::vec3 ShadowVolume::key_dir() {
+    return glm::normalize(glm::vec3(0.5f, 0.7f, -0.4f));
+}
+
+void ShadowVolume::resize(const Objects::AABB &casters) {
+    destroy();
+    if (!casters.bounded) return;
+
+    // 包围盒留出余量后沿主光的反方向平移，直到下降一个盒子的高度：其下方的地面仍在体积内
+    glm::vec3 key = key_dir();
+    glm::vec3 margin = glm::vec3(0.05f * glm::length(casters.max - casters.min) + 0.1f);
+    glm::vec3 boxMin = casters.min - margin, boxMax = casters.max + margin;
+    glm::vec3 shift = -key * ((boxMax.y - boxMin.y) / key.y);
+    lo = glm::min(boxMin, boxMin + shift);
+    hi = glm::max(boxMax, boxMax + shift);
+
+    // 体素接近立方体：最长边 MAX_RES 个，其余按比例
+    glm::vec3 size = hi - lo;
+    float longest = std::max(size.x, std::max(size.y, size.z));
+    for (int i = 0; i < 3; ++i) {
+        res[i] = std::max(8, static_cast<int>(MAX_RES * size[i] / longest + 0.5f));
+    }
+
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_3D, tex);
+    glTexStorage3D(GL_TEXTURE_3D, 1, GL_R8, res[0], res[1], res[2]);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, tex, 0, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "阴影缓存帧缓冲不完整: " << res[0] << "x" << res[1] << "x" << res[2] << '\n';
+    }
+    invalidate({Objects::AABB()});
+}
+
+void ShadowVolume::invalidate(const std::vector<Objects::AABB> &bounds) {
+    if (tex == 0) return;
+    glm::vec3 key = key_dir();
+    glm::vec3 voxel = (hi - lo) / glm::vec3(res[0], res[1], res[2]);
+    for (const Objects::AABB &box: bounds) {
+        glm::vec3 regionMin = lo, regionMax = hi;
+        if (box.bounded) {
+            // 光线朝主光方向穿过盒子的点都在盒子沿 -key 扫过的区域内，扫到体积底部为止；
+            // softShadow 的半影在距离 t 处约为 t / 8，按最远的距离向四周放宽
+            float length = std::max((box.max.y - lo.y) / key.y, 0.0f);
+            glm::vec3 shift = -key * length;
+            glm::vec3 penumbra = glm::vec3(length / 8.0f) + voxel;
+            regionMin = glm::min(box.min, box.min + shift) - penumbra;
+            regionMax = glm::max(box.max, box.max + shift) + penumbra;
+        }
+        VoxelBox region;
+        bool inside = true;
+        for (int i = 0; i < 3; ++i) {
+            region.lo[i] = std::max(static_cast<int>(std::floor((regionMin[i] - lo[i]) / voxel[i])), 0);
+            region.hi[i] = std::min(static_cast<int>(std::floor((regionMax[i] - lo[i]) / voxel[i])), res[i] - 1);
+            inside = inside && region.lo[i] <= region.hi[i];
+        }
+        if (!inside) continue;                          // 与体积不相交
+        // 并入与它相交的范围；合并后变大的范围可能又与别的范围相交，重新检查直到没有相交的为止
+        for (size_t k = 0; k < dirty.size();) {
+            const VoxelBox &other = dirty[k];
+            bool overlap = true;
+            for (int i = 0; i < 3; ++i) {
+                overlap = overlap && other.lo[i] <= region.hi[i] && region.lo[i] <= other.hi[i];
+            }
+            if (!overlap) {
+                ++k;
+                continue;
+            }
+            for (int i = 0; i < 3; ++i) {
+                region.lo[i] = std::min(region.lo[i], other.lo[i]);
+                region.hi[i] = std::max(region.hi[i], other.hi[i]);
+            }
+            dirty.erase(dirty.begin() + k);
+            k = 0;
+        }
+        dirty.push_back(region);
+    }
+}
+
+long ShadowVolume::update(GLuint prog, GLuint target, int width, int height) {
+    long voxels = 0;
+    if (tex != 0 && !dirty.empty()) {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glViewport(0, 0, res[0], res[1]);
+        glEnable(GL_SCISSOR_TEST);
+        glUniform1i(glGetUniformLocation(prog, "uShadowVolume"), 0);   // 画缓存时不读缓存
+        glUniform1i(glGetUniformLocation(prog, "uShadowPass"), 1);
+        glUniform3i(glGetUniformLocation(prog, "uShadowRes"), res[0], res[1], res[2]);
+        glUniform3f(glGetUniformLocation(prog, "uShadowMin"), lo.x, lo.y, lo.z);
+        glUniform3f(glGetUniformLocation(prog, "uShadowMax"), hi.x, hi.y, hi.z);
+        for (const VoxelBox &box: dirty) {
+            glScissor(box.lo[0], box.lo[1], box.hi[0] - box.lo[0] + 1, box.hi[1] - box.lo[1] + 1);
+            for (int z = box.lo[2]; z <= box.hi[2]; ++z) {
+                glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, tex, 0, z);
+                glUniform1i(glGetUniformLocation(prog, "uShadowSlice"), z);
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            }
+            voxels += static_cast<long>(box.hi[0] - box.lo[0] + 1) * (box.hi[1] - box.lo[1] + 1) *
+                      (box.hi[2] - box.lo[2] + 1);
+        }
+        glDisable(GL_SCISSOR_TEST);
+        glUniform1i(glGetUniformLocation(prog, "uShadowPass"), 0);
+        dirty.clear();
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
+    glViewport(0, 0, width, height);
+    if (tex != 0) {
+        glm::vec3 voxel = (hi - lo) / glm::vec3(res[0], res[1], res[2]);
+        glActiveTexture(GL_TEXTURE0 + SHADOW_UNIT);
+        glBindTexture(GL_TEXTURE_3D, tex);
+        glUniform3f(glGetUniformLocation(prog, "uShadowMin"), lo.x, lo.y, lo.z);
+        glUniform3f(glGetUniformLocation(prog, "uShadowMax"), hi.x, hi.y, hi.z);
+        glUniform1f(glGetUniformLocation(prog, "uShadowOffset"), 0.25f * glm::length(voxel));
+    }
+    glUniform1i(glGetUniformLocation(prog, "uShadowVolume"), tex != 0 ? 1 : 0);
+    return voxels;
+}
+
+void ShadowVolume::destroy() {
+    if (fbo == 0) return;
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &tex);
+    fbo = tex = 0;
+    res[0] = res[1] = res[2] = 0;
+    dirty.clear();
+}
@@ -0,0 +1,48 @@
+#ifndef ISR_SHADOW_VOLUME_H
+#define ISR_SHADOW_VOLUME_H
+
+#include <glad/glad.h>
+#include <glm/vec3.hpp>
+#include <vector>
+#include "bvh.h"
+
+// 主光阴影缓存 (raymarch.frag 的 uShadowPass / uShadowVolume)：主光方向固定，场景静止时每一点的软阴影不变。
+// 把有界物体的包围盒连同它沿主光投下阴影的区域划成体素，每个体素中心预先做一次 softShadow()，
+// 着色时三线性插值代替最多 128 步的阴影步进 (体积外的点仍然步进)。
+// 物体移动后只重画它移动前后的包围盒沿主光扫过 (含半影) 的体素
+class ShadowVolume {
+public:
+    static const int SHADOW_UNIT = 10;          // 着色时读取阴影缓存的纹理单元 (raymarch.frag 中 uShadowTex 的 binding)
+    static const int MAX_RES = 128;             // 最长边的体素数
+
+    // 与 raymarch.frag 的 KEY_DIR 相同
+    static glm::vec3 key_dir();
+
+    // 按有界物体的包围盒 casters 确定体积并分配纹理，整个体积标记为失效；casters 无界时不使用缓存
+    void resize(const Objects::AABB &casters);
+
+    // 使移动过的包围盒 (CSG_tree::update_dirty 的 movedBounds) 影响到的体素失效；无界的盒子使整个体积失效。
+    // 每个盒子的失效范围单独记录，只与相交的范围合并，相距很远的两个物体不会使它们之间的体素一起重画
+    void invalidate(const std::vector<Objects::AABB> &bounds);
+
+    // 重画失效的体素 (调用方需已绑定全屏 quad 的 VAO 与场景数据)：对每个失效范围逐层绑定到 FBO，
+    // 用 scissor 限制在该范围内并设置 uShadowPass = 1 画 quad；之后绑定 target、恢复 width × height 的视口，
+    // 把缓存绑到 SHADOW_UNIT 并设置 uShadowVolume。返回重画的体素数
+    long update(GLuint prog, GLuint target, int width, int height);
+
+    void destroy();
+
+private:
+    GLuint fbo = 0, tex = 0;
+    int res[3] = {0, 0, 0};
+    glm::vec3 lo = glm::vec3(0.0f), hi = glm::vec3(0.0f);  // 体积的世界坐标范围
+
+    // 失效的体素范围 (闭区间)
+    struct VoxelBox {
+        int lo[3];
+        int hi[3];
+    };
+    std::vector<VoxelBox> dirty;                // 互不相交
+};
+
+#endif //ISR_SHADOW_VOLUME_H